@@ -15,8 +15,11 @@
 #include <wlr/backend/session.h>
 #include <wlr/backend/wayland.h>
 #include <wlr/config.h>
+#include <wlr/interfaces/wlr_output.h>
 #include <wlr/util/log.h>
+#include "backend/backend.h"
 #include "backend/multi.h"
+#include "types/wlr_output.h"
 
 #if WLR_HAS_X11_BACKEND
 #include <wlr/backend/x11.h>
@@ -71,6 +74,87 @@ clockid_t wlr_backend_get_presentation_clock(struct wlr_backend *backend) {
 	return CLOCK_MONOTONIC;
 }
 
+bool backend_commit_outputs(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len, bool test_only,
+		bool *committed) {
+	if (backend->impl->commit_outputs) {
+		return backend->impl->commit_outputs(backend, outputs, outputs_len,
+			test_only, committed);
+	}
+
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (outputs[i]->impl->test && !outputs[i]->impl->test(outputs[i])) {
+			return false;
+		}
+	}
+	if (test_only) {
+		return true;
+	}
+
+	// Not atomic: outputs committed before a failure keep their new state
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (!outputs[i]->impl->commit(outputs[i])) {
+			wlr_log(WLR_ERROR, "Failed to commit output '%s', the output "
+				"configuration has only been partially applied",
+				outputs[i]->name);
+			return false;
+		}
+		committed[i] = true;
+	}
+	return true;
+}
+
+bool wlr_backend_test_outputs(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len) {
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (!output_basic_test(outputs[i])) {
+			return false;
+		}
+	}
+	return backend_commit_outputs(backend, outputs, outputs_len, true, NULL);
+}
+
+bool wlr_backend_commit_outputs(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	bool *committed = calloc(outputs_len, sizeof(bool));
+	if (committed == NULL && outputs_len > 0) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		for (size_t i = 0; i < outputs_len; i++) {
+			output_commit_abort(outputs[i]);
+		}
+		return false;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (!output_commit_prepare(outputs[i], &now)) {
+			ok = false;
+			break;
+		}
+	}
+
+	if (ok) {
+		ok = backend_commit_outputs(backend, outputs, outputs_len, false,
+			committed);
+	}
+
+	// Outputs may have been committed before a failure, their new state
+	// needs to be taken into account all the same
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (committed[i]) {
+			output_commit_finish(outputs[i], &now);
+		} else {
+			output_commit_abort(outputs[i]);
+		}
+	}
+
+	free(committed);
+	return ok;
+}
+
 static size_t parse_outputs_env(const char *name) {
 	const char *outputs_str = getenv(name);
 	if (outputs_str == NULL) {
@@ -1,5 +1,6 @@
 #include <gbm.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -7,13 +8,27 @@
 #include "backend/drm/iface.h"
 #include "backend/drm/util.h"
 
+#define BLOB_CACHE_SIZE 16
+
+struct atomic_shadow_update {
+	struct wlr_drm_prop_shadow *shadow;
+	uint32_t prop;
+	uint64_t value;
+};
+
 struct atomic {
 	drmModeAtomicReq *req;
+	uint32_t flags;
 	bool failed;
+
+	// Values to record in the shadows once the request is committed
+	struct atomic_shadow_update *updates;
+	size_t updates_len, updates_cap;
 };
 
-static void atomic_begin(struct atomic *atom) {
+static void atomic_begin(struct atomic *atom, uint32_t flags) {
 	memset(atom, 0, sizeof(*atom));
+	atom->flags = flags;
 
 	atom->req = drmModeAtomicAlloc();
 	if (!atom->req) {
@@ -23,34 +38,210 @@ static void atomic_begin(struct atomic *atom) {
 	}
 }
 
-static bool atomic_commit(struct atomic *atom,
-		struct wlr_drm_connector *conn, uint32_t flags) {
-	struct wlr_drm_backend *drm =
-		get_drm_backend_from_backend(conn->output.backend);
+static void shadow_set(struct wlr_drm_prop_shadow *shadow, uint32_t prop,
+		uint64_t value) {
+	for (size_t i = 0; i < shadow->len; i++) {
+		if (shadow->props[i].prop == prop) {
+			shadow->props[i].value = value;
+			return;
+		}
+	}
+	if (shadow->len < WLR_DRM_PROP_SHADOW_CAP) {
+		shadow->props[shadow->len].prop = prop;
+		shadow->props[shadow->len].value = value;
+		shadow->len++;
+	}
+}
+
+static bool shadow_has(const struct wlr_drm_prop_shadow *shadow,
+		uint32_t prop, uint64_t value) {
+	for (size_t i = 0; i < shadow->len; i++) {
+		if (shadow->props[i].prop == prop) {
+			return shadow->props[i].value == value;
+		}
+	}
+	return false;
+}
+
+static bool atomic_commit(struct atomic *atom, struct wlr_drm_backend *drm,
+		const char *name) {
 	if (atom->failed) {
 		return false;
 	}
 
+	uint32_t flags = atom->flags;
 	int ret = drmModeAtomicCommit(drm->fd, atom->req, flags, drm);
 	if (ret) {
-		wlr_log_errno(WLR_ERROR, "%s: Atomic %s failed (%s)",
-			conn->output.name,
+		wlr_log_errno(WLR_ERROR, "%s: Atomic %s failed (%s)", name,
 			(flags & DRM_MODE_ATOMIC_TEST_ONLY) ? "test" : "commit",
 			(flags & DRM_MODE_ATOMIC_ALLOW_MODESET) ? "modeset" : "pageflip");
+		if (!(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+			// Be conservative, the kernel state may have been changed
+			// behind our back
+			for (size_t i = 0; i < atom->updates_len; i++) {
+				atom->updates[i].shadow->len = 0;
+			}
+		}
 		return false;
 	}
 
+	if (!(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+		for (size_t i = 0; i < atom->updates_len; i++) {
+			struct atomic_shadow_update *update = &atom->updates[i];
+			shadow_set(update->shadow, update->prop, update->value);
+		}
+	}
+
 	return true;
 }
 
 static void atomic_finish(struct atomic *atom) {
 	drmModeAtomicFree(atom->req);
+	free(atom->updates);
 }
 
-static void atomic_add(struct atomic *atom, uint32_t id, uint32_t prop, uint64_t val) {
-	if (!atom->failed && drmModeAtomicAddProperty(atom->req, id, prop, val) < 0) {
+static void atomic_add_prop(struct atomic *atom,
+		struct wlr_drm_prop_shadow *shadow, uint32_t id, uint32_t prop,
+		uint64_t val) {
+	if (atom->failed) {
+		return;
+	}
+	if (drmModeAtomicAddProperty(atom->req, id, prop, val) < 0) {
 		wlr_log_errno(WLR_ERROR, "Failed to add atomic DRM property");
 		atom->failed = true;
+		return;
+	}
+
+	if (atom->updates_len == atom->updates_cap) {
+		size_t cap = atom->updates_cap ? atom->updates_cap * 2 : 32;
+		struct atomic_shadow_update *updates =
+			realloc(atom->updates, cap * sizeof(*updates));
+		if (updates == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			atom->failed = true;
+			return;
+		}
+		atom->updates = updates;
+		atom->updates_cap = cap;
+	}
+	atom->updates[atom->updates_len++] = (struct atomic_shadow_update){
+		.shadow = shadow,
+		.prop = prop,
+		.value = val,
+	};
+}
+
+/**
+ * Adds a property to the request, unless the kernel already has this value.
+ * Modesets always send the full state.
+ */
+static void atomic_add(struct atomic *atom,
+		struct wlr_drm_prop_shadow *shadow, uint32_t id, uint32_t prop,
+		uint64_t val) {
+	if (!(atom->flags & DRM_MODE_ATOMIC_ALLOW_MODESET) &&
+			shadow_has(shadow, prop, val)) {
+		return;
+	}
+	atomic_add_prop(atom, shadow, id, prop, val);
+}
+
+static uint64_t hash_blob(const void *data, size_t size) {
+	// FNV-1a
+	const uint8_t *bytes = data;
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+static bool blob_in_use(struct wlr_drm_backend *drm, uint32_t id) {
+	for (size_t i = 0; i < drm->num_crtcs; i++) {
+		if (drm->crtcs[i].mode_id == id || drm->crtcs[i].gamma_lut == id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void blob_destroy(struct wlr_drm_backend *drm,
+		struct wlr_drm_blob *blob) {
+	drmModeDestroyPropertyBlob(drm->fd, blob->id);
+	wl_list_remove(&blob->link);
+	free(blob->data);
+	free(blob);
+}
+
+/**
+ * Returns a property blob with the given contents, creating it if it isn't
+ * in the cache yet. Blobs are owned by the cache.
+ */
+static bool get_blob(struct wlr_drm_backend *drm, const void *data,
+		size_t size, uint32_t *blob_id) {
+	uint64_t hash = hash_blob(data, size);
+
+	struct wlr_drm_blob *blob;
+	wl_list_for_each(blob, &drm->blobs, link) {
+		if (blob->hash == hash && blob->size == size &&
+				memcmp(blob->data, data, size) == 0) {
+			wl_list_remove(&blob->link);
+			wl_list_insert(&drm->blobs, &blob->link);
+			*blob_id = blob->id;
+			return true;
+		}
+	}
+
+	blob = calloc(1, sizeof(*blob));
+	if (blob == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	blob->data = malloc(size);
+	if (blob->data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(blob);
+		return false;
+	}
+	memcpy(blob->data, data, size);
+	blob->size = size;
+	blob->hash = hash;
+
+	if (drmModeCreatePropertyBlob(drm->fd, data, size, &blob->id)) {
+		wlr_log_errno(WLR_ERROR, "Unable to create property blob");
+		free(blob->data);
+		free(blob);
+		return false;
+	}
+
+	wl_list_insert(&drm->blobs, &blob->link);
+	*blob_id = blob->id;
+	return true;
+}
+
+/**
+ * Drops the least recently used blobs not referenced by any CRTC, once the
+ * cache is full. Must only be called once no request is being built, since
+ * blobs in pending requests aren't referenced by their CRTC yet.
+ */
+static void trim_blobs(struct wlr_drm_backend *drm) {
+	int len = wl_list_length(&drm->blobs);
+	struct wlr_drm_blob *blob, *tmp;
+	wl_list_for_each_reverse_safe(blob, tmp, &drm->blobs, link) {
+		if (len <= BLOB_CACHE_SIZE) {
+			break;
+		}
+		if (!blob_in_use(drm, blob->id)) {
+			blob_destroy(drm, blob);
+			len--;
+		}
+	}
+}
+
+void drm_atomic_finish_blobs(struct wlr_drm_backend *drm) {
+	struct wlr_drm_blob *blob, *tmp;
+	wl_list_for_each_safe(blob, tmp, &drm->blobs, link) {
+		blob_destroy(drm, blob);
 	}
 }
 
@@ -61,9 +252,9 @@ static bool create_mode_blob(struct wlr_drm_backend *drm,
 		return true;
 	}
 
-	if (drmModeCreatePropertyBlob(drm->fd, &crtc->pending.mode->drm_mode,
+	if (!get_blob(drm, &crtc->pending.mode->drm_mode,
 			sizeof(drmModeModeInfo), blob_id)) {
-		wlr_log_errno(WLR_ERROR, "Unable to create mode property blob");
+		wlr_log(WLR_ERROR, "Unable to create mode property blob");
 		return false;
 	}
 
@@ -87,14 +278,15 @@ static bool create_gamma_lut_blob(struct wlr_drm_backend *drm,
 	const uint16_t *g = lut + size;
 	const uint16_t *b = lut + 2 * size;
 	for (size_t i = 0; i < size; i++) {
-		gamma[i].red = r[i];
-		gamma[i].green = g[i];
-		gamma[i].blue = b[i];
+		gamma[i] = (struct drm_color_lut){
+			.red = r[i],
+			.green = g[i],
+			.blue = b[i],
+		};
 	}
 
-	if (drmModeCreatePropertyBlob(drm->fd, gamma,
-			size * sizeof(struct drm_color_lut), blob_id) != 0) {
-		wlr_log_errno(WLR_ERROR, "Unable to create gamma LUT property blob");
+	if (!get_blob(drm, gamma, size * sizeof(struct drm_color_lut), blob_id)) {
+		wlr_log(WLR_ERROR, "Unable to create gamma LUT property blob");
 		free(gamma);
 		return false;
 	}
@@ -103,42 +295,29 @@ static bool create_gamma_lut_blob(struct wlr_drm_backend *drm,
 	return true;
 }
 
-static void commit_blob(struct wlr_drm_backend *drm,
-		uint32_t *current, uint32_t next) {
-	if (*current == next) {
-		return;
-	}
-	if (*current != 0) {
-		drmModeDestroyPropertyBlob(drm->fd, *current);
-	}
-	*current = next;
-}
-
-static void rollback_blob(struct wlr_drm_backend *drm,
-		uint32_t *current, uint32_t next) {
-	if (*current == next) {
-		return;
-	}
-	if (next != 0) {
-		drmModeDestroyPropertyBlob(drm->fd, next);
-	}
-}
-
 static void plane_disable(struct atomic *atom, struct wlr_drm_plane *plane) {
 	uint32_t id = plane->id;
 	const union wlr_drm_plane_props *props = &plane->props;
-	atomic_add(atom, id, props->fb_id, 0);
-	atomic_add(atom, id, props->crtc_id, 0);
+	atomic_add(atom, &plane->shadow, id, props->fb_id, 0);
+	atomic_add(atom, &plane->shadow, id, props->crtc_id, 0);
 }
 
 static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
 		struct wlr_drm_plane *plane, uint32_t crtc_id, int32_t x, int32_t y) {
 	uint32_t id = plane->id;
 	const union wlr_drm_plane_props *props = &plane->props;
-	struct wlr_drm_fb *fb = plane_get_next_fb(plane);
-	struct gbm_bo *bo = drm_fb_acquire(fb, drm, &plane->mgpu_surf);
-	if (!bo) {
-		goto error;
+	struct gbm_bo *bo = plane->test_bo;
+	uint32_t width = plane->surf.width;
+	uint32_t height = plane->surf.height;
+	if (bo != NULL) {
+		width = gbm_bo_get_width(bo);
+		height = gbm_bo_get_height(bo);
+	} else {
+		struct wlr_drm_fb *fb = plane_get_next_fb(plane);
+		bo = drm_fb_acquire(fb, drm, &plane->mgpu_surf);
+		if (!bo) {
+			goto error;
+		}
 	}
 
 	uint32_t fb_id = get_fb_for_bo(bo, drm->addfb2_modifiers);
@@ -147,16 +326,17 @@ static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
 	}
 
 	// The src_* properties are in 16.16 fixed point
-	atomic_add(atom, id, props->src_x, 0);
-	atomic_add(atom, id, props->src_y, 0);
-	atomic_add(atom, id, props->src_w, (uint64_t)plane->surf.width << 16);
-	atomic_add(atom, id, props->src_h, (uint64_t)plane->surf.height << 16);
-	atomic_add(atom, id, props->crtc_w, plane->surf.width);
-	atomic_add(atom, id, props->crtc_h, plane->surf.height);
-	atomic_add(atom, id, props->fb_id, fb_id);
-	atomic_add(atom, id, props->crtc_id, crtc_id);
-	atomic_add(atom, id, props->crtc_x, (uint64_t)x);
-	atomic_add(atom, id, props->crtc_y, (uint64_t)y);
+	atomic_add(atom, &plane->shadow, id, props->src_x, 0);
+	atomic_add(atom, &plane->shadow, id, props->src_y, 0);
+	atomic_add(atom, &plane->shadow, id, props->src_w, (uint64_t)width << 16);
+	atomic_add(atom, &plane->shadow, id, props->src_h, (uint64_t)height << 16);
+	atomic_add(atom, &plane->shadow, id, props->crtc_w, width);
+	atomic_add(atom, &plane->shadow, id, props->crtc_h, height);
+	// FBs may have been removed and their IDs reused since the last commit
+	atomic_add_prop(atom, &plane->shadow, id, props->fb_id, fb_id);
+	atomic_add_prop(atom, &plane->shadow, id, props->crtc_id, crtc_id);
+	atomic_add(atom, &plane->shadow, id, props->crtc_x, (uint64_t)x);
+	atomic_add(atom, &plane->shadow, id, props->crtc_y, (uint64_t)y);
 
 	return;
 
@@ -165,19 +345,26 @@ error:
 	atom->failed = true;
 }
 
-static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
-		struct wlr_drm_connector *conn, uint32_t flags) {
+// Property blobs and VRR state of a CRTC in an atomic request
+struct atomic_crtc_state {
+	uint32_t mode_id;
+	uint32_t gamma_lut;
+	bool vrr_enabled, prev_vrr_enabled;
+};
+
+static bool atomic_crtc_prepare(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, struct atomic_crtc_state *state) {
 	struct wlr_output *output = &conn->output;
 	struct wlr_drm_crtc *crtc = conn->crtc;
 
-	uint32_t mode_id = crtc->mode_id;
+	state->mode_id = crtc->mode_id;
 	if (crtc->pending_modeset) {
-		if (!create_mode_blob(drm, crtc, &mode_id)) {
+		if (!create_mode_blob(drm, crtc, &state->mode_id)) {
 			return false;
 		}
 	}
 
-	uint32_t gamma_lut = crtc->gamma_lut;
+	state->gamma_lut = crtc->gamma_lut;
 	if (output->pending.committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
 		// Fallback to legacy gamma interface when gamma properties are not
 		// available (can happen on older Intel GPUs that support gamma but not
@@ -190,82 +377,190 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 			}
 		} else {
 			if (!create_gamma_lut_blob(drm, output->pending.gamma_lut_size,
-					output->pending.gamma_lut, &gamma_lut)) {
+					output->pending.gamma_lut, &state->gamma_lut)) {
 				return false;
 			}
 		}
 	}
 
-	bool prev_vrr_enabled =
+	state->prev_vrr_enabled =
 		output->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
-	bool vrr_enabled = prev_vrr_enabled;
+	state->vrr_enabled = state->prev_vrr_enabled;
 	if ((output->pending.committed & WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED) &&
 			drm_connector_supports_vrr(conn)) {
-		vrr_enabled = output->pending.adaptive_sync_enabled;
+		state->vrr_enabled = output->pending.adaptive_sync_enabled;
 	}
 
-	if (crtc->pending_modeset) {
-		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
-	} else {
-		flags |= DRM_MODE_ATOMIC_NONBLOCK;
-	}
+	return true;
+}
 
-	struct atomic atom;
-	atomic_begin(&atom);
-	atomic_add(&atom, conn->id, conn->props.crtc_id,
+static void atomic_crtc_add(struct atomic *atom, struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn,
+		const struct atomic_crtc_state *state) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	atomic_add(atom, &conn->shadow, conn->id, conn->props.crtc_id,
 		crtc->pending.active ? crtc->id : 0);
 	if (crtc->pending_modeset && crtc->pending.active &&
 			conn->props.link_status != 0) {
-		atomic_add(&atom, conn->id, conn->props.link_status,
+		atomic_add(atom, &conn->shadow, conn->id, conn->props.link_status,
 			DRM_MODE_LINK_STATUS_GOOD);
 	}
-	atomic_add(&atom, crtc->id, crtc->props.mode_id, mode_id);
-	atomic_add(&atom, crtc->id, crtc->props.active, crtc->pending.active);
+	atomic_add(atom, &crtc->shadow, crtc->id, crtc->props.mode_id,
+		state->mode_id);
+	// Always include the CRTC, so that it's part of the request and gets a
+	// page-flip event
+	atomic_add_prop(atom, &crtc->shadow, crtc->id, crtc->props.active,
+		crtc->pending.active);
 	if (crtc->pending.active) {
 		if (crtc->props.gamma_lut != 0) {
-			atomic_add(&atom, crtc->id, crtc->props.gamma_lut, gamma_lut);
+			atomic_add(atom, &crtc->shadow, crtc->id,
+				crtc->props.gamma_lut, state->gamma_lut);
 		}
 		if (crtc->props.vrr_enabled != 0) {
-			atomic_add(&atom, crtc->id, crtc->props.vrr_enabled, vrr_enabled);
+			atomic_add(atom, &crtc->shadow, crtc->id,
+				crtc->props.vrr_enabled, state->vrr_enabled);
 		}
-		set_plane_props(&atom, drm, crtc->primary, crtc->id, 0, 0);
+		set_plane_props(atom, drm, crtc->primary, crtc->id, 0, 0);
 		if (crtc->cursor) {
 			if (drm_connector_is_cursor_visible(conn)) {
-				set_plane_props(&atom, drm, crtc->cursor, crtc->id,
+				set_plane_props(atom, drm, crtc->cursor, crtc->id,
 					conn->cursor_x, conn->cursor_y);
 			} else {
-				plane_disable(&atom, crtc->cursor);
+				plane_disable(atom, crtc->cursor);
 			}
 		}
 	} else {
-		plane_disable(&atom, crtc->primary);
+		plane_disable(atom, crtc->primary);
 		if (crtc->cursor) {
-			plane_disable(&atom, crtc->cursor);
+			plane_disable(atom, crtc->cursor);
 		}
 	}
+}
+
+static void atomic_crtc_finish(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, struct atomic_crtc_state *state,
+		bool committed) {
+	struct wlr_output *output = &conn->output;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	// Unused blobs stay in the cache
+	if (!committed) {
+		return;
+	}
+
+	crtc->mode_id = state->mode_id;
+	crtc->gamma_lut = state->gamma_lut;
+
+	if (state->vrr_enabled != state->prev_vrr_enabled) {
+		output->adaptive_sync_status = state->vrr_enabled ?
+			WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED :
+			WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
+		wlr_log(WLR_DEBUG, "VRR %s on connector '%s'",
+			state->vrr_enabled ? "enabled" : "disabled", output->name);
+	}
+}
+
+static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, uint32_t flags) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	struct atomic_crtc_state state;
+	if (!atomic_crtc_prepare(drm, conn, &state)) {
+		return false;
+	}
+
+	if (crtc->pending_modeset) {
+		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+	} else {
+		flags |= DRM_MODE_ATOMIC_NONBLOCK;
+	}
 
-	bool ok = atomic_commit(&atom, conn, flags);
+	struct atomic atom;
+	atomic_begin(&atom, flags);
+	atomic_crtc_add(&atom, drm, conn, &state);
+	bool ok = atomic_commit(&atom, drm, conn->output.name);
 	atomic_finish(&atom);
 
-	if (ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
-		commit_blob(drm, &crtc->mode_id, mode_id);
-		commit_blob(drm, &crtc->gamma_lut, gamma_lut);
+	atomic_crtc_finish(drm, conn, &state,
+		ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY));
+	trim_blobs(drm);
+	return ok;
+}
 
-		if (vrr_enabled != prev_vrr_enabled) {
-			output->adaptive_sync_status = vrr_enabled ?
-				WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED :
-				WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
-			wlr_log(WLR_DEBUG, "VRR %s on connector '%s'",
-				vrr_enabled ? "enabled" : "disabled", output->name);
+static bool atomic_crtcs_commit(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector **conns, size_t conns_len, uint32_t flags) {
+	struct atomic_crtc_state *states = calloc(conns_len, sizeof(*states));
+	if (states == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	size_t prepared = 0;
+	bool modeset = false;
+	for (; prepared < conns_len; prepared++) {
+		if (!atomic_crtc_prepare(drm, conns[prepared], &states[prepared])) {
+			break;
 		}
-	} else {
-		rollback_blob(drm, &crtc->mode_id, mode_id);
-		rollback_blob(drm, &crtc->gamma_lut, gamma_lut);
+		modeset |= conns[prepared]->crtc->pending_modeset;
 	}
 
+	bool ok = prepared == conns_len;
+	if (ok) {
+		if (modeset) {
+			flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+		} else {
+			flags |= DRM_MODE_ATOMIC_NONBLOCK;
+		}
+
+		struct atomic atom;
+		atomic_begin(&atom, flags);
+		for (size_t i = 0; i < conns_len; i++) {
+			atomic_crtc_add(&atom, drm, conns[i], &states[i]);
+		}
+		const char *name = conns_len == 1 ?
+			conns[0]->output.name : "Multiple outputs";
+		ok = atomic_commit(&atom, drm, name);
+		atomic_finish(&atom);
+	}
+
+	for (size_t i = 0; i < prepared; i++) {
+		atomic_crtc_finish(drm, conns[i], &states[i],
+			ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY));
+	}
+	free(states);
+	trim_blobs(drm);
 	return ok;
 }
 
+static bool atomic_crtc_move_cursor(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	struct wlr_drm_plane *plane = crtc->cursor;
+
+	// Enabling the cursor plane requires a full commit
+	if (!shadow_has(&plane->shadow, plane->props.crtc_id, crtc->id)) {
+		return false;
+	}
+
+	// An atomic commit would fail with EBUSY while a page-flip is pending,
+	// and would make the next page-flip fail the same way until it completes.
+	// The legacy cursor ioctl is applied asynchronously, even by atomic
+	// drivers.
+	if (drmModeMoveCursor(drm->fd, crtc->id,
+			conn->cursor_x, conn->cursor_y) != 0) {
+		wlr_log_errno(WLR_DEBUG, "%s: failed to move cursor",
+			conn->output.name);
+		return false;
+	}
+
+	shadow_set(&plane->shadow, plane->props.crtc_x, (uint64_t)conn->cursor_x);
+	shadow_set(&plane->shadow, plane->props.crtc_y, (uint64_t)conn->cursor_y);
+	return true;
+}
+
 const struct wlr_drm_interface atomic_iface = {
 	.crtc_commit = atomic_crtc_commit,
+	.crtcs_commit = atomic_crtcs_commit,
+	.crtc_move_cursor = atomic_crtc_move_cursor,
 };
@@ -71,11 +71,20 @@ static clockid_t backend_get_presentation_clock(struct wlr_backend *backend) {
 	return drm->clock;
 }
 
+static bool drm_backend_commit_outputs(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len, bool test_only,
+		bool *committed) {
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(backend);
+	return drm_commit_outputs(drm, outputs, outputs_len, test_only,
+		committed);
+}
+
 static struct wlr_backend_impl backend_impl = {
 	.start = backend_start,
 	.destroy = backend_destroy,
 	.get_renderer = backend_get_renderer,
 	.get_presentation_clock = backend_get_presentation_clock,
+	.commit_outputs = drm_backend_commit_outputs,
 };
 
 bool wlr_backend_is_drm(struct wlr_backend *b) {
@@ -89,6 +98,8 @@ static void session_signal(struct wl_listener *listener, void *data) {
 
 	if (session->active) {
 		wlr_log(WLR_INFO, "DRM fd resumed");
+		// Another DRM master may have changed the KMS state
+		invalidate_drm_prop_shadows(drm);
 		scan_drm_connectors(drm);
 
 		struct wlr_drm_connector *conn;
@@ -148,6 +159,7 @@ struct wlr_backend *wlr_drm_backend_create(struct wl_display *display,
 
 	drm->session = session;
 	wl_list_init(&drm->outputs);
+	wl_list_init(&drm->blobs);
 
 	drm->fd = gpu_fd;
 	if (parent != NULL) {
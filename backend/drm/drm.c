@@ -28,6 +28,7 @@
 #include "backend/drm/iface.h"
 #include "backend/drm/util.h"
 #include "util/signal.h"
+#include "util/trace.h"
 
 bool check_drm_features(struct wlr_drm_backend *drm) {
 	uint64_t cap;
@@ -98,6 +99,7 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	p->type = type;
 	p->id = drm_plane->plane_id;
 	p->props = *props;
+	wl_list_init(&p->cursor_bos);
 
 	for (size_t j = 0; j < drm_plane->count_formats; ++j) {
 		wlr_drm_format_set_add(&p->formats, drm_plane->formats[j],
@@ -298,13 +300,6 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 
 		drmModeFreeCrtc(crtc->legacy_crtc);
 
-		if (crtc->mode_id) {
-			drmModeDestroyPropertyBlob(drm->fd, crtc->mode_id);
-		}
-		if (crtc->gamma_lut) {
-			drmModeDestroyPropertyBlob(drm->fd, crtc->gamma_lut);
-		}
-
 		if (crtc->primary) {
 			wlr_drm_format_set_finish(&crtc->primary->formats);
 			free(crtc->primary);
@@ -317,6 +312,8 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 	}
 
 	free(drm->crtcs);
+
+	drm_atomic_finish_blobs(drm);
 }
 
 static struct wlr_drm_connector *get_drm_connector_from_output(
@@ -331,12 +328,12 @@ static bool drm_connector_attach_render(struct wlr_output *output,
 	return drm_surface_make_current(&conn->crtc->primary->surf, buffer_age);
 }
 
-static bool drm_crtc_commit(struct wlr_drm_connector *conn, uint32_t flags) {
-	struct wlr_drm_backend *drm =
-		get_drm_backend_from_backend(conn->output.backend);
-	struct wlr_drm_crtc *crtc = conn->crtc;
-	bool ok = drm->iface->crtc_commit(drm, conn, flags);
-	if (ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+/**
+ * Applies or discards the CRTC's pending state, once the kernel has accepted
+ * or rejected it.
+ */
+static void crtc_finish_commit(struct wlr_drm_crtc *crtc, bool committed) {
+	if (committed) {
 		memcpy(&crtc->current, &crtc->pending, sizeof(struct wlr_drm_crtc_state));
 		drm_fb_move(&crtc->primary->queued_fb, &crtc->primary->pending_fb);
 		if (crtc->cursor != NULL) {
@@ -350,6 +347,26 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn, uint32_t flags) {
 		}
 	}
 	crtc->pending_modeset = false;
+}
+
+/**
+ * Discards the CRTC's pending state after a test commit. The cursor image
+ * staged by set_cursor is kept, the real commit still needs it.
+ */
+static void crtc_finish_test(struct wlr_drm_crtc *crtc) {
+	memcpy(&crtc->pending, &crtc->current, sizeof(struct wlr_drm_crtc_state));
+	// Only set by the test itself, restaged by the real commit
+	drm_fb_clear(&crtc->primary->pending_fb);
+	crtc->pending_modeset = false;
+}
+
+static bool drm_crtc_commit(struct wlr_drm_connector *conn, uint32_t flags) {
+	struct wlr_drm_backend *drm =
+		get_drm_backend_from_backend(conn->output.backend);
+	TRACE_BEGIN("drm_crtc_commit");
+	bool ok = drm->iface->crtc_commit(drm, conn, flags);
+	TRACE_END("drm_crtc_commit");
+	crtc_finish_commit(conn->crtc, ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY));
 	return ok;
 }
 
@@ -372,6 +389,7 @@ static bool drm_crtc_page_flip(struct wlr_drm_connector *conn) {
 		return false;
 	}
 
+	TRACE_ASYNC_BEGIN("drm_page_flip", crtc->id);
 	conn->pageflip_pending = true;
 	return true;
 }
@@ -471,14 +489,14 @@ static struct wlr_output_mode *drm_connector_get_pending_mode(
 	abort();
 }
 
-static bool drm_connector_commit_buffer(struct wlr_output *output) {
-	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+/**
+ * Locks the buffer attached to the output into the primary plane's pending
+ * FB.
+ */
+static bool drm_connector_set_pending_fb(struct wlr_drm_connector *conn) {
+	struct wlr_output *output = &conn->output;
 	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
-
 	struct wlr_drm_crtc *crtc = conn->crtc;
-	if (!crtc) {
-		return false;
-	}
 	struct wlr_drm_plane *plane = crtc->primary;
 
 	assert(output->pending.committed & WLR_OUTPUT_STATE_BUFFER);
@@ -501,6 +519,19 @@ static bool drm_connector_commit_buffer(struct wlr_output *output) {
 		break;
 	}
 
+	return true;
+}
+
+static bool drm_connector_commit_buffer(struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	if (!conn->crtc) {
+		return false;
+	}
+
+	if (!drm_connector_set_pending_fb(conn)) {
+		return false;
+	}
+
 	if (!drm_crtc_page_flip(conn)) {
 		return false;
 	}
@@ -642,6 +673,27 @@ static bool drm_connector_export_dmabuf(struct wlr_output *output,
 	return export_drm_bo(plane->current_fb.bo, attribs);
 }
 
+static struct wlr_buffer *drm_connector_lock_front_buffer(
+		struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	if (!drm->session->active || !crtc) {
+		return NULL;
+	}
+
+	struct wlr_drm_fb *fb = &crtc->primary->current_fb;
+	switch (fb->type) {
+	case WLR_DRM_FB_TYPE_SURFACE:
+		return drm_surface_lock_buffer(fb->surf, fb->bo);
+	case WLR_DRM_FB_TYPE_WLR_BUFFER:
+		return wlr_buffer_lock(fb->wlr_buf);
+	default:
+		return NULL;
+	}
+}
+
 struct wlr_drm_fb *plane_get_next_fb(struct wlr_drm_plane *plane) {
 	if (plane->pending_fb.type != WLR_DRM_FB_TYPE_NONE) {
 		return &plane->pending_fb;
@@ -672,6 +724,11 @@ static bool drm_connector_pageflip_renderer(struct wlr_drm_connector *conn) {
 	return drm_crtc_page_flip(conn);
 }
 
+static bool modifiers_disabled(void) {
+	const char *no_modifiers = getenv("WLR_DRM_NO_MODIFIERS");
+	return no_modifiers != NULL && strcmp(no_modifiers, "1") == 0;
+}
+
 static bool drm_connector_init_renderer(struct wlr_drm_connector *conn,
 		struct wlr_drm_mode *mode) {
 	struct wlr_drm_backend *drm =
@@ -702,8 +759,7 @@ static bool drm_connector_init_renderer(struct wlr_drm_connector *conn,
 	uint32_t format = drm->renderer.gbm_format;
 
 	bool modifiers = true;
-	const char *no_modifiers = getenv("WLR_DRM_NO_MODIFIERS");
-	if (no_modifiers != NULL && strcmp(no_modifiers, "1") == 0) {
+	if (modifiers_disabled()) {
 		wlr_log(WLR_DEBUG,
 			"WLR_DRM_NO_MODIFIERS set, initializing planes without modifiers");
 		modifiers = false;
@@ -823,6 +879,292 @@ bool drm_connector_set_mode(struct wlr_drm_connector *conn,
 	return true;
 }
 
+/**
+ * Allocates a blank buffer standing in for the primary plane's surface in
+ * test-only commits, so that testing a new mode doesn't destroy the surface
+ * currently scanned out.
+ */
+static bool plane_init_test_bo(struct wlr_drm_plane *plane,
+		struct wlr_drm_backend *drm, uint32_t width, uint32_t height) {
+	uint32_t format = drm->renderer.gbm_format;
+	if (!wlr_drm_format_set_has(&plane->formats, format,
+			DRM_FORMAT_MOD_INVALID)) {
+		format = strip_alpha_channel(format);
+	}
+
+	plane->test_bo = gbm_bo_create(drm->renderer.gbm, width, height, format,
+		GBM_BO_USE_SCANOUT);
+	if (plane->test_bo == NULL) {
+		wlr_log_errno(WLR_ERROR, "Failed to allocate test buffer");
+		return false;
+	}
+	return true;
+}
+
+static bool drm_connector_stage_modeset(struct wlr_drm_connector *conn,
+		bool test_only) {
+	struct wlr_output *output = &conn->output;
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	bool enable = (output->pending.committed & WLR_OUTPUT_STATE_ENABLED) ?
+		output->pending.enabled : output->enabled;
+	if (!enable) {
+		crtc->pending_modeset = true;
+		crtc->pending.active = false;
+		return true;
+	}
+
+	struct wlr_output_mode *wlr_mode = output->current_mode;
+	if (output->pending.committed & WLR_OUTPUT_STATE_MODE) {
+		wlr_mode = drm_connector_get_pending_mode(conn);
+		if (wlr_mode == NULL) {
+			return false;
+		}
+	}
+	struct wlr_drm_mode *mode = (struct wlr_drm_mode *)wlr_mode;
+
+	crtc->pending_modeset = true;
+	crtc->pending.active = true;
+	crtc->pending.mode = mode;
+
+	struct wlr_drm_plane *plane = crtc->primary;
+	int width = mode->wlr_mode.width;
+	int height = mode->wlr_mode.height;
+	if (test_only) {
+		return plane_init_test_bo(plane, drm, width, height);
+	}
+
+	if (!drm_plane_init_surface(plane, drm, width, height,
+			drm->renderer.gbm_format, 0, !modifiers_disabled())) {
+		return false;
+	}
+	drm_surface_render_black_frame(&plane->surf);
+	return drm_fb_lock_surface(&plane->pending_fb, &plane->surf);
+}
+
+/**
+ * Fills the connector's CRTC pending state from the output's pending state.
+ * Sets `staged` if the CRTC needs to be part of the atomic commit.
+ */
+static bool drm_connector_stage(struct wlr_drm_connector *conn,
+		bool test_only, bool *staged) {
+	struct wlr_output *output = &conn->output;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	*staged = false;
+
+	bool modeset = output->pending.committed &
+		(WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_ENABLED);
+	bool enable = (output->pending.committed & WLR_OUTPUT_STATE_ENABLED) ?
+		output->pending.enabled : output->enabled;
+
+	if (crtc == NULL) {
+		if (modeset && enable) {
+			// CRTCs aren't re-allocated within a batch
+			wlr_log(WLR_ERROR, "Cannot modeset '%s': no CRTC for this "
+				"connector", output->name);
+			return false;
+		}
+		if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+			return false;
+		}
+		return true;
+	}
+
+	if (modeset) {
+		if (enable && conn->state != WLR_DRM_CONN_CONNECTED &&
+				conn->state != WLR_DRM_CONN_NEEDS_MODESET) {
+			wlr_log(WLR_ERROR, "Cannot modeset a disconnected output");
+			return false;
+		}
+		if (!drm_connector_stage_modeset(conn, test_only)) {
+			return false;
+		}
+	} else if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		// TODO: support modesetting with a buffer
+		if (conn->pageflip_pending) {
+			wlr_log(WLR_ERROR, "Failed to page-flip output '%s': "
+				"a page-flip is already pending", output->name);
+			return false;
+		}
+		// Don't consume the rendered frame when only testing
+		if (!test_only || output->pending.buffer_type ==
+				WLR_OUTPUT_STATE_BUFFER_SCANOUT) {
+			if (!drm_connector_set_pending_fb(conn)) {
+				return false;
+			}
+		}
+	} else if (!(output->pending.committed &
+			(WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
+			WLR_OUTPUT_STATE_GAMMA_LUT))) {
+		return true;
+	}
+
+	if (!crtc->current.active && !crtc->pending.active) {
+		// Nothing to tell the kernel
+		return true;
+	}
+
+	struct wlr_drm_plane *plane = crtc->primary;
+	if (crtc->pending.active && plane->test_bo == NULL &&
+			plane_get_next_fb(plane)->type == WLR_DRM_FB_TYPE_NONE) {
+		if (!test_only) {
+			wlr_log(WLR_ERROR, "Output '%s' has no buffer to scan out",
+				output->name);
+			return false;
+		}
+		struct wlr_drm_backend *drm =
+			get_drm_backend_from_backend(output->backend);
+		if (!plane_init_test_bo(plane, drm, crtc->pending.mode->wlr_mode.width,
+				crtc->pending.mode->wlr_mode.height)) {
+			return false;
+		}
+	}
+
+	*staged = true;
+	return true;
+}
+
+static void drm_connector_finish_stage(struct wlr_drm_connector *conn,
+		bool test_only, bool committed) {
+	struct wlr_output *output = &conn->output;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	bool modeset = output->pending.committed &
+		(WLR_OUTPUT_STATE_MODE | WLR_OUTPUT_STATE_ENABLED);
+	if (crtc == NULL) {
+		if (committed && modeset) {
+			conn->desired_enabled = false;
+			conn->desired_mode = NULL;
+			wlr_output_update_enabled(output, false);
+		}
+		return;
+	}
+
+	if (crtc->primary->test_bo != NULL) {
+		gbm_bo_destroy(crtc->primary->test_bo);
+		crtc->primary->test_bo = NULL;
+	}
+
+	if (test_only) {
+		crtc_finish_test(crtc);
+		return;
+	}
+
+	bool was_active = crtc->current.active;
+	crtc_finish_commit(crtc, committed);
+	if (!committed) {
+		return;
+	}
+
+	if (was_active || crtc->current.active) {
+		TRACE_ASYNC_BEGIN("drm_page_flip", crtc->id);
+		conn->pageflip_pending = true;
+	}
+
+	if (!modeset) {
+		return;
+	}
+	conn->desired_mode = NULL;
+	conn->desired_enabled = crtc->current.active;
+	if (crtc->current.active) {
+		conn->state = WLR_DRM_CONN_CONNECTED;
+		wlr_output_update_mode(output, &crtc->current.mode->wlr_mode);
+		wlr_output_update_enabled(output, true);
+		wlr_output_damage_whole(output);
+	} else {
+		wlr_output_update_enabled(output, false);
+	}
+}
+
+/**
+ * Stages all connectors, then submits a single atomic commit for all of them.
+ */
+static bool drm_commit_connectors(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector **conns, size_t conns_len,
+		struct wlr_drm_connector **staged_conns, bool test_only) {
+	size_t prepared = 0, staged_len = 0;
+	bool ok = true;
+	for (; prepared < conns_len; prepared++) {
+		bool staged;
+		if (!drm_connector_stage(conns[prepared], test_only, &staged)) {
+			ok = false;
+			// The CRTC state may have been partially filled
+			prepared++;
+			break;
+		}
+		if (staged) {
+			staged_conns[staged_len++] = conns[prepared];
+		}
+	}
+
+	if (ok && staged_len > 0) {
+		uint32_t flags = test_only ?
+			DRM_MODE_ATOMIC_TEST_ONLY : DRM_MODE_PAGE_FLIP_EVENT;
+		TRACE_BEGIN("drm_crtcs_commit");
+		ok = drm->iface->crtcs_commit(drm, staged_conns, staged_len, flags);
+		TRACE_END("drm_crtcs_commit");
+	}
+
+	for (size_t i = 0; i < prepared; i++) {
+		drm_connector_finish_stage(conns[i], test_only, ok && !test_only);
+	}
+	return ok;
+}
+
+bool drm_commit_outputs(struct wlr_drm_backend *drm,
+		struct wlr_output **outputs, size_t outputs_len, bool test_only,
+		bool *committed) {
+	if (!drm->session->active) {
+		return false;
+	}
+
+	for (size_t i = 0; i < outputs_len; i++) {
+		if (!drm_connector_test(outputs[i])) {
+			return false;
+		}
+	}
+
+	if (drm->iface->crtcs_commit == NULL) {
+		if (test_only) {
+			return true;
+		}
+		// Legacy can only update CRTCs one by one
+		for (size_t i = 0; i < outputs_len; i++) {
+			if (!drm_connector_commit(outputs[i])) {
+				return false;
+			}
+			committed[i] = true;
+		}
+		return true;
+	}
+
+	struct wlr_drm_connector **conns = calloc(2 * outputs_len, sizeof(*conns));
+	if (conns == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	struct wlr_drm_connector **staged_conns = conns + outputs_len;
+	for (size_t i = 0; i < outputs_len; i++) {
+		conns[i] = get_drm_connector_from_output(outputs[i]);
+	}
+
+	// Always try the whole configuration first: a failed modeset would
+	// leave the outputs without their previous surfaces
+	bool ok = drm_commit_connectors(drm, conns, outputs_len, staged_conns,
+		true);
+	if (ok && !test_only) {
+		ok = drm_commit_connectors(drm, conns, outputs_len, staged_conns,
+			false);
+		for (size_t i = 0; i < outputs_len; i++) {
+			committed[i] = ok;
+		}
+	}
+
+	free(conns);
+	return ok;
+}
+
 struct wlr_output_mode *wlr_drm_connector_add_mode(struct wlr_output *output,
 		const drmModeModeInfo *modeinfo) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -858,6 +1200,22 @@ struct wlr_output_mode *wlr_drm_connector_add_mode(struct wlr_output *output,
 	return &mode->wlr_mode;
 }
 
+/**
+ * Checks whether the texture holds the image of an output cursor. These are
+ * never written to, unlike the textures of cursor surfaces which may be
+ * updated in place by later commits.
+ */
+static bool is_cursor_image_texture(struct wlr_output *output,
+		struct wlr_texture *texture) {
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (cursor->surface == NULL && cursor->texture == texture) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static bool drm_connector_set_cursor(struct wlr_output *output,
 		struct wlr_texture *texture, float scale,
 		enum wl_output_transform transform,
@@ -928,30 +1286,50 @@ static bool drm_connector_set_cursor(struct wlr_output *output,
 			return false;
 		}
 
-		if (!drm_surface_make_current(&plane->surf, NULL)) {
-			return false;
+		// Images rendered before are kept in dedicated BOs, so that switching
+		// between them (e.g. animated cursors) doesn't involve the GPU
+		bool cacheable = is_cursor_image_texture(output, texture);
+		struct wlr_drm_cursor_bo *cursor_bo = NULL;
+		if (cacheable) {
+			cursor_bo = drm_plane_get_cursor_bo(plane, texture,
+				width, height, transform, output->transform);
 		}
 
-		struct wlr_renderer *rend = plane->surf.renderer->wlr_rend;
+		if (cursor_bo == NULL) {
+			if (!drm_surface_make_current(&plane->surf, NULL)) {
+				return false;
+			}
 
-		struct wlr_box cursor_box = { .width = width, .height = height };
+			struct wlr_renderer *rend = plane->surf.renderer->wlr_rend;
 
-		float matrix[9];
-		wlr_matrix_project_box(matrix, &cursor_box, transform, 0, hotspot_proj);
+			struct wlr_box cursor_box = { .width = width, .height = height };
 
-		wlr_renderer_begin(rend, plane->surf.width, plane->surf.height);
-		wlr_renderer_clear(rend, (float[]){ 0.0, 0.0, 0.0, 0.0 });
-		wlr_render_texture_with_matrix(rend, texture, matrix, 1.0);
-		wlr_renderer_end(rend);
+			float matrix[9];
+			wlr_matrix_project_box(matrix, &cursor_box, transform, 0,
+				hotspot_proj);
 
-		if (!drm_fb_lock_surface(&plane->pending_fb, &plane->surf)) {
+			wlr_renderer_begin(rend, plane->surf.width, plane->surf.height);
+			wlr_renderer_clear(rend, (float[]){ 0.0, 0.0, 0.0, 0.0 });
+			wlr_render_texture_with_matrix(rend, texture, matrix, 1.0);
+			wlr_renderer_end(rend);
+
+			if (cacheable) {
+				cursor_bo = drm_plane_add_cursor_bo(plane, drm, texture,
+					width, height, transform, output->transform);
+			}
+		}
+
+		if (cursor_bo != NULL) {
+			drm_fb_lock_cursor_bo(&plane->pending_fb, cursor_bo);
+		} else if (!drm_fb_lock_surface(&plane->pending_fb, &plane->surf)) {
 			return false;
 		}
 
 		plane->cursor_enabled = true;
 	}
 
-	if (plane->cursor_enabled) {
+	if (plane->cursor_enabled &&
+			plane->pending_fb.type == WLR_DRM_FB_TYPE_SURFACE) {
 		drm_fb_acquire(&plane->pending_fb, drm, &plane->mgpu_surf);
 		/* Workaround for nouveau buffers created with GBM_BO_USER_LINEAR are
 		 * placed in NOUVEAU_GEM_DOMAIN_GART. When the bo is attached to the
@@ -996,6 +1374,17 @@ static bool drm_connector_move_cursor(struct wlr_output *output,
 	conn->cursor_x = box.x;
 	conn->cursor_y = box.y;
 
+	// Move the cursor right away when it's already displayed, so that it
+	// doesn't lag behind when rendering is slow. Showing or hiding it still
+	// requires a frame.
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
+	if (drm->session->active && conn->crtc->current.active &&
+			!conn->crtc->pending_modeset &&
+			drm_connector_is_cursor_visible(conn) &&
+			drm->iface->crtc_move_cursor(drm, conn)) {
+		return true;
+	}
+
 	wlr_output_update_needs_frame(output);
 	return true;
 }
@@ -1029,6 +1418,7 @@ static const struct wlr_output_impl output_impl = {
 	.rollback_render = drm_connector_rollback_render,
 	.get_gamma_size = drm_connector_get_gamma_size,
 	.export_dmabuf = drm_connector_export_dmabuf,
+	.lock_front_buffer = drm_connector_lock_front_buffer,
 };
 
 bool wlr_output_is_drm(struct wlr_output *output) {
@@ -1482,11 +1872,19 @@ static void page_flip_handler(int fd, unsigned seq,
 		return;
 	}
 
+	TRACE_ASYNC_END("drm_page_flip", crtc_id);
 	conn->pageflip_pending = false;
 
 	if (conn->state != WLR_DRM_CONN_CONNECTED || conn->crtc == NULL) {
 		return;
 	}
+	if (!conn->crtc->current.active) {
+		// A batched commit disabled the CRTC, now that it's done give it to
+		// outputs waiting for one
+		realloc_crtcs(drm);
+		attempt_enable_needs_modeset(drm);
+		return;
+	}
 
 	struct wlr_drm_plane *plane = conn->crtc->primary;
 	if (plane->queued_fb.type != WLR_DRM_FB_TYPE_NONE) {
@@ -1578,6 +1976,25 @@ void restore_drm_outputs(struct wlr_drm_backend *drm) {
 	}
 }
 
+void invalidate_drm_prop_shadows(struct wlr_drm_backend *drm) {
+	for (size_t i = 0; i < drm->num_crtcs; ++i) {
+		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
+		crtc->shadow.len = 0;
+		if (crtc->primary) {
+			crtc->primary->shadow.len = 0;
+		}
+		if (crtc->cursor) {
+			crtc->cursor->shadow.len = 0;
+		}
+		crtc->legacy_cursor_enabled = false;
+	}
+
+	struct wlr_drm_connector *conn;
+	wl_list_for_each(conn, &drm->outputs, link) {
+		conn->shadow.len = 0;
+	}
+}
+
 static void drm_connector_cleanup(struct wlr_drm_connector *conn) {
 	if (!conn) {
 		return;
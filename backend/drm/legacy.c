@@ -103,12 +103,14 @@ static bool legacy_crtc_commit(struct wlr_drm_backend *drm,
 				conn->output.name);
 			return false;
 		}
+		crtc->legacy_cursor_enabled = true;
 	} else {
 		if (drmModeSetCursor(drm->fd, crtc->id, 0, 0, 0)) {
 			wlr_log_errno(WLR_DEBUG, "%s: failed to unset hardware cursor",
 				conn->output.name);
 			return false;
 		}
+		crtc->legacy_cursor_enabled = false;
 	}
 
 	if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
@@ -163,6 +165,23 @@ bool drm_legacy_crtc_set_gamma(struct wlr_drm_backend *drm,
 	return true;
 }
 
+static bool legacy_crtc_move_cursor(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	if (!crtc->legacy_cursor_enabled) {
+		return false;
+	}
+
+	if (drmModeMoveCursor(drm->fd, crtc->id,
+			conn->cursor_x, conn->cursor_y) != 0) {
+		wlr_log_errno(WLR_DEBUG, "%s: failed to move cursor",
+			conn->output.name);
+		return false;
+	}
+	return true;
+}
+
 const struct wlr_drm_interface legacy_iface = {
 	.crtc_commit = legacy_crtc_commit,
+	.crtc_move_cursor = legacy_crtc_move_cursor,
 };
@@ -13,6 +13,9 @@
 #include <wlr/util/log.h>
 #include "backend/drm/drm.h"
 
+#define CURSOR_BO_CACHE_MAX_LEN 64
+#define CURSOR_BO_CACHE_MAX_SIZE (8 * 1024 * 1024) // bytes, per plane
+
 bool init_drm_renderer(struct wlr_drm_backend *drm,
 		struct wlr_drm_renderer *renderer, wlr_renderer_create_func_t create_renderer_func) {
 	renderer->gbm = gbm_create_device(drm->fd);
@@ -62,6 +65,13 @@ void finish_drm_renderer(struct wlr_drm_renderer *renderer) {
 	gbm_device_destroy(renderer->gbm);
 }
 
+static void drm_surface_detach_locked_buffer(struct wlr_drm_surface *surf) {
+	if (surf->locked_buffer != NULL) {
+		surf->locked_buffer->surf = NULL;
+		surf->locked_buffer = NULL;
+	}
+}
+
 static bool init_drm_surface(struct wlr_drm_surface *surf,
 		struct wlr_drm_renderer *renderer, uint32_t width, uint32_t height,
 		uint32_t format, struct wlr_drm_format_set *set, uint32_t flags) {
@@ -73,6 +83,7 @@ static bool init_drm_surface(struct wlr_drm_surface *surf,
 	surf->width = width;
 	surf->height = height;
 
+	drm_surface_detach_locked_buffer(surf);
 	if (surf->gbm) {
 		gbm_surface_destroy(surf->gbm);
 		surf->gbm = NULL;
@@ -117,6 +128,7 @@ static void finish_drm_surface(struct wlr_drm_surface *surf) {
 		return;
 	}
 
+	drm_surface_detach_locked_buffer(surf);
 	wlr_egl_destroy_surface(&surf->renderer->egl, surf->egl);
 	if (surf->gbm) {
 		gbm_surface_destroy(surf->gbm);
@@ -185,6 +197,143 @@ static struct wlr_texture *get_tex_for_bo(struct wlr_drm_renderer *renderer,
 	return tex;
 }
 
+static void cursor_bo_destroy(struct wlr_drm_cursor_bo *cursor_bo) {
+	gbm_bo_destroy(cursor_bo->bo);
+	free(cursor_bo);
+}
+
+/**
+ * Removes the cursor BO from the cache. It's destroyed once it isn't
+ * referenced by any FB anymore.
+ */
+static void cursor_bo_evict(struct wlr_drm_cursor_bo *cursor_bo) {
+	wl_list_remove(&cursor_bo->link);
+	wl_list_init(&cursor_bo->link);
+	cursor_bo->plane->cursor_bos_len--;
+	wl_list_remove(&cursor_bo->texture_destroy.link);
+	wl_list_init(&cursor_bo->texture_destroy.link);
+	cursor_bo->texture = NULL;
+
+	if (cursor_bo->n_locks == 0) {
+		cursor_bo_destroy(cursor_bo);
+	}
+}
+
+static void cursor_bo_handle_texture_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_drm_cursor_bo *cursor_bo =
+		wl_container_of(listener, cursor_bo, texture_destroy);
+	cursor_bo_evict(cursor_bo);
+}
+
+struct wlr_drm_cursor_bo *drm_plane_get_cursor_bo(struct wlr_drm_plane *plane,
+		struct wlr_texture *texture, int width, int height,
+		enum wl_output_transform transform,
+		enum wl_output_transform output_transform) {
+	struct wlr_drm_cursor_bo *cursor_bo;
+	wl_list_for_each(cursor_bo, &plane->cursor_bos, link) {
+		if (cursor_bo->texture == texture &&
+				cursor_bo->width == width && cursor_bo->height == height &&
+				cursor_bo->transform == transform &&
+				cursor_bo->output_transform == output_transform) {
+			wl_list_remove(&cursor_bo->link);
+			wl_list_insert(&plane->cursor_bos, &cursor_bo->link);
+			return cursor_bo;
+		}
+	}
+	return NULL;
+}
+
+struct wlr_drm_cursor_bo *drm_plane_add_cursor_bo(struct wlr_drm_plane *plane,
+		struct wlr_drm_backend *drm, struct wlr_texture *texture,
+		int width, int height, enum wl_output_transform transform,
+		enum wl_output_transform output_transform) {
+	if (!wlr_drm_format_set_has(&plane->formats, DRM_FORMAT_ARGB8888,
+			DRM_FORMAT_MOD_INVALID)) {
+		return NULL;
+	}
+
+	uint32_t surf_width = plane->surf.width;
+	uint32_t surf_height = plane->surf.height;
+
+	// Dumb buffers can be written to from the CPU and scanned out by the
+	// device driving the plane, no need for a multi-GPU copy
+	struct gbm_bo *bo = gbm_bo_create(drm->renderer.gbm, surf_width,
+		surf_height, GBM_FORMAT_ARGB8888,
+		GBM_BO_USE_CURSOR | GBM_BO_USE_WRITE);
+	if (bo == NULL) {
+		wlr_log(WLR_DEBUG, "Failed to create cursor BO");
+		return NULL;
+	}
+
+	uint32_t stride = gbm_bo_get_stride(bo);
+	uint8_t *data = malloc((size_t)stride * surf_height);
+	if (data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		goto error_bo;
+	}
+
+	uint32_t flags = 0;
+	if (!wlr_renderer_read_pixels(plane->surf.renderer->wlr_rend,
+			WL_SHM_FORMAT_ARGB8888, &flags, stride, surf_width, surf_height,
+			0, 0, 0, 0, data)) {
+		wlr_log(WLR_DEBUG, "Failed to read back cursor image");
+		goto error_data;
+	}
+	if (flags & WLR_RENDERER_READ_PIXELS_Y_INVERT) {
+		uint8_t row[stride];
+		for (uint32_t y = 0; y < surf_height / 2; y++) {
+			uint8_t *a = data + (size_t)y * stride;
+			uint8_t *b = data + (size_t)(surf_height - y - 1) * stride;
+			memcpy(row, a, stride);
+			memcpy(a, b, stride);
+			memcpy(b, row, stride);
+		}
+	}
+
+	if (gbm_bo_write(bo, data, (size_t)stride * surf_height) != 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to write cursor BO");
+		goto error_data;
+	}
+	free(data);
+
+	struct wlr_drm_cursor_bo *cursor_bo = calloc(1, sizeof(*cursor_bo));
+	if (cursor_bo == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		goto error_bo;
+	}
+	cursor_bo->plane = plane;
+	cursor_bo->texture = texture;
+	cursor_bo->width = width;
+	cursor_bo->height = height;
+	cursor_bo->transform = transform;
+	cursor_bo->output_transform = output_transform;
+	cursor_bo->bo = bo;
+
+	cursor_bo->texture_destroy.notify = cursor_bo_handle_texture_destroy;
+	wl_signal_add(&texture->events.destroy, &cursor_bo->texture_destroy);
+
+	size_t max_len = CURSOR_BO_CACHE_MAX_SIZE / ((size_t)stride * surf_height);
+	if (max_len > CURSOR_BO_CACHE_MAX_LEN) {
+		max_len = CURSOR_BO_CACHE_MAX_LEN;
+	}
+	while (plane->cursor_bos_len > 0 && plane->cursor_bos_len >= max_len) {
+		struct wlr_drm_cursor_bo *oldest =
+			wl_container_of(plane->cursor_bos.prev, oldest, link);
+		cursor_bo_evict(oldest);
+	}
+
+	wl_list_insert(&plane->cursor_bos, &cursor_bo->link);
+	plane->cursor_bos_len++;
+	return cursor_bo;
+
+error_data:
+	free(data);
+error_bo:
+	gbm_bo_destroy(bo);
+	return NULL;
+}
+
 void drm_plane_finish_surface(struct wlr_drm_plane *plane) {
 	if (!plane) {
 		return;
@@ -194,6 +343,11 @@ void drm_plane_finish_surface(struct wlr_drm_plane *plane) {
 	drm_fb_clear(&plane->queued_fb);
 	drm_fb_clear(&plane->current_fb);
 
+	struct wlr_drm_cursor_bo *cursor_bo, *tmp;
+	wl_list_for_each_safe(cursor_bo, tmp, &plane->cursor_bos, link) {
+		cursor_bo_evict(cursor_bo);
+	}
+
 	finish_drm_surface(&plane->surf);
 	finish_drm_surface(&plane->mgpu_surf);
 }
@@ -245,19 +399,96 @@ bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 	return true;
 }
 
+static const struct wlr_buffer_impl surface_buffer_impl;
+
+static struct wlr_drm_surface_buffer *surface_buffer_from_buffer(
+		struct wlr_buffer *wlr_buffer) {
+	assert(wlr_buffer->impl == &surface_buffer_impl);
+	return (struct wlr_drm_surface_buffer *)wlr_buffer;
+}
+
+static void surface_buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct wlr_drm_surface_buffer *buffer =
+		surface_buffer_from_buffer(wlr_buffer);
+	if (buffer->surf != NULL) {
+		if (buffer->released) {
+			gbm_surface_release_buffer(buffer->surf->gbm, buffer->bo);
+		}
+		buffer->surf->locked_buffer = NULL;
+	}
+	wlr_dmabuf_attributes_finish(&buffer->attribs);
+	free(buffer);
+}
+
+static bool surface_buffer_get_dmabuf(struct wlr_buffer *wlr_buffer,
+		struct wlr_dmabuf_attributes *attribs) {
+	struct wlr_drm_surface_buffer *buffer =
+		surface_buffer_from_buffer(wlr_buffer);
+	memcpy(attribs, &buffer->attribs, sizeof(struct wlr_dmabuf_attributes));
+	return true;
+}
+
+static const struct wlr_buffer_impl surface_buffer_impl = {
+	.destroy = surface_buffer_destroy,
+	.get_dmabuf = surface_buffer_get_dmabuf,
+};
+
+struct wlr_buffer *drm_surface_lock_buffer(struct wlr_drm_surface *surf,
+		struct gbm_bo *bo) {
+	if (surf->locked_buffer != NULL) {
+		if (surf->locked_buffer->bo != bo) {
+			return NULL;
+		}
+		return wlr_buffer_lock(&surf->locked_buffer->base);
+	}
+
+	struct wlr_drm_surface_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	if (!export_drm_bo(bo, &buffer->attribs)) {
+		free(buffer);
+		return NULL;
+	}
+	wlr_buffer_init(&buffer->base, &surface_buffer_impl,
+		gbm_bo_get_width(bo), gbm_bo_get_height(bo));
+	buffer->surf = surf;
+	buffer->bo = bo;
+	surf->locked_buffer = buffer;
+
+	// Destroyed as soon as the last lock is gone
+	wlr_buffer_lock(&buffer->base);
+	wlr_buffer_drop(&buffer->base);
+	return &buffer->base;
+}
+
 void drm_fb_clear(struct wlr_drm_fb *fb) {
 	switch (fb->type) {
 	case WLR_DRM_FB_TYPE_NONE:
 		assert(!fb->bo);
 		break;
 	case WLR_DRM_FB_TYPE_SURFACE:
-		gbm_surface_release_buffer(fb->surf->gbm, fb->bo);
+		if (fb->surf->locked_buffer != NULL &&
+				fb->surf->locked_buffer->bo == fb->bo) {
+			fb->surf->locked_buffer->released = true;
+		} else {
+			gbm_surface_release_buffer(fb->surf->gbm, fb->bo);
+		}
 		break;
 	case WLR_DRM_FB_TYPE_WLR_BUFFER:
 		gbm_bo_destroy(fb->bo);
 		wlr_buffer_unlock(fb->wlr_buf);
 		fb->wlr_buf = NULL;
 		break;
+	case WLR_DRM_FB_TYPE_CURSOR_BO:
+		fb->cursor_bo->n_locks--;
+		if (fb->cursor_bo->n_locks == 0 && fb->cursor_bo->texture == NULL) {
+			// Evicted while in use
+			cursor_bo_destroy(fb->cursor_bo);
+		}
+		fb->cursor_bo = NULL;
+		break;
 	}
 
 	fb->type = WLR_DRM_FB_TYPE_NONE;
@@ -355,6 +586,16 @@ bool drm_fb_import_wlr(struct wlr_drm_fb *fb, struct wlr_drm_renderer *renderer,
 	return true;
 }
 
+void drm_fb_lock_cursor_bo(struct wlr_drm_fb *fb,
+		struct wlr_drm_cursor_bo *cursor_bo) {
+	drm_fb_clear(fb);
+
+	cursor_bo->n_locks++;
+	fb->type = WLR_DRM_FB_TYPE_CURSOR_BO;
+	fb->bo = cursor_bo->bo;
+	fb->cursor_bo = cursor_bo;
+}
+
 void drm_fb_move(struct wlr_drm_fb *new, struct wlr_drm_fb *old) {
 	drm_fb_clear(new);
 
@@ -382,7 +623,7 @@ struct gbm_bo *drm_fb_acquire(struct wlr_drm_fb *fb, struct wlr_drm_backend *drm
 		return NULL;
 	}
 
-	if (!drm->parent) {
+	if (!drm->parent || fb->type == WLR_DRM_FB_TYPE_CURSOR_BO) {
 		return fb->bo;
 	}
 
@@ -2,6 +2,7 @@
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/interfaces/wlr_input_device.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/egl.h>
@@ -22,7 +23,7 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 
 	struct wlr_headless_output *output;
 	wl_list_for_each(output, &backend->outputs, link) {
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		headless_output_start(output);
 		wlr_output_update_enabled(&output->wlr_output, true);
 		wlr_signal_emit_safe(&backend->backend.events.new_output,
 			&output->wlr_output);
@@ -94,12 +95,26 @@ static void handle_renderer_destroy(struct wl_listener *listener, void *data) {
 	backend_destroy(&backend->backend);
 }
 
+static enum wlr_headless_clock get_env_clock(void) {
+	const char *str = getenv("WLR_HEADLESS_CLOCK");
+	if (str == NULL || strcmp(str, "realtime") == 0) {
+		return WLR_HEADLESS_CLOCK_REALTIME;
+	} else if (strcmp(str, "virtual") == 0) {
+		return WLR_HEADLESS_CLOCK_VIRTUAL;
+	} else if (strcmp(str, "fast") == 0) {
+		return WLR_HEADLESS_CLOCK_FAST;
+	}
+	wlr_log(WLR_ERROR, "Unknown WLR_HEADLESS_CLOCK value: %s", str);
+	return WLR_HEADLESS_CLOCK_REALTIME;
+}
+
 static bool backend_init(struct wlr_headless_backend *backend,
 		struct wl_display *display, struct wlr_renderer *renderer) {
 	wlr_backend_init(&backend->backend, &backend_impl);
 	backend->display = display;
 	wl_list_init(&backend->outputs);
 	wl_list_init(&backend->input_devices);
+	backend->clock = get_env_clock();
 
 	backend->renderer = renderer;
 	backend->egl = wlr_gles2_renderer_get_egl(renderer);
@@ -188,6 +203,14 @@ struct wlr_backend *wlr_headless_backend_create_with_renderer(
 	return &backend->backend;
 }
 
+void wlr_headless_backend_set_clock(struct wlr_backend *wlr_backend,
+		enum wlr_headless_clock clock) {
+	struct wlr_headless_backend *backend =
+		headless_backend_from_backend(wlr_backend);
+	assert(!backend->started);
+	backend->clock = clock;
+}
+
 bool wlr_backend_is_headless(struct wlr_backend *backend) {
 	return backend->impl == &backend_impl;
 }
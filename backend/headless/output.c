@@ -1,7 +1,14 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
@@ -76,7 +83,7 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		return false;
 	}
 
-	output->frame_delay = 1000000 / refresh;
+	output->refresh_nsec = 1000000000000 / refresh;
 
 	wlr_output_update_custom_mode(&output->wlr_output, width, height, refresh);
 	return true;
@@ -133,8 +140,17 @@ static bool output_commit(struct wlr_output *wlr_output) {
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		wlr_egl_unset_current(output->backend->egl);
 
-		// Nothing needs to be done for FBOs
-		wlr_output_send_present(wlr_output, NULL);
+		// Nothing needs to be done for FBOs. The buffer is presented on the
+		// next vblank.
+		output->present_pending = true;
+		output->present_commit_seq = wlr_output->commit_seq + 1;
+
+		if (output->backend->clock == WLR_HEADLESS_CLOCK_FAST) {
+			uint64_t one = 1;
+			if (write(output->frame_event_fd, &one, sizeof(one)) < 0) {
+				wlr_log_errno(WLR_ERROR, "Failed to signal frame event");
+			}
+		}
 	}
 
 	return true;
@@ -153,6 +169,12 @@ static void output_destroy(struct wlr_output *wlr_output) {
 		headless_output_from_output(wlr_output);
 	wl_list_remove(&output->link);
 	wl_event_source_remove(output->frame_timer);
+	if (output->frame_event != NULL) {
+		wl_event_source_remove(output->frame_event);
+	}
+	if (output->frame_event_fd >= 0) {
+		close(output->frame_event_fd);
+	}
 	destroy_fbo(output);
 	free(output);
 }
@@ -168,13 +190,117 @@ bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 	return wlr_output->impl == &output_impl;
 }
 
+static uint64_t get_monotonic_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void schedule_frame_timer(struct wlr_headless_output *output,
+		uint64_t now) {
+	// Timers have a millisecond granularity: round up, so that the timer
+	// never fires before the vblank. Since deadlines are absolute, rounding
+	// errors don't accumulate.
+	uint64_t delay_nsec = output->next_frame_nsec > now ?
+		output->next_frame_nsec - now : 0;
+	int delay = (delay_nsec + 999999) / 1000000;
+	if (delay == 0) {
+		delay = 1; // A zero delay disarms the timer
+	}
+	wl_event_source_timer_update(output->frame_timer, delay);
+}
+
+static void handle_vblank(struct wlr_headless_output *output) {
+	struct wlr_output *wlr_output = &output->wlr_output;
+
+	uint64_t now = 0;
+	if (output->backend->clock != WLR_HEADLESS_CLOCK_FAST) {
+		now = get_monotonic_nsec();
+
+		// Skip the vblanks we've missed because the event loop was busy
+		uint64_t missed = 0;
+		if (now >= output->next_frame_nsec + output->refresh_nsec) {
+			missed = (now - output->next_frame_nsec) / output->refresh_nsec;
+		}
+		uint64_t deadline =
+			output->next_frame_nsec + missed * output->refresh_nsec;
+		output->next_frame_nsec = deadline + output->refresh_nsec;
+
+		if (output->backend->clock == WLR_HEADLESS_CLOCK_REALTIME) {
+			output->vblank_nsec = deadline;
+			output->vblank_seq += 1 + missed;
+		}
+	}
+	if (output->backend->clock != WLR_HEADLESS_CLOCK_REALTIME) {
+		// The simulated clock never skips a vblank, so that timestamps only
+		// depend on the number of frames
+		output->vblank_nsec += output->refresh_nsec;
+		output->vblank_seq++;
+	}
+
+	if (output->present_pending) {
+		output->present_pending = false;
+
+		struct timespec when = {
+			.tv_sec = output->vblank_nsec / 1000000000,
+			.tv_nsec = output->vblank_nsec % 1000000000,
+		};
+		struct wlr_output_event_present present_event = {
+			.commit_seq = output->present_commit_seq,
+			.when = &when,
+			.seq = output->vblank_seq,
+			.refresh = output->refresh_nsec,
+			.flags = WLR_OUTPUT_PRESENT_VSYNC,
+		};
+		wlr_output_send_present(wlr_output, &present_event);
+	}
+
+	wlr_output_send_frame(wlr_output);
+
+	if (output->backend->clock != WLR_HEADLESS_CLOCK_FAST) {
+		schedule_frame_timer(output, now);
+	}
+}
+
 static int signal_frame(void *data) {
 	struct wlr_headless_output *output = data;
-	wlr_output_send_frame(&output->wlr_output);
-	wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+	handle_vblank(output);
 	return 0;
 }
 
+static int handle_frame_event(int fd, uint32_t mask, void *data) {
+	struct wlr_headless_output *output = data;
+
+	uint64_t n;
+	if (read(fd, &n, sizeof(n)) < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to read frame event");
+		return 0;
+	}
+
+	// Only a committed frame moves the clock forward. Events are delivered
+	// through the event loop instead of an idle source, so that clients get a
+	// chance to run between frames.
+	if (output->present_pending) {
+		handle_vblank(output);
+	}
+	return 0;
+}
+
+void headless_output_start(struct wlr_headless_output *output) {
+	if (output->backend->clock == WLR_HEADLESS_CLOCK_FAST) {
+		// Kick off the first frame, the next ones follow commits
+		wlr_output_schedule_frame(&output->wlr_output);
+		return;
+	}
+
+	uint64_t now = get_monotonic_nsec();
+	if (output->backend->clock == WLR_HEADLESS_CLOCK_REALTIME) {
+		output->vblank_nsec = now;
+	}
+	output->next_frame_nsec = now + output->refresh_nsec;
+	schedule_frame_timer(output, now);
+}
+
 struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		unsigned int width, unsigned int height) {
 	struct wlr_headless_backend *backend =
@@ -187,6 +313,8 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+	output->frame_event_fd = -1;
+	wl_list_init(&output->link);
 	wlr_output_init(&output->wlr_output, &backend->backend, &output_impl,
 		backend->display);
 	struct wlr_output *wlr_output = &output->wlr_output;
@@ -217,10 +345,23 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
 	output->frame_timer = wl_event_loop_add_timer(ev, signal_frame, output);
 
+	// The clock can still be changed until the backend is started
+	output->frame_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (output->frame_event_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create eventfd");
+		goto error;
+	}
+	output->frame_event = wl_event_loop_add_fd(ev, output->frame_event_fd,
+		WL_EVENT_READABLE, handle_frame_event, output);
+	if (output->frame_event == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add frame event to event loop");
+		goto error;
+	}
+
 	wl_list_insert(&backend->outputs, &output->link);
 
 	if (backend->started) {
-		wl_event_source_timer_update(output->frame_timer, output->frame_delay);
+		headless_output_start(output);
 		wlr_output_update_enabled(wlr_output, true);
 		wlr_signal_emit_safe(&backend->backend.events.new_output, wlr_output);
 	}
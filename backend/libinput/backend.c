@@ -1,8 +1,12 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
 #include <libinput.h>
+#include <libudev.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/backend/interface.h>
 #include <wlr/backend/session.h>
+#include <wlr/backend/session/interface.h>
 #include <wlr/util/log.h>
 #include "backend/libinput.h"
 #include "util/signal.h"
@@ -16,12 +20,27 @@ static struct wlr_libinput_backend *get_libinput_backend_from_backend(
 static int libinput_open_restricted(const char *path,
 		int flags, void *_backend) {
 	struct wlr_libinput_backend *backend = _backend;
+	if (input_thread_is_current()) {
+		return input_thread_open_file(backend, path);
+	}
+
+	struct wlr_libinput_prefetched_device *prefetched;
+	wl_list_for_each(prefetched, &backend->prefetched_devices, link) {
+		if (prefetched->fd >= 0 && strcmp(prefetched->path, path) == 0) {
+			int fd = prefetched->fd;
+			wl_list_remove(&prefetched->link);
+			free(prefetched->path);
+			free(prefetched);
+			return fd;
+		}
+	}
+
 	return wlr_session_open_file(backend->session, path);
 }
 
 static void libinput_close_restricted(int fd, void *_backend) {
 	struct wlr_libinput_backend *backend = _backend;
-	wlr_session_close_file(backend->session, fd);
+	input_thread_close_file(backend, fd);
 }
 
 static const struct libinput_interface libinput_impl = {
@@ -44,6 +63,102 @@ static int handle_libinput_readable(int fd, uint32_t mask, void *_backend) {
 	return 0;
 }
 
+static void handle_prefetch_open(struct wlr_session *session, int fd,
+		void *data) {
+	struct wlr_libinput_prefetched_device *prefetched = data;
+	prefetched->request = NULL;
+	prefetched->fd = fd;
+}
+
+static void prefetch_device(struct wlr_libinput_backend *backend,
+		const char *path) {
+	struct wlr_libinput_prefetched_device *prefetched =
+		calloc(1, sizeof(*prefetched));
+	if (prefetched == NULL) {
+		return;
+	}
+	prefetched->backend = backend;
+	prefetched->fd = -1;
+	prefetched->path = strdup(path);
+	if (prefetched->path == NULL) {
+		free(prefetched);
+		return;
+	}
+
+	prefetched->request = wlr_session_open_file_async(backend->session, path,
+		handle_prefetch_open, prefetched);
+	if (prefetched->request == NULL) {
+		free(prefetched->path);
+		free(prefetched);
+		return;
+	}
+	wl_list_insert(&backend->prefetched_devices, &prefetched->link);
+}
+
+/**
+ * libinput opens devices one after the other. When opening a device is a
+ * round-trip to a remote service (e.g. logind), open all input devices of the
+ * seat in parallel first, and hand them to libinput when it asks for them.
+ */
+static void prefetch_devices(struct wlr_libinput_backend *backend) {
+	struct wlr_session *session = backend->session;
+	if (session->impl->open_async == NULL) {
+		return;
+	}
+
+	struct udev_enumerate *en = udev_enumerate_new(session->udev);
+	if (!en) {
+		wlr_log(WLR_ERROR, "Failed to create udev enumeration");
+		return;
+	}
+
+	udev_enumerate_add_match_subsystem(en, "input");
+	udev_enumerate_add_match_sysname(en, "event[0-9]*");
+	udev_enumerate_scan_devices(en);
+
+	struct udev_list_entry *entry;
+	udev_list_entry_foreach(entry, udev_enumerate_get_list_entry(en)) {
+		const char *syspath = udev_list_entry_get_name(entry);
+		struct udev_device *dev =
+			udev_device_new_from_syspath(session->udev, syspath);
+		if (!dev) {
+			continue;
+		}
+
+		const char *seat = udev_device_get_property_value(dev, "ID_SEAT");
+		if (!seat) {
+			seat = "seat0";
+		}
+		const char *devnode = udev_device_get_devnode(dev);
+		if (devnode != NULL && strcmp(session->seat, seat) == 0) {
+			prefetch_device(backend, devnode);
+		}
+
+		udev_device_unref(dev);
+	}
+
+	udev_enumerate_unref(en);
+
+	wlr_session_wait_open_requests(session);
+}
+
+static void release_prefetched_devices(struct wlr_libinput_backend *backend) {
+	// Devices libinput didn't ask for, e.g. because they aren't input
+	// devices it handles
+	struct wlr_libinput_prefetched_device *prefetched, *tmp;
+	wl_list_for_each_safe(prefetched, tmp, &backend->prefetched_devices,
+			link) {
+		if (prefetched->request != NULL) {
+			wlr_session_open_request_cancel(prefetched->request);
+		} else if (prefetched->fd >= 0) {
+			wlr_session_close_file(backend->session, prefetched->fd);
+		}
+		wl_list_remove(&prefetched->link);
+		free(prefetched->path);
+		free(prefetched);
+	}
+}
+
 static void log_libinput(struct libinput *libinput_context,
 		enum libinput_log_priority priority, const char *fmt, va_list args) {
 	_wlr_vlog(WLR_ERROR, fmt, args);
@@ -61,8 +176,11 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 		return false;
 	}
 
-	if (libinput_udev_assign_seat(backend->libinput_context,
-			backend->session->seat) != 0) {
+	prefetch_devices(backend);
+	int ret = libinput_udev_assign_seat(backend->libinput_context,
+		backend->session->seat);
+	release_prefetched_devices(backend);
+	if (ret != 0) {
 		wlr_log(WLR_ERROR, "Failed to assign libinput seat");
 		return false;
 	}
@@ -87,6 +205,15 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 		}
 	}
 
+	const char *thread = getenv("WLR_LIBINPUT_THREAD");
+	if (thread != NULL && strcmp(thread, "1") == 0) {
+		if (!input_thread_start(backend)) {
+			return false;
+		}
+		wlr_log(WLR_DEBUG, "libinput successfully initialized");
+		return true;
+	}
+
 	struct wl_event_loop *event_loop =
 		wl_display_get_event_loop(backend->display);
 	if (backend->input_event) {
@@ -109,6 +236,8 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 	struct wlr_libinput_backend *backend =
 		get_libinput_backend_from_backend(wlr_backend);
 
+	input_thread_stop(backend);
+
 	for (size_t i = 0; i < backend->wlr_device_lists.length; i++) {
 		struct wl_list *wlr_devices = backend->wlr_device_lists.items[i];
 		struct wlr_input_device *wlr_dev, *next;
@@ -120,6 +249,10 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, wlr_backend);
 
+	release_prefetched_devices(backend);
+	if (backend->resume_idle) {
+		wl_event_source_remove(backend->resume_idle);
+	}
 	wl_list_remove(&backend->display_destroy.link);
 	wl_list_remove(&backend->session_destroy.link);
 	wl_list_remove(&backend->session_signal.link);
@@ -141,6 +274,17 @@ bool wlr_backend_is_libinput(struct wlr_backend *b) {
 	return b->impl == &backend_impl;
 }
 
+static void handle_resume_idle(void *data) {
+	struct wlr_libinput_backend *backend = data;
+	backend->resume_idle = NULL;
+
+	input_thread_lock(backend);
+	prefetch_devices(backend);
+	libinput_resume(backend->libinput_context);
+	release_prefetched_devices(backend);
+	input_thread_unlock(backend);
+}
+
 static void session_signal(struct wl_listener *listener, void *data) {
 	struct wlr_libinput_backend *backend =
 		wl_container_of(listener, backend, session_signal);
@@ -151,10 +295,31 @@ static void session_signal(struct wl_listener *listener, void *data) {
 	}
 
 	if (session->active) {
-		libinput_resume(backend->libinput_context);
-	} else {
-		libinput_suspend(backend->libinput_context);
+		// The signal may be emitted from a D-Bus callback, where the session
+		// can't process the replies of prefetched devices
+		if (backend->resume_idle == NULL) {
+			struct wl_event_loop *loop =
+				wl_display_get_event_loop(backend->display);
+			backend->resume_idle =
+				wl_event_loop_add_idle(loop, handle_resume_idle, backend);
+			if (backend->resume_idle == NULL) {
+				wlr_log(WLR_ERROR, "Failed to add idle event source");
+				handle_resume_idle(backend);
+			}
+		}
+		return;
+	}
+
+	if (backend->resume_idle != NULL) {
+		// libinput hasn't been resumed yet
+		wl_event_source_remove(backend->resume_idle);
+		backend->resume_idle = NULL;
+		return;
 	}
+
+	input_thread_lock(backend);
+	libinput_suspend(backend->libinput_context);
+	input_thread_unlock(backend);
 }
 
 static void handle_session_destroy(struct wl_listener *listener, void *data) {
@@ -186,6 +351,7 @@ struct wlr_backend *wlr_libinput_backend_create(struct wl_display *display,
 
 	backend->session = session;
 	backend->display = display;
+	wl_list_init(&backend->prefetched_devices);
 
 	backend->session_signal.notify = session_signal;
 	wl_signal_add(&session->session_signal, &backend->session_signal);
@@ -23,7 +23,11 @@ static struct wlr_libinput_keyboard *get_libinput_keyboard_from_keyboard(
 static void keyboard_set_leds(struct wlr_keyboard *wlr_kb, uint32_t leds) {
 	struct wlr_libinput_keyboard *kb =
 		get_libinput_keyboard_from_keyboard(wlr_kb);
+	struct wlr_libinput_backend *backend = libinput_get_user_data(
+		libinput_device_get_context(kb->libinput_dev));
+	input_thread_lock(backend);
 	libinput_device_led_update(kb->libinput_dev, leds);
+	input_thread_unlock(backend);
 }
 
 static void keyboard_destroy(struct wlr_keyboard *wlr_kb) {
@@ -55,6 +59,16 @@ struct wlr_keyboard *create_libinput_keyboard(
 
 void handle_keyboard_key(struct libinput_event *event,
 		struct libinput_device *libinput_dev) {
+	struct libinput_event_keyboard *kbevent =
+		libinput_event_get_keyboard_event(event);
+	emit_keyboard_key(libinput_dev,
+		libinput_event_keyboard_get_time_usec(kbevent),
+		libinput_event_keyboard_get_key(kbevent),
+		libinput_event_keyboard_get_key_state(kbevent));
+}
+
+void emit_keyboard_key(struct libinput_device *libinput_dev,
+		uint64_t time_usec, uint32_t key, enum libinput_key_state state) {
 	struct wlr_input_device *wlr_dev =
 		get_appropriate_device(WLR_INPUT_DEVICE_KEYBOARD, libinput_dev);
 	if (!wlr_dev) {
@@ -62,14 +76,9 @@ void handle_keyboard_key(struct libinput_event *event,
 			"Got a keyboard event for a device with no keyboards?");
 		return;
 	}
-	struct libinput_event_keyboard *kbevent =
-		libinput_event_get_keyboard_event(event);
 	struct wlr_event_keyboard_key wlr_event = { 0 };
-	wlr_event.time_msec =
-		usec_to_msec(libinput_event_keyboard_get_time_usec(kbevent));
-	wlr_event.keycode = libinput_event_keyboard_get_key(kbevent);
-	enum libinput_key_state state =
-		libinput_event_keyboard_get_key_state(kbevent);
+	wlr_event.time_msec = usec_to_msec(time_usec);
+	wlr_event.keycode = key;
 	switch (state) {
 	case LIBINPUT_KEY_STATE_RELEASED:
 		wlr_event.state = WLR_KEY_RELEASED;
@@ -22,62 +22,87 @@ struct wlr_pointer *create_libinput_pointer(
 
 void handle_pointer_motion(struct libinput_event *event,
 		struct libinput_device *libinput_dev) {
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+	emit_pointer_motion(libinput_dev,
+		libinput_event_pointer_get_time_usec(pevent),
+		libinput_event_pointer_get_dx(pevent),
+		libinput_event_pointer_get_dy(pevent),
+		libinput_event_pointer_get_dx_unaccelerated(pevent),
+		libinput_event_pointer_get_dy_unaccelerated(pevent));
+}
+
+void emit_pointer_motion(struct libinput_device *libinput_dev,
+		uint64_t time_usec, double dx, double dy,
+		double unaccel_dx, double unaccel_dy) {
 	struct wlr_input_device *wlr_dev =
 		get_appropriate_device(WLR_INPUT_DEVICE_POINTER, libinput_dev);
 	if (!wlr_dev) {
 		wlr_log(WLR_DEBUG, "Got a pointer event for a device with no pointers?");
 		return;
 	}
-	struct libinput_event_pointer *pevent =
-		libinput_event_get_pointer_event(event);
 	struct wlr_event_pointer_motion wlr_event = { 0 };
 	wlr_event.device = wlr_dev;
-	wlr_event.time_msec =
-		usec_to_msec(libinput_event_pointer_get_time_usec(pevent));
-	wlr_event.delta_x = libinput_event_pointer_get_dx(pevent);
-	wlr_event.delta_y = libinput_event_pointer_get_dy(pevent);
-	wlr_event.unaccel_dx = libinput_event_pointer_get_dx_unaccelerated(pevent);
-	wlr_event.unaccel_dy = libinput_event_pointer_get_dy_unaccelerated(pevent);
+	wlr_event.time_msec = usec_to_msec(time_usec);
+	wlr_event.delta_x = dx;
+	wlr_event.delta_y = dy;
+	wlr_event.unaccel_dx = unaccel_dx;
+	wlr_event.unaccel_dy = unaccel_dy;
 	wlr_signal_emit_safe(&wlr_dev->pointer->events.motion, &wlr_event);
 	wlr_signal_emit_safe(&wlr_dev->pointer->events.frame, wlr_dev->pointer);
 }
 
 void handle_pointer_motion_abs(struct libinput_event *event,
 		struct libinput_device *libinput_dev) {
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+	emit_pointer_motion_abs(libinput_dev,
+		libinput_event_pointer_get_time_usec(pevent),
+		libinput_event_pointer_get_absolute_x_transformed(pevent, 1),
+		libinput_event_pointer_get_absolute_y_transformed(pevent, 1));
+}
+
+void emit_pointer_motion_abs(struct libinput_device *libinput_dev,
+		uint64_t time_usec, double x, double y) {
 	struct wlr_input_device *wlr_dev =
 		get_appropriate_device(WLR_INPUT_DEVICE_POINTER, libinput_dev);
 	if (!wlr_dev) {
 		wlr_log(WLR_DEBUG, "Got a pointer event for a device with no pointers?");
 		return;
 	}
-	struct libinput_event_pointer *pevent =
-		libinput_event_get_pointer_event(event);
 	struct wlr_event_pointer_motion_absolute wlr_event = { 0 };
 	wlr_event.device = wlr_dev;
-	wlr_event.time_msec =
-		usec_to_msec(libinput_event_pointer_get_time_usec(pevent));
-	wlr_event.x = libinput_event_pointer_get_absolute_x_transformed(pevent, 1);
-	wlr_event.y = libinput_event_pointer_get_absolute_y_transformed(pevent, 1);
+	wlr_event.time_msec = usec_to_msec(time_usec);
+	wlr_event.x = x;
+	wlr_event.y = y;
 	wlr_signal_emit_safe(&wlr_dev->pointer->events.motion_absolute, &wlr_event);
 	wlr_signal_emit_safe(&wlr_dev->pointer->events.frame, wlr_dev->pointer);
 }
 
 void handle_pointer_button(struct libinput_event *event,
 		struct libinput_device *libinput_dev) {
+	struct libinput_event_pointer *pevent =
+		libinput_event_get_pointer_event(event);
+	emit_pointer_button(libinput_dev,
+		libinput_event_pointer_get_time_usec(pevent),
+		libinput_event_pointer_get_button(pevent),
+		libinput_event_pointer_get_button_state(pevent));
+}
+
+void emit_pointer_button(struct libinput_device *libinput_dev,
+		uint64_t time_usec, uint32_t button,
+		enum libinput_button_state state) {
 	struct wlr_input_device *wlr_dev =
 		get_appropriate_device(WLR_INPUT_DEVICE_POINTER, libinput_dev);
 	if (!wlr_dev) {
 		wlr_log(WLR_DEBUG, "Got a pointer event for a device with no pointers?");
 		return;
 	}
-	struct libinput_event_pointer *pevent =
-		libinput_event_get_pointer_event(event);
 	struct wlr_event_pointer_button wlr_event = { 0 };
 	wlr_event.device = wlr_dev;
-	wlr_event.time_msec =
-		usec_to_msec(libinput_event_pointer_get_time_usec(pevent));
-	wlr_event.button = libinput_event_pointer_get_button(pevent);
-	switch (libinput_event_pointer_get_button_state(pevent)) {
+	wlr_event.time_msec = usec_to_msec(time_usec);
+	wlr_event.button = button;
+	switch (state) {
 	case LIBINPUT_BUTTON_STATE_PRESSED:
 		wlr_event.state = WLR_BUTTON_PRESSED;
 		break;
@@ -0,0 +1,398 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <libinput.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wlr/backend/session.h>
+#include <wlr/util/log.h>
+#include "backend/libinput.h"
+#include "util/thread.h"
+
+static _Thread_local bool is_input_thread = false;
+
+bool input_thread_is_current(void) {
+	return is_input_thread;
+}
+
+static void signal_eventfd(int fd) {
+	uint64_t one = 1;
+	if (write(fd, &one, sizeof(one)) < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to write to eventfd");
+	}
+}
+
+static void drain_eventfd(int fd) {
+	uint64_t n;
+	if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "Failed to read from eventfd");
+	}
+}
+
+static bool translate_event(struct libinput_event *event,
+		struct wlr_libinput_queued_event *qevent) {
+	struct libinput_event_pointer *pevent;
+	struct libinput_event_keyboard *kbevent;
+	switch (qevent->type) {
+	case LIBINPUT_EVENT_POINTER_MOTION:
+		pevent = libinput_event_get_pointer_event(event);
+		qevent->time_usec = libinput_event_pointer_get_time_usec(pevent);
+		qevent->motion.dx = libinput_event_pointer_get_dx(pevent);
+		qevent->motion.dy = libinput_event_pointer_get_dy(pevent);
+		qevent->motion.unaccel_dx =
+			libinput_event_pointer_get_dx_unaccelerated(pevent);
+		qevent->motion.unaccel_dy =
+			libinput_event_pointer_get_dy_unaccelerated(pevent);
+		return true;
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+		pevent = libinput_event_get_pointer_event(event);
+		qevent->time_usec = libinput_event_pointer_get_time_usec(pevent);
+		qevent->motion_abs.x =
+			libinput_event_pointer_get_absolute_x_transformed(pevent, 1);
+		qevent->motion_abs.y =
+			libinput_event_pointer_get_absolute_y_transformed(pevent, 1);
+		return true;
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+		pevent = libinput_event_get_pointer_event(event);
+		qevent->time_usec = libinput_event_pointer_get_time_usec(pevent);
+		qevent->button.button = libinput_event_pointer_get_button(pevent);
+		qevent->button.state =
+			libinput_event_pointer_get_button_state(pevent);
+		return true;
+	case LIBINPUT_EVENT_KEYBOARD_KEY:
+		kbevent = libinput_event_get_keyboard_event(event);
+		qevent->time_usec = libinput_event_keyboard_get_time_usec(kbevent);
+		qevent->key.key = libinput_event_keyboard_get_key(kbevent);
+		qevent->key.state = libinput_event_keyboard_get_key_state(kbevent);
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void emit_queued_event(struct wlr_libinput_queued_event *qevent) {
+	switch (qevent->type) {
+	case LIBINPUT_EVENT_POINTER_MOTION:
+		emit_pointer_motion(qevent->device, qevent->time_usec,
+			qevent->motion.dx, qevent->motion.dy,
+			qevent->motion.unaccel_dx, qevent->motion.unaccel_dy);
+		break;
+	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
+		emit_pointer_motion_abs(qevent->device, qevent->time_usec,
+			qevent->motion_abs.x, qevent->motion_abs.y);
+		break;
+	case LIBINPUT_EVENT_POINTER_BUTTON:
+		emit_pointer_button(qevent->device, qevent->time_usec,
+			qevent->button.button, qevent->button.state);
+		break;
+	case LIBINPUT_EVENT_KEYBOARD_KEY:
+		emit_keyboard_key(qevent->device, qevent->time_usec,
+			qevent->key.key, qevent->key.state);
+		break;
+	default:
+		abort(); // unreachable
+	}
+}
+
+/**
+ * Moves events from the libinput context to the queue, until either is
+ * empty. Called on the input thread with the lock held.
+ */
+static size_t queue_events(struct wlr_libinput_input_thread *thread,
+		struct libinput *libinput_context) {
+	size_t n = 0;
+	size_t tail = atomic_load_explicit(&thread->tail, memory_order_relaxed);
+	while (true) {
+		if (tail - atomic_load(&thread->head) == INPUT_QUEUE_SIZE) {
+			atomic_store(&thread->producer_blocked, true);
+			// The main thread may have drained the queue in-between
+			if (tail - atomic_load(&thread->head) == INPUT_QUEUE_SIZE) {
+				break;
+			}
+			atomic_store(&thread->producer_blocked, false);
+		}
+
+		struct libinput_event *event = libinput_get_event(libinput_context);
+		if (event == NULL) {
+			break;
+		}
+
+		struct wlr_libinput_queued_event *qevent =
+			&thread->queue[tail & (INPUT_QUEUE_SIZE - 1)];
+		*qevent = (struct wlr_libinput_queued_event){
+			.type = libinput_event_get_type(event),
+			.device = libinput_event_get_device(event),
+		};
+		if (translate_event(event, qevent)) {
+			libinput_event_destroy(event);
+		} else {
+			qevent->event = event;
+		}
+
+		tail++;
+		n++;
+		atomic_store_explicit(&thread->tail, tail, memory_order_release);
+	}
+	return n;
+}
+
+static void *input_thread_run(void *data) {
+	struct wlr_libinput_backend *backend = data;
+	struct wlr_libinput_input_thread *thread = backend->input_thread;
+	is_input_thread = true;
+
+	struct pollfd fds[] = {
+		{ .fd = libinput_get_fd(backend->libinput_context) },
+		{ .fd = thread->wake_thread_fd, .events = POLLIN },
+	};
+	while (true) {
+		// Leave the events in the kernel while the queue is full
+		fds[0].events =
+			atomic_load(&thread->producer_blocked) ? 0 : POLLIN;
+		if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			wlr_log_errno(WLR_ERROR, "Failed to poll libinput");
+			break;
+		}
+		if (fds[1].revents & POLLIN) {
+			drain_eventfd(thread->wake_thread_fd);
+		}
+
+		pthread_mutex_lock(&thread->lock);
+		if (atomic_load(&thread->stopping)) {
+			pthread_mutex_unlock(&thread->lock);
+			break;
+		}
+		if (libinput_dispatch(backend->libinput_context) != 0) {
+			wlr_log(WLR_ERROR, "Failed to dispatch libinput");
+		}
+		size_t n = queue_events(thread, backend->libinput_context);
+		pthread_mutex_unlock(&thread->lock);
+
+		// The main thread may be waiting for the lock
+		pthread_mutex_lock(&thread->mailbox_mutex);
+		pthread_cond_broadcast(&thread->mailbox_cond);
+		pthread_mutex_unlock(&thread->mailbox_mutex);
+
+		if (n > 0) {
+			signal_eventfd(thread->wake_main_fd);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Opens or closes the file requested by the input thread. Called on the main
+ * thread with the mailbox mutex held.
+ */
+static void handle_request(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_input_thread *thread = backend->input_thread;
+	if (thread->request_path != NULL) {
+		thread->request_fd =
+			wlr_session_open_file(backend->session, thread->request_path);
+	} else {
+		wlr_session_close_file(backend->session, thread->request_fd);
+	}
+	thread->request_pending = false;
+	pthread_cond_broadcast(&thread->mailbox_cond);
+}
+
+static int forward_request(struct wlr_libinput_input_thread *thread,
+		const char *path, int fd) {
+	pthread_mutex_lock(&thread->mailbox_mutex);
+	thread->request_path = path;
+	thread->request_fd = fd;
+	thread->request_pending = true;
+	pthread_cond_broadcast(&thread->mailbox_cond);
+	signal_eventfd(thread->wake_main_fd);
+	while (thread->request_pending) {
+		pthread_cond_wait(&thread->mailbox_cond, &thread->mailbox_mutex);
+	}
+	fd = thread->request_fd;
+	pthread_mutex_unlock(&thread->mailbox_mutex);
+	return fd;
+}
+
+int input_thread_open_file(struct wlr_libinput_backend *backend,
+		const char *path) {
+	if (is_input_thread) {
+		return forward_request(backend->input_thread, path, -1);
+	}
+	return wlr_session_open_file(backend->session, path);
+}
+
+void input_thread_close_file(struct wlr_libinput_backend *backend, int fd) {
+	if (is_input_thread) {
+		forward_request(backend->input_thread, NULL, fd);
+		return;
+	}
+	wlr_session_close_file(backend->session, fd);
+}
+
+void input_thread_lock(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_input_thread *thread = backend->input_thread;
+	if (thread == NULL) {
+		return;
+	}
+
+	// The input thread may need us to open a file before it can release the
+	// lock
+	pthread_mutex_lock(&thread->mailbox_mutex);
+	while (pthread_mutex_trylock(&thread->lock) != 0) {
+		if (thread->request_pending) {
+			handle_request(backend);
+			continue;
+		}
+		pthread_cond_wait(&thread->mailbox_cond, &thread->mailbox_mutex);
+	}
+	pthread_mutex_unlock(&thread->mailbox_mutex);
+}
+
+void input_thread_unlock(struct wlr_libinput_backend *backend) {
+	if (backend->input_thread != NULL) {
+		pthread_mutex_unlock(&backend->input_thread->lock);
+	}
+}
+
+static int handle_wake_main(int fd, uint32_t mask, void *data) {
+	struct wlr_libinput_backend *backend = data;
+	struct wlr_libinput_input_thread *thread = backend->input_thread;
+
+	drain_eventfd(fd);
+
+	pthread_mutex_lock(&thread->mailbox_mutex);
+	if (thread->request_pending) {
+		handle_request(backend);
+	}
+	pthread_mutex_unlock(&thread->mailbox_mutex);
+
+	size_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&thread->tail, memory_order_acquire);
+	while (head != tail) {
+		struct wlr_libinput_queued_event *qevent =
+			&thread->queue[head & (INPUT_QUEUE_SIZE - 1)];
+		if (qevent->event != NULL) {
+			input_thread_lock(backend);
+			handle_libinput_event(backend, qevent->event);
+			libinput_event_destroy(qevent->event);
+			input_thread_unlock(backend);
+		} else {
+			// Translated events don't reference libinput objects, so the
+			// input thread doesn't need to be stopped
+			emit_queued_event(qevent);
+		}
+
+		head++;
+		atomic_store(&thread->head, head);
+		if (head == tail) {
+			tail = atomic_load_explicit(&thread->tail, memory_order_acquire);
+		}
+	}
+
+	if (atomic_exchange(&thread->producer_blocked, false)) {
+		signal_eventfd(thread->wake_thread_fd);
+	}
+	return 0;
+}
+
+static void thread_destroy(struct wlr_libinput_input_thread *thread) {
+	if (thread->wake_main_event != NULL) {
+		wl_event_source_remove(thread->wake_main_event);
+	}
+	if (thread->wake_main_fd >= 0) {
+		close(thread->wake_main_fd);
+	}
+	if (thread->wake_thread_fd >= 0) {
+		close(thread->wake_thread_fd);
+	}
+	pthread_cond_destroy(&thread->mailbox_cond);
+	pthread_mutex_destroy(&thread->mailbox_mutex);
+	pthread_mutex_destroy(&thread->lock);
+	free(thread);
+}
+
+bool input_thread_start(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_input_thread *thread = calloc(1, sizeof(*thread));
+	if (thread == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&thread->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+	pthread_mutex_init(&thread->mailbox_mutex, NULL);
+	pthread_cond_init(&thread->mailbox_cond, NULL);
+
+	thread->wake_main_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	thread->wake_thread_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (thread->wake_main_fd < 0 || thread->wake_thread_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create eventfd");
+		goto error;
+	}
+
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(backend->display);
+	thread->wake_main_event = wl_event_loop_add_fd(event_loop,
+		thread->wake_main_fd, WL_EVENT_READABLE, handle_wake_main, backend);
+	if (thread->wake_main_event == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create input event on event loop");
+		goto error;
+	}
+
+	backend->input_thread = thread;
+
+	int ret = create_thread_without_signals(&thread->thread,
+		input_thread_run, backend);
+	if (ret != 0) {
+		wlr_log(WLR_ERROR, "Failed to create input thread: %s",
+			strerror(ret));
+		backend->input_thread = NULL;
+		goto error;
+	}
+
+	wlr_log(WLR_DEBUG, "Started libinput thread");
+	return true;
+
+error:
+	thread_destroy(thread);
+	return false;
+}
+
+void input_thread_stop(struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_input_thread *thread = backend->input_thread;
+	if (thread == NULL) {
+		return;
+	}
+
+	// Holding the lock ensures the thread isn't waiting for us to open a
+	// file when it notices it needs to stop
+	input_thread_lock(backend);
+	atomic_store(&thread->stopping, true);
+	input_thread_unlock(backend);
+	signal_eventfd(thread->wake_thread_fd);
+	pthread_join(thread->thread, NULL);
+
+	backend->input_thread = NULL;
+
+	// Drop events nobody will handle
+	size_t head = atomic_load(&thread->head);
+	size_t tail = atomic_load(&thread->tail);
+	for (; head != tail; head++) {
+		struct wlr_libinput_queued_event *qevent =
+			&thread->queue[head & (INPUT_QUEUE_SIZE - 1)];
+		if (qevent->event != NULL) {
+			libinput_event_destroy(qevent->event);
+		}
+	}
+
+	thread_destroy(thread);
+}
@@ -5,7 +5,9 @@
 #include <time.h>
 #include <wlr/backend/interface.h>
 #include <wlr/backend/session.h>
+#include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
+#include "backend/backend.h"
 #include "backend/multi.h"
 #include "util/signal.h"
 
@@ -96,12 +98,90 @@ static clockid_t multi_backend_get_presentation_clock(
 	return CLOCK_MONOTONIC;
 }
 
+struct subbackend_commit {
+	struct wlr_output **outputs;
+	size_t *indices; // in the outputs passed to the multi-backend
+	bool *committed;
+};
+
+/**
+ * Tests or commits the outputs belonging to each sub-backend in turn. Returns
+ * false as soon as one sub-backend fails. The outputs committed until then are
+ * reported in `committed`.
+ */
+static bool commit_subbackend_outputs(struct wlr_multi_backend *multi,
+		struct wlr_output **outputs, size_t outputs_len,
+		struct subbackend_commit *sub_commit, bool test_only,
+		bool *committed) {
+	struct subbackend_state *sub;
+	wl_list_for_each(sub, &multi->backends, link) {
+		size_t sub_outputs_len = 0;
+		for (size_t i = 0; i < outputs_len; i++) {
+			if (outputs[i]->backend == sub->backend) {
+				sub_commit->outputs[sub_outputs_len] = outputs[i];
+				sub_commit->indices[sub_outputs_len] = i;
+				sub_commit->committed[sub_outputs_len] = false;
+				sub_outputs_len++;
+			}
+		}
+		if (sub_outputs_len == 0) {
+			continue;
+		}
+
+		bool ok = backend_commit_outputs(sub->backend, sub_commit->outputs,
+			sub_outputs_len, test_only, sub_commit->committed);
+		if (!test_only) {
+			for (size_t i = 0; i < sub_outputs_len; i++) {
+				committed[sub_commit->indices[i]] = sub_commit->committed[i];
+			}
+		}
+		if (!ok) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool multi_backend_commit_outputs(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len, bool test_only,
+		bool *committed) {
+	struct wlr_multi_backend *multi = multi_backend_from_backend(backend);
+
+	struct subbackend_commit sub_commit = {
+		.outputs = calloc(outputs_len, sizeof(struct wlr_output *)),
+		.indices = calloc(outputs_len, sizeof(size_t)),
+		.committed = calloc(outputs_len, sizeof(bool)),
+	};
+	bool ok = sub_commit.outputs != NULL && sub_commit.indices != NULL &&
+		sub_commit.committed != NULL;
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		goto out;
+	}
+
+	// Sub-backends can't be committed atomically together, at least make
+	// sure they all accept the new state before touching any of them
+	ok = commit_subbackend_outputs(multi, outputs, outputs_len, &sub_commit,
+		true, NULL);
+	if (ok && !test_only) {
+		ok = commit_subbackend_outputs(multi, outputs, outputs_len,
+			&sub_commit, false, committed);
+	}
+
+out:
+	free(sub_commit.outputs);
+	free(sub_commit.indices);
+	free(sub_commit.committed);
+	return ok;
+}
+
 struct wlr_backend_impl backend_impl = {
 	.start = multi_backend_start,
 	.destroy = multi_backend_destroy,
 	.get_renderer = multi_backend_get_renderer,
 	.get_session = multi_backend_get_session,
 	.get_presentation_clock = multi_backend_get_presentation_clock,
+	.commit_outputs = multi_backend_commit_outputs,
 };
 
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
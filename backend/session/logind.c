@@ -50,6 +50,40 @@ static struct logind_session *logind_session_from_session(
 	return (struct logind_session *)base;
 }
 
+static bool stat_device(struct logind_session *session, const char *path,
+		struct stat *st) {
+	if (stat(path, st) < 0) {
+		wlr_log(WLR_ERROR, "Failed to stat '%s'", path);
+		return false;
+	}
+
+	if (major(st->st_rdev) == DRM_MAJOR) {
+		session->has_drm = true;
+	}
+	return true;
+}
+
+static int read_take_device_reply(sd_bus_message *msg, const char *path) {
+	int fd = -1;
+	int paused = 0;
+	int ret = sd_bus_message_read(msg, "hb", &fd, &paused);
+	if (ret < 0) {
+		wlr_log(WLR_ERROR, "Failed to parse D-Bus response for '%s': %s",
+			path, strerror(-ret));
+		return -1;
+	}
+
+	// The original fd seems to be closed when the message is freed
+	// so we just clone it.
+	fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to clone file descriptor for '%s': %s",
+			path, strerror(errno));
+		return -1;
+	}
+	return fd;
+}
+
 static int logind_take_device(struct wlr_session *base, const char *path) {
 	struct logind_session *session = logind_session_from_session(base);
 
@@ -59,15 +93,10 @@ static int logind_take_device(struct wlr_session *base, const char *path) {
 	sd_bus_error error = SD_BUS_ERROR_NULL;
 
 	struct stat st;
-	if (stat(path, &st) < 0) {
-		wlr_log(WLR_ERROR, "Failed to stat '%s'", path);
+	if (!stat_device(session, path, &st)) {
 		return -1;
 	}
 
-	if (major(st.st_rdev) == DRM_MAJOR) {
-		session->has_drm = true;
-	}
-
 	ret = sd_bus_call_method(session->bus, "org.freedesktop.login1",
 		session->path, "org.freedesktop.login1.Session", "TakeDevice",
 		&error, &msg, "uu", major(st.st_rdev), minor(st.st_rdev));
@@ -77,22 +106,7 @@ static int logind_take_device(struct wlr_session *base, const char *path) {
 		goto out;
 	}
 
-	int paused = 0;
-	ret = sd_bus_message_read(msg, "hb", &fd, &paused);
-	if (ret < 0) {
-		wlr_log(WLR_ERROR, "Failed to parse D-Bus response for '%s': %s",
-			path, strerror(-ret));
-		goto out;
-	}
-
-	// The original fd seems to be closed when the message is freed
-	// so we just clone it.
-	fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
-	if (fd < 0) {
-		wlr_log(WLR_ERROR, "Failed to clone file descriptor for '%s': %s",
-			path, strerror(errno));
-		goto out;
-	}
+	fd = read_take_device_reply(msg, path);
 
 out:
 	sd_bus_error_free(&error);
@@ -100,6 +114,82 @@ out:
 	return fd;
 }
 
+static int take_device_handler(sd_bus_message *msg, void *userdata,
+		sd_bus_error *ret_error) {
+	struct wlr_session_open_request *request = userdata;
+
+	sd_bus_slot *slot = request->impl_data;
+	request->impl_data = NULL;
+
+	int fd = -1;
+	const sd_bus_error *error = sd_bus_message_get_error(msg);
+	if (error != NULL) {
+		wlr_log(WLR_ERROR, "Failed to take device '%s': %s", request->path,
+			error->message);
+	} else {
+		fd = read_take_device_reply(msg, request->path);
+	}
+
+	wlr_session_open_request_finish(request, fd);
+	sd_bus_slot_unref(slot);
+	return 0;
+}
+
+static bool logind_take_device_async(struct wlr_session *base,
+		struct wlr_session_open_request *request) {
+	struct logind_session *session = logind_session_from_session(base);
+
+	struct stat st;
+	if (!stat_device(session, request->path, &st)) {
+		return false;
+	}
+
+	sd_bus_slot *slot = NULL;
+	int ret = sd_bus_call_method_async(session->bus, &slot,
+		"org.freedesktop.login1", session->path,
+		"org.freedesktop.login1.Session", "TakeDevice",
+		take_device_handler, request, "uu",
+		major(st.st_rdev), minor(st.st_rdev));
+	if (ret < 0) {
+		wlr_log(WLR_ERROR, "Failed to take device '%s': %s", request->path,
+			strerror(-ret));
+		return false;
+	}
+
+	request->impl_data = slot;
+	return true;
+}
+
+static void logind_destroy_open_request(struct wlr_session *base,
+		struct wlr_session_open_request *request) {
+	// Drops the reply callback. If logind hands us the device anyway, it'll
+	// be released along with the session.
+	sd_bus_slot_unref(request->impl_data);
+	request->impl_data = NULL;
+}
+
+static void logind_wait_open_requests(struct wlr_session *base) {
+	struct logind_session *session = logind_session_from_session(base);
+
+	while (!wl_list_empty(&base->open_requests)) {
+		int ret = sd_bus_process(session->bus, NULL);
+		if (ret < 0) {
+			wlr_log(WLR_ERROR, "Failed to process D-Bus messages: %s",
+				strerror(-ret));
+			return;
+		} else if (ret > 0) {
+			continue;
+		}
+
+		ret = sd_bus_wait(session->bus, UINT64_MAX);
+		if (ret < 0) {
+			wlr_log(WLR_ERROR, "Failed to wait for D-Bus messages: %s",
+				strerror(-ret));
+			return;
+		}
+	}
+}
+
 static void logind_release_device(struct wlr_session *base, int fd) {
 	struct logind_session *session = logind_session_from_session(base);
 
@@ -838,6 +928,9 @@ const struct session_impl session_logind = {
 	.create = logind_session_create,
 	.destroy = logind_session_destroy,
 	.open = logind_take_device,
+	.open_async = logind_take_device_async,
+	.destroy_open_request = logind_destroy_open_request,
+	.wait_open_requests = logind_wait_open_requests,
 	.close = logind_release_device,
 	.change_vt = logind_change_vt,
 };
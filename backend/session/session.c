@@ -27,6 +27,8 @@ static const struct session_impl *impls[] = {
 	NULL,
 };
 
+static void open_request_destroy(struct wlr_session_open_request *request);
+
 static int udev_event(int fd, uint32_t mask, void *data) {
 	struct wlr_session *session = data;
 
@@ -101,6 +103,8 @@ struct wlr_session *wlr_session_create(struct wl_display *disp) {
 	wl_signal_init(&session->session_signal);
 	wl_signal_init(&session->events.destroy);
 	wl_list_init(&session->devices);
+	wl_list_init(&session->open_requests);
+	session->event_loop = wl_display_get_event_loop(disp);
 
 	session->udev = udev_new();
 	if (!session->udev) {
@@ -117,10 +121,9 @@ struct wlr_session *wlr_session_create(struct wl_display *disp) {
 	udev_monitor_filter_add_match_subsystem_devtype(session->mon, "drm", NULL);
 	udev_monitor_enable_receiving(session->mon);
 
-	struct wl_event_loop *event_loop = wl_display_get_event_loop(disp);
 	int fd = udev_monitor_get_fd(session->mon);
 
-	session->udev_event = wl_event_loop_add_fd(event_loop, fd,
+	session->udev_event = wl_event_loop_add_fd(session->event_loop, fd,
 		WL_EVENT_READABLE, udev_event, session);
 	if (!session->udev_event) {
 		wlr_log_errno(WLR_ERROR, "Failed to create udev event source");
@@ -149,6 +152,12 @@ void wlr_session_destroy(struct wlr_session *session) {
 	wlr_signal_emit_safe(&session->events.destroy, session);
 	wl_list_remove(&session->display_destroy.link);
 
+	struct wlr_session_open_request *request, *request_tmp;
+	wl_list_for_each_safe(request, request_tmp, &session->open_requests,
+			link) {
+		open_request_destroy(request);
+	}
+
 	wl_event_source_remove(session->udev_event);
 	udev_monitor_unref(session->mon);
 	udev_unref(session->udev);
@@ -156,36 +165,155 @@ void wlr_session_destroy(struct wlr_session *session) {
 	session->impl->destroy(session);
 }
 
-int wlr_session_open_file(struct wlr_session *session, const char *path) {
-	int fd = session->impl->open(session, path);
-	if (fd < 0) {
-		return fd;
-	}
-
+static void session_add_device(struct wlr_session *session, int fd) {
 	struct wlr_device *dev = malloc(sizeof(*dev));
 	if (!dev) {
 		wlr_log_errno(WLR_ERROR, "Allocation failed");
-		goto error;
+		return;
 	}
 
 	struct stat st;
 	if (fstat(fd, &st) < 0) {
 		wlr_log_errno(WLR_ERROR, "Stat failed");
-		goto error;
+		free(dev);
+		return;
 	}
 
 	dev->fd = fd;
 	dev->dev = st.st_rdev;
 	wl_signal_init(&dev->signal);
 	wl_list_insert(&session->devices, &dev->link);
+}
 
-	return fd;
+int wlr_session_open_file(struct wlr_session *session, const char *path) {
+	int fd = session->impl->open(session, path);
+	if (fd < 0) {
+		return fd;
+	}
 
-error:
-	free(dev);
+	session_add_device(session, fd);
 	return fd;
 }
 
+static void open_request_destroy(struct wlr_session_open_request *request) {
+	struct wlr_session *session = request->session;
+	if (request->idle != NULL) {
+		wl_event_source_remove(request->idle);
+		if (request->fd >= 0) {
+			session->impl->close(session, request->fd);
+		}
+	} else if (session->impl->destroy_open_request) {
+		session->impl->destroy_open_request(session, request);
+	}
+	wl_list_remove(&request->link);
+	free(request->path);
+	free(request);
+}
+
+void wlr_session_open_request_finish(struct wlr_session_open_request *request,
+		int fd) {
+	struct wlr_session *session = request->session;
+	wl_list_remove(&request->link);
+
+	if (fd >= 0) {
+		session_add_device(session, fd);
+	}
+
+	if (request->callback != NULL) {
+		request->callback(session, fd, request->data);
+	} else if (fd >= 0) {
+		// The request has been cancelled
+		wlr_session_close_file(session, fd);
+	}
+
+	free(request->path);
+	free(request);
+}
+
+static void open_request_handle_idle(void *data) {
+	struct wlr_session_open_request *request = data;
+	request->idle = NULL;
+	wlr_session_open_request_finish(request, request->fd);
+}
+
+struct wlr_session_open_request *wlr_session_open_file_async(
+		struct wlr_session *session, const char *path,
+		wlr_session_open_func_t callback, void *data) {
+	struct wlr_session_open_request *request = calloc(1, sizeof(*request));
+	if (request == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	request->session = session;
+	request->callback = callback;
+	request->data = data;
+	request->fd = -1;
+	request->path = strdup(path);
+	if (request->path == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(request);
+		return NULL;
+	}
+	wl_list_insert(session->open_requests.prev, &request->link);
+
+	if (session->impl->open_async) {
+		if (!session->impl->open_async(session, request)) {
+			wl_list_remove(&request->link);
+			free(request->path);
+			free(request);
+			return NULL;
+		}
+		return request;
+	}
+
+	request->idle = wl_event_loop_add_idle(session->event_loop,
+		open_request_handle_idle, request);
+	if (request->idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add idle event source");
+		wl_list_remove(&request->link);
+		free(request->path);
+		free(request);
+		return NULL;
+	}
+	request->fd = session->impl->open(session, path);
+	return request;
+}
+
+void wlr_session_open_request_cancel(
+		struct wlr_session_open_request *request) {
+	if (request->idle != NULL) {
+		open_request_destroy(request);
+		return;
+	}
+	// Asynchronous requests can't be interrupted, the file will be closed
+	// when the request finishes
+	request->callback = NULL;
+}
+
+void wlr_session_wait_open_requests(struct wlr_session *session) {
+	// Callbacks may cancel other requests, so restart from the beginning
+	// after each one
+	bool found = true;
+	while (found) {
+		found = false;
+		struct wlr_session_open_request *request;
+		wl_list_for_each(request, &session->open_requests, link) {
+			if (request->idle != NULL) {
+				wl_event_source_remove(request->idle);
+				request->idle = NULL;
+				wlr_session_open_request_finish(request, request->fd);
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if (!wl_list_empty(&session->open_requests) &&
+			session->impl->wait_open_requests) {
+		session->impl->wait_open_requests(session);
+	}
+}
+
 static struct wlr_device *find_device(struct wlr_session *session, int fd) {
 	struct wlr_device *dev;
 
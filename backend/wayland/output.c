@@ -33,6 +33,18 @@ static void surface_frame_callback(void *data, struct wl_callback *cb,
 	assert(output);
 	wl_callback_destroy(cb);
 	output->frame_callback = NULL;
+	output->frame_seq++;
+
+	if (output->present_pending) {
+		// The remote compositor doesn't support presentation feedback, the
+		// frame callback is the best hint that the buffer has been shown
+		output->present_pending = false;
+		struct wlr_output_event_present event = {
+			.commit_seq = output->present_commit_seq,
+			.seq = output->frame_seq,
+		};
+		wlr_output_send_present(&output->wlr_output, &event);
+	}
 
 	wlr_output_send_frame(&output->wlr_output);
 }
@@ -58,6 +70,17 @@ static void presentation_feedback_handle_presented(void *data,
 		uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh_ns,
 		uint32_t seq_hi, uint32_t seq_lo, uint32_t flags) {
 	struct wlr_wl_presentation_feedback *feedback = data;
+	struct wlr_output *wlr_output = &feedback->output->wlr_output;
+
+	// Follow the refresh rate of the remote output, so that compositors can
+	// pace their clients
+	if (refresh_ns != 0) {
+		int32_t refresh = (int32_t)(1000000000000ll / refresh_ns);
+		if (refresh != wlr_output->refresh) {
+			wlr_output_update_custom_mode(wlr_output, wlr_output->width,
+				wlr_output->height, refresh);
+		}
+	}
 
 	struct timespec t = {
 		.tv_sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo,
@@ -70,7 +93,7 @@ static void presentation_feedback_handle_presented(void *data,
 		.refresh = refresh_ns,
 		.flags = flags,
 	};
-	wlr_output_send_present(&feedback->output->wlr_output, &event);
+	wlr_output_send_present(wlr_output, &event);
 
 	presentation_feedback_destroy(feedback);
 }
@@ -95,7 +118,9 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output,
 		int32_t width, int32_t height, int32_t refresh) {
 	struct wlr_wl_output *output = get_wl_output_from_output(wlr_output);
 	wl_egl_window_resize(output->egl_window, width, height, 0, 0);
-	wlr_output_update_custom_mode(&output->wlr_output, width, height, 0);
+	// The refresh rate is dictated by the remote compositor
+	wlr_output_update_custom_mode(&output->wlr_output, width, height,
+		output->wlr_output.refresh);
 	return true;
 }
 
@@ -294,7 +319,8 @@ static bool output_commit(struct wlr_output *wlr_output) {
 			wp_presentation_feedback_add_listener(wp_feedback,
 				&presentation_feedback_listener, feedback);
 		} else {
-			wlr_output_send_present(wlr_output, NULL);
+			output->present_pending = true;
+			output->present_commit_seq = output->wlr_output.commit_seq + 1;
 		}
 	}
 
@@ -3,6 +3,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <xcb/xcb.h>
 #include <xcb/xinput.h>
@@ -17,7 +18,24 @@
 
 static int signal_frame(void *data) {
 	struct wlr_x11_output *output = data;
-	wlr_output_send_frame(&output->wlr_output);
+	struct wlr_output *wlr_output = &output->wlr_output;
+
+	output->vblank_seq++;
+	if (output->present_pending) {
+		output->present_pending = false;
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		struct wlr_output_event_present present_event = {
+			.commit_seq = output->present_commit_seq,
+			.when = &now,
+			.seq = output->vblank_seq,
+			.refresh = output->refresh_nsec,
+		};
+		wlr_output_send_present(wlr_output, &present_event);
+	}
+
+	wlr_output_send_frame(wlr_output);
 	wl_event_source_timer_update(output->frame_timer, output->frame_delay);
 	return 0;
 }
@@ -51,6 +69,7 @@ static void output_set_refresh(struct wlr_output *wlr_output, int32_t refresh) {
 		wlr_output->height, refresh);
 
 	output->frame_delay = 1000000 / refresh;
+	output->refresh_nsec = 1000000000000ull / refresh;
 }
 
 static bool output_set_custom_mode(struct wlr_output *wlr_output,
@@ -154,7 +173,9 @@ static bool output_commit(struct wlr_output *wlr_output) {
 			return false;
 		}
 
-		wlr_output_send_present(wlr_output, NULL);
+		// Reported on the next frame timer tick
+		output->present_pending = true;
+		output->present_commit_seq = wlr_output->commit_seq + 1;
 	}
 
 	return true;
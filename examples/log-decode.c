@@ -0,0 +1,343 @@
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "util/log_binary.h"
+
+/**
+ * Decodes binary logs written by wlroots when WLR_LOG_BINARY is set, and
+ * prints them in the same format as the default stderr logger.
+ *
+ * Usage: log-decode [file]
+ */
+
+static const char *verbosity_headers[] = {
+	[WLR_SILENT] = "",
+	[WLR_ERROR] = "[ERROR]",
+	[WLR_INFO] = "[INFO]",
+	[WLR_DEBUG] = "[DEBUG]",
+};
+
+struct format {
+	uint64_t id;
+	char *str;
+};
+
+static struct format *formats = NULL;
+static size_t formats_len = 0, formats_cap = 0;
+
+static void add_format(uint64_t id, char *str) {
+	for (size_t i = 0; i < formats_len; i++) {
+		if (formats[i].id == id) {
+			free(formats[i].str);
+			formats[i].str = str;
+			return;
+		}
+	}
+	if (formats_len == formats_cap) {
+		formats_cap = formats_cap ? formats_cap * 2 : 256;
+		formats = realloc(formats, formats_cap * sizeof(formats[0]));
+		if (formats == NULL) {
+			fprintf(stderr, "Allocation failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	formats[formats_len++] = (struct format){ .id = id, .str = str };
+}
+
+static const char *get_format(uint64_t id) {
+	for (size_t i = 0; i < formats_len; i++) {
+		if (formats[i].id == id) {
+			return formats[i].str;
+		}
+	}
+	return NULL;
+}
+
+struct args {
+	const uint8_t *data;
+	size_t len;
+};
+
+static bool next_arg(struct args *args, uint8_t tag, void *out, size_t size) {
+	if (args->len < 1 + size || args->data[0] != tag) {
+		return false;
+	}
+	memcpy(out, &args->data[1], size);
+	args->data += 1 + size;
+	args->len -= 1 + size;
+	return true;
+}
+
+static bool next_int(struct args *args, int64_t *out) {
+	return next_arg(args, LOG_BINARY_ARG_INT, out, sizeof(*out));
+}
+
+/**
+ * Prints a single conversion using the next packed argument. `prefix` holds
+ * the '%', flags, width and precision of the conversion specification.
+ */
+static bool print_conversion(const char *prefix, const char *length,
+		size_t length_len, char conv, struct args *args, int width,
+		int precision) {
+	// Rebuild the specification with the length modifier matching the
+	// packed argument
+	char buf[64];
+	const char *mod = "";
+	if (strchr("diouxX", conv) != NULL) {
+		mod = "ll";
+	}
+	int n = snprintf(buf, sizeof(buf), "%s%s%c", prefix, mod, conv);
+	if (n < 0 || (size_t)n >= sizeof(buf)) {
+		return false;
+	}
+
+	bool has_width = strchr(buf, '*') != NULL;
+	int64_t i;
+	double d;
+	uint64_t ptr;
+	switch (conv) {
+	case 'd':
+	case 'i':
+		if (!next_int(args, &i)) {
+			return false;
+		}
+		if (has_width) {
+			printf(buf, width, precision, (long long)i);
+		} else {
+			printf(buf, (long long)i);
+		}
+		return true;
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':;
+		if (!next_int(args, &i)) {
+			return false;
+		}
+		// Values were widened from their original type, narrow them back
+		uint64_t u = (uint64_t)i;
+		if (length_len == 0) {
+			u = (unsigned int)u;
+		} else if (length_len == 1 && length[0] == 'h') {
+			u = (unsigned short)u;
+		} else if (length_len == 2 && length[0] == 'h') {
+			u = (unsigned char)u;
+		}
+		if (has_width) {
+			printf(buf, width, precision, (unsigned long long)u);
+		} else {
+			printf(buf, (unsigned long long)u);
+		}
+		return true;
+	case 'c':
+		if (!next_int(args, &i)) {
+			return false;
+		}
+		if (has_width) {
+			printf(buf, width, precision, (int)i);
+		} else {
+			printf(buf, (int)i);
+		}
+		return true;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		if (!next_arg(args, LOG_BINARY_ARG_DOUBLE, &d, sizeof(d))) {
+			return false;
+		}
+		if (has_width) {
+			printf(buf, width, precision, d);
+		} else {
+			printf(buf, d);
+		}
+		return true;
+	case 's':;
+		uint16_t len;
+		if (!next_arg(args, LOG_BINARY_ARG_STRING, &len, sizeof(len)) ||
+				args->len < len) {
+			return false;
+		}
+		char *str = strndup((const char *)args->data, len);
+		args->data += len;
+		args->len -= len;
+		if (has_width) {
+			printf(buf, width, precision, str);
+		} else {
+			printf(buf, str);
+		}
+		free(str);
+		return true;
+	case 'p':
+		if (!next_arg(args, LOG_BINARY_ARG_POINTER, &ptr, sizeof(ptr))) {
+			return false;
+		}
+		printf("0x%" PRIx64, ptr);
+		return true;
+	case 'n':
+		return true;
+	}
+	return false;
+}
+
+static void print_message(const char *fmt, const uint8_t *payload,
+		size_t size, bool truncated) {
+	struct args args = { .data = payload, .len = size };
+
+	for (const char *p = fmt; *p != '\0'; p++) {
+		if (*p != '%') {
+			putchar(*p);
+			continue;
+		}
+		const char *spec = p;
+		p++;
+		if (*p == '%') {
+			putchar('%');
+			continue;
+		}
+
+		while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+			p++;
+		}
+		// Width and precision given as arguments come first
+		int64_t star[2] = {0};
+		int n_stars = 0;
+		for (int i = 0; i < 2; i++) {
+			if (*p == '*') {
+				if (!next_int(&args, &star[n_stars++])) {
+					goto truncated;
+				}
+				p++;
+			}
+			while (*p >= '0' && *p <= '9') {
+				p++;
+			}
+			if (i == 0 && *p == '.') {
+				p++;
+			} else {
+				break;
+			}
+		}
+
+		const char *length = p;
+		while (*p != '\0' && strchr("hljztLq", *p) != NULL) {
+			p++;
+		}
+		size_t length_len = p - length;
+		if (*p == '\0') {
+			break;
+		}
+
+		// print_conversion passes both the width and precision when there's
+		// a '*', so replace a single '*' with its value
+		char prefix[64];
+		const char *star_pos = memchr(spec, '*', length - spec);
+		if (n_stars == 1) {
+			snprintf(prefix, sizeof(prefix), "%.*s%d%.*s",
+				(int)(star_pos - spec), spec, (int)star[0],
+				(int)(length - star_pos - 1), star_pos + 1);
+		} else {
+			snprintf(prefix, sizeof(prefix), "%.*s",
+				(int)(length - spec), spec);
+		}
+
+		if (!print_conversion(prefix, length, length_len, *p, &args,
+				star[0], star[1])) {
+			goto truncated;
+		}
+	}
+
+	if (truncated) {
+		goto truncated;
+	}
+	putchar('\n');
+	return;
+
+truncated:
+	printf(" [truncated]\n");
+}
+
+int main(int argc, char *argv[]) {
+	FILE *f = stdin;
+	if (argc > 1) {
+		f = fopen(argv[1], "r");
+		if (f == NULL) {
+			perror("Failed to open log file");
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct log_binary_file_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+			memcmp(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic)) != 0) {
+		fprintf(stderr, "Not a wlroots binary log\n");
+		return EXIT_FAILURE;
+	}
+
+	struct log_binary_record record;
+	uint8_t *payload = NULL;
+	while (fread(&record, sizeof(record), 1, f) == 1) {
+		free(payload);
+		payload = malloc(record.size + 1);
+		if (payload == NULL ||
+				fread(payload, 1, record.size, f) != record.size) {
+			fprintf(stderr, "Unexpected end of file\n");
+			break;
+		}
+
+		switch (record.type) {
+		case LOG_BINARY_FORMAT:
+			payload[record.size] = '\0';
+			add_format(record.id, (char *)payload);
+			payload = NULL;
+			continue;
+		case LOG_BINARY_DROPPED:;
+			uint64_t dropped;
+			memcpy(&dropped, payload, sizeof(dropped));
+			printf("[%" PRIu64 " messages dropped so far]\n", dropped);
+			continue;
+		case LOG_BINARY_MESSAGE:
+			break;
+		default:
+			fprintf(stderr, "Unknown record type %d\n", record.type);
+			continue;
+		}
+
+		uint64_t t = record.time - header.start_time;
+		uint64_t sec = t / 1000000000;
+		printf("%02d:%02d:%02d.%03d ", (int)(sec / 60 / 60),
+			(int)(sec / 60 % 60), (int)(sec % 60),
+			(int)(t % 1000000000 / 1000000));
+
+		unsigned c = record.importance < WLR_LOG_IMPORTANCE_LAST ?
+			record.importance : WLR_LOG_IMPORTANCE_LAST - 1;
+		printf("%s ", verbosity_headers[c]);
+
+		const char *fmt = get_format(record.id);
+		if (fmt == NULL) {
+			printf("<unknown format %#" PRIx64 ">\n", record.id);
+			continue;
+		}
+		print_message(fmt, payload, record.size,
+			record.flags & LOG_BINARY_TRUNCATED);
+	}
+
+	free(payload);
+	for (size_t i = 0; i < formats_len; i++) {
+		free(formats[i].str);
+	}
+	free(formats);
+	if (f != stdin) {
+		fclose(f);
+	}
+	return EXIT_SUCCESS;
+}
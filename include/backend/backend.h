@@ -0,0 +1,16 @@
+#ifndef BACKEND_BACKEND_H
+#define BACKEND_BACKEND_H
+
+#include <wlr/backend.h>
+
+/**
+ * Calls wlr_backend_impl.commit_outputs, or tests or commits the outputs one
+ * by one if the backend doesn't support it. When committing, committed[i] is
+ * set for each output whose state has been applied, even on failure. It's
+ * unused when testing.
+ */
+bool backend_commit_outputs(struct wlr_backend *backend,
+	struct wlr_output **outputs, size_t outputs_len, bool test_only,
+	bool *committed);
+
+#endif
@@ -18,6 +18,34 @@
 #include "properties.h"
 #include "renderer.h"
 
+#define WLR_DRM_PROP_SHADOW_CAP 16
+
+/**
+ * Last property values committed to the kernel for a DRM object, used to
+ * only send changed properties. Atomic modesetting only. Emptied when the
+ * kernel state is unknown, e.g. after a VT switch.
+ */
+struct wlr_drm_prop_shadow {
+	size_t len;
+	struct {
+		uint32_t prop;
+		uint64_t value;
+	} props[WLR_DRM_PROP_SHADOW_CAP];
+};
+
+/**
+ * A property blob cached by contents, so that switching back to a previous
+ * mode or gamma LUT doesn't need to create a new blob. Atomic modesetting
+ * only.
+ */
+struct wlr_drm_blob {
+	uint32_t id;
+	uint64_t hash;
+	size_t size;
+	void *data;
+	struct wl_list link; // wlr_drm_backend.blobs
+};
+
 struct wlr_drm_plane {
 	uint32_t type;
 	uint32_t id;
@@ -31,6 +59,8 @@ struct wlr_drm_plane {
 	struct wlr_drm_fb queued_fb;
 	/* Buffer currently displayed on screen */
 	struct wlr_drm_fb current_fb;
+	/* Blank buffer used in place of the above by test-only modesets */
+	struct gbm_bo *test_bo;
 
 	uint32_t drm_format; // ARGB8888 or XRGB8888
 	struct wlr_drm_format_set formats;
@@ -38,8 +68,11 @@ struct wlr_drm_plane {
 	// Only used by cursor
 	bool cursor_enabled;
 	int32_t cursor_hotspot_x, cursor_hotspot_y;
+	struct wl_list cursor_bos; // wlr_drm_cursor_bo.link
+	size_t cursor_bos_len;
 
 	union wlr_drm_plane_props props;
+	struct wlr_drm_prop_shadow shadow;
 };
 
 struct wlr_drm_crtc_state {
@@ -59,6 +92,7 @@ struct wlr_drm_crtc {
 
 	// Legacy only
 	drmModeCrtc *legacy_crtc;
+	bool legacy_cursor_enabled;
 
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
@@ -71,6 +105,7 @@ struct wlr_drm_crtc {
 	uint32_t *overlays;
 
 	union wlr_drm_crtc_props props;
+	struct wlr_drm_prop_shadow shadow;
 };
 
 struct wlr_drm_backend {
@@ -95,6 +130,7 @@ struct wlr_drm_backend {
 	struct wl_listener drm_invalidated;
 
 	struct wl_list outputs;
+	struct wl_list blobs; // wlr_drm_blob.link, most recently used first
 
 	struct wlr_drm_renderer renderer;
 	struct wlr_session *session;
@@ -126,6 +162,7 @@ struct wlr_drm_connector {
 	uint32_t possible_crtc;
 
 	union wlr_drm_connector_props props;
+	struct wlr_drm_prop_shadow shadow;
 
 	int32_t cursor_x, cursor_y;
 
@@ -148,10 +185,14 @@ bool check_drm_features(struct wlr_drm_backend *drm);
 bool init_drm_resources(struct wlr_drm_backend *drm);
 void finish_drm_resources(struct wlr_drm_backend *drm);
 void restore_drm_outputs(struct wlr_drm_backend *drm);
+void invalidate_drm_prop_shadows(struct wlr_drm_backend *drm);
 void scan_drm_connectors(struct wlr_drm_backend *state);
 int handle_drm_event(int fd, uint32_t mask, void *data);
 bool drm_connector_set_mode(struct wlr_drm_connector *conn,
 	struct wlr_output_mode *mode);
+bool drm_commit_outputs(struct wlr_drm_backend *drm,
+	struct wlr_output **outputs, size_t outputs_len, bool test_only,
+	bool *committed);
 bool drm_connector_is_cursor_visible(struct wlr_drm_connector *conn);
 bool drm_connector_supports_vrr(struct wlr_drm_connector *conn);
 size_t drm_crtc_get_gamma_lut_size(struct wlr_drm_backend *drm,
@@ -3,6 +3,7 @@
 
 #include <gbm.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -16,11 +17,20 @@ struct wlr_drm_interface {
 	// Commit al pending changes on a CRTC.
 	bool (*crtc_commit)(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn, uint32_t flags);
+	// Commit all pending changes on several CRTCs at once. Optional.
+	bool (*crtcs_commit)(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector **conns, size_t conns_len, uint32_t flags);
+	// Move the cursor plane to the connector's cursor position right away,
+	// without waiting for the next commit. Fails if the cursor isn't
+	// currently displayed.
+	bool (*crtc_move_cursor)(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn);
 };
 
 extern const struct wlr_drm_interface atomic_iface;
 extern const struct wlr_drm_interface legacy_iface;
 
+void drm_atomic_finish_blobs(struct wlr_drm_backend *drm);
 bool drm_legacy_crtc_set_gamma(struct wlr_drm_backend *drm,
 	struct wlr_drm_crtc *crtc, size_t size, uint16_t *lut);
 
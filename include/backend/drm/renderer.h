@@ -5,8 +5,10 @@
 #include <gbm.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <wayland-server-core.h>
 #include <wlr/backend.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
 
 struct wlr_drm_backend;
 struct wlr_drm_plane;
@@ -22,6 +24,8 @@ struct wlr_drm_renderer {
 	struct wlr_renderer *wlr_rend;
 };
 
+struct wlr_drm_surface_buffer;
+
 struct wlr_drm_surface {
 	struct wlr_drm_renderer *renderer;
 
@@ -30,12 +34,50 @@ struct wlr_drm_surface {
 
 	struct gbm_surface *gbm;
 	EGLSurface egl;
+
+	// At most one buffer is locked at a time, so that the surface always has
+	// enough buffers left to render
+	struct wlr_drm_surface_buffer *locked_buffer;
+};
+
+/**
+ * A buffer of a wlr_drm_surface kept away from rendering, see
+ * wlr_output_lock_front_buffer.
+ */
+struct wlr_drm_surface_buffer {
+	struct wlr_buffer base;
+	struct wlr_drm_surface *surf; // NULL if the surface has been destroyed
+	struct gbm_bo *bo;
+	struct wlr_dmabuf_attributes attribs;
+	// Whether the FB has let go of the BO, in which case it's given back to
+	// the surface once unlocked
+	bool released;
+};
+
+/**
+ * A cursor image already rendered into a buffer suitable for the cursor plane,
+ * for a given texture and rendering parameters.
+ */
+struct wlr_drm_cursor_bo {
+	struct wlr_drm_plane *plane;
+	struct wl_list link; // wlr_drm_plane.cursor_bos, most recent first
+
+	struct wlr_texture *texture; // NULL if destroyed
+	int width, height;
+	enum wl_output_transform transform, output_transform;
+
+	// Allocated on the device driving the plane, even with multiple GPUs
+	struct gbm_bo *bo;
+	size_t n_locks; // number of FBs referencing the BO
+
+	struct wl_listener texture_destroy;
 };
 
 enum wlr_drm_fb_type {
 	WLR_DRM_FB_TYPE_NONE,
 	WLR_DRM_FB_TYPE_SURFACE,
-	WLR_DRM_FB_TYPE_WLR_BUFFER
+	WLR_DRM_FB_TYPE_WLR_BUFFER,
+	WLR_DRM_FB_TYPE_CURSOR_BO,
 };
 
 struct wlr_drm_fb {
@@ -48,6 +90,7 @@ struct wlr_drm_fb {
 	union {
 		struct wlr_drm_surface *surf;
 		struct wlr_buffer *wlr_buf;
+		struct wlr_drm_cursor_bo *cursor_bo;
 	};
 };
 
@@ -58,11 +101,21 @@ void finish_drm_renderer(struct wlr_drm_renderer *renderer);
 bool drm_surface_make_current(struct wlr_drm_surface *surf, int *buffer_age);
 bool export_drm_bo(struct gbm_bo *bo, struct wlr_dmabuf_attributes *attribs);
 
+/**
+ * Locks a BO of the surface which is currently locked by an FB. Returns NULL
+ * if another BO is already locked.
+ */
+struct wlr_buffer *drm_surface_lock_buffer(struct wlr_drm_surface *surf,
+	struct gbm_bo *bo);
+
 void drm_fb_clear(struct wlr_drm_fb *fb);
 bool drm_fb_lock_surface(struct wlr_drm_fb *fb, struct wlr_drm_surface *surf);
 bool drm_fb_import_wlr(struct wlr_drm_fb *fb, struct wlr_drm_renderer *renderer,
 		struct wlr_buffer *buf, struct wlr_drm_format_set *set);
 
+void drm_fb_lock_cursor_bo(struct wlr_drm_fb *fb,
+		struct wlr_drm_cursor_bo *cursor_bo);
+
 void drm_fb_move(struct wlr_drm_fb *new, struct wlr_drm_fb *old);
 
 bool drm_surface_render_black_frame(struct wlr_drm_surface *surf);
@@ -74,4 +127,17 @@ bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 		uint32_t format, uint32_t flags, bool with_modifiers);
 void drm_plane_finish_surface(struct wlr_drm_plane *plane);
 
+struct wlr_drm_cursor_bo *drm_plane_get_cursor_bo(struct wlr_drm_plane *plane,
+	struct wlr_texture *texture, int width, int height,
+	enum wl_output_transform transform,
+	enum wl_output_transform output_transform);
+/**
+ * Copies the cursor image which has just been rendered into the plane's
+ * surface to a new cached BO.
+ */
+struct wlr_drm_cursor_bo *drm_plane_add_cursor_bo(struct wlr_drm_plane *plane,
+	struct wlr_drm_backend *drm, struct wlr_texture *texture,
+	int width, int height, enum wl_output_transform transform,
+	enum wl_output_transform output_transform);
+
 #endif
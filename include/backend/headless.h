@@ -20,6 +20,7 @@ struct wlr_headless_backend {
 	struct wl_listener renderer_destroy;
 	bool started;
 	GLenum internal_format;
+	enum wlr_headless_clock clock;
 };
 
 struct wlr_headless_output {
@@ -31,7 +32,20 @@ struct wlr_headless_output {
 	GLuint fbo, rbo;
 
 	struct wl_event_source *frame_timer;
-	int frame_delay; // ms
+	// Signalled when a frame has been committed, used by
+	// WLR_HEADLESS_CLOCK_FAST
+	int frame_event_fd;
+	struct wl_event_source *frame_event;
+
+	uint64_t refresh_nsec;
+	// Time of the next frame timer expiration, CLOCK_MONOTONIC
+	uint64_t next_frame_nsec;
+	// Time and sequence number of the last simulated vblank
+	uint64_t vblank_nsec;
+	unsigned vblank_seq;
+
+	bool present_pending;
+	uint32_t present_commit_seq;
 };
 
 struct wlr_headless_input_device {
@@ -43,4 +57,6 @@ struct wlr_headless_input_device {
 struct wlr_headless_backend *headless_backend_from_backend(
 	struct wlr_backend *wlr_backend);
 
+void headless_output_start(struct wlr_headless_output *output);
+
 #endif
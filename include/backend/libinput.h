@@ -2,6 +2,10 @@
 #define BACKEND_LIBINPUT_H
 
 #include <libinput.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/backend/interface.h>
 #include <wlr/backend/libinput.h>
@@ -9,6 +13,60 @@
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_list.h>
 
+#define INPUT_QUEUE_SIZE 1024 // must be a power of two
+
+/**
+ * An input event read by the input thread. Frequent events are translated
+ * on the input thread, others are forwarded as is and handled on the main
+ * thread.
+ */
+struct wlr_libinput_queued_event {
+	enum libinput_event_type type;
+	struct libinput_device *device;
+	struct libinput_event *event; // NULL if translated
+	uint64_t time_usec;
+	union {
+		struct {
+			double dx, dy, unaccel_dx, unaccel_dy;
+		} motion;
+		struct {
+			double x, y;
+		} motion_abs;
+		struct {
+			uint32_t button;
+			enum libinput_button_state state;
+		} button;
+		struct {
+			uint32_t key;
+			enum libinput_key_state state;
+		} key;
+	};
+};
+
+struct wlr_libinput_input_thread {
+	pthread_t thread;
+	// Held while the libinput context is used, recursive
+	pthread_mutex_t lock;
+
+	// Single-producer single-consumer queue, filled by the input thread
+	struct wlr_libinput_queued_event queue[INPUT_QUEUE_SIZE];
+	atomic_size_t head, tail;
+	atomic_bool producer_blocked; // the queue was full
+	atomic_bool stopping;
+
+	int wake_main_fd; // eventfd, the queue or the mailbox has been filled
+	int wake_thread_fd; // eventfd, the queue has room or we're stopping
+	struct wl_event_source *wake_main_event;
+
+	// libinput opens and closes devices from the input thread on hotplug,
+	// these requests are forwarded to the main thread which owns the session
+	pthread_mutex_t mailbox_mutex;
+	pthread_cond_t mailbox_cond;
+	bool request_pending;
+	const char *request_path; // NULL for close requests
+	int request_fd;
+};
+
 struct wlr_libinput_backend {
 	struct wlr_backend backend;
 
@@ -21,8 +79,24 @@ struct wlr_libinput_backend {
 	struct wl_listener display_destroy;
 	struct wl_listener session_destroy;
 	struct wl_listener session_signal;
+	// Resumes libinput once the session is active again
+	struct wl_event_source *resume_idle;
 
 	struct wlr_list wlr_device_lists; // list of struct wl_list
+
+	// Devices opened ahead of libinput
+	struct wl_list prefetched_devices; // wlr_libinput_prefetched_device.link
+
+	struct wlr_libinput_input_thread *input_thread; // may be NULL
+};
+
+struct wlr_libinput_prefetched_device {
+	struct wlr_libinput_backend *backend;
+	struct wl_list link;
+
+	char *path;
+	int fd; // -1 until opened
+	struct wlr_session_open_request *request; // NULL once finished
 };
 
 struct wlr_libinput_input_device {
@@ -33,6 +107,19 @@ struct wlr_libinput_input_device {
 
 uint32_t usec_to_msec(uint64_t usec);
 
+bool input_thread_start(struct wlr_libinput_backend *backend);
+void input_thread_stop(struct wlr_libinput_backend *backend);
+/**
+ * Locks the libinput context against the input thread. This is a no-op if
+ * the input thread isn't running. Can be called recursively.
+ */
+void input_thread_lock(struct wlr_libinput_backend *backend);
+void input_thread_unlock(struct wlr_libinput_backend *backend);
+bool input_thread_is_current(void);
+int input_thread_open_file(struct wlr_libinput_backend *backend,
+	const char *path);
+void input_thread_close_file(struct wlr_libinput_backend *backend, int fd);
+
 void handle_libinput_event(struct wlr_libinput_backend *state,
 		struct libinput_event *event);
 
@@ -44,15 +131,23 @@ struct wlr_keyboard *create_libinput_keyboard(
 		struct libinput_device *device);
 void handle_keyboard_key(struct libinput_event *event,
 		struct libinput_device *device);
+void emit_keyboard_key(struct libinput_device *device, uint64_t time_usec,
+		uint32_t key, enum libinput_key_state state);
 
 struct wlr_pointer *create_libinput_pointer(
 		struct libinput_device *device);
 void handle_pointer_motion(struct libinput_event *event,
 		struct libinput_device *device);
+void emit_pointer_motion(struct libinput_device *device, uint64_t time_usec,
+		double dx, double dy, double unaccel_dx, double unaccel_dy);
 void handle_pointer_motion_abs(struct libinput_event *event,
 		struct libinput_device *device);
+void emit_pointer_motion_abs(struct libinput_device *device,
+		uint64_t time_usec, double x, double y);
 void handle_pointer_button(struct libinput_event *event,
 		struct libinput_device *device);
+void emit_pointer_button(struct libinput_device *device, uint64_t time_usec,
+		uint32_t button, enum libinput_button_state state);
 void handle_pointer_axis(struct libinput_event *event,
 		struct libinput_device *device);
 void handle_pointer_swipe_begin(struct libinput_event *event,
@@ -2,6 +2,8 @@
 #define BACKEND_WAYLAND_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 #include <wayland-client.h>
 #include <wayland-egl.h>
@@ -36,6 +38,7 @@ struct wlr_wl_backend {
 	struct zxdg_decoration_manager_v1 *zxdg_decoration_manager_v1;
 	struct zwp_pointer_gestures_v1 *zwp_pointer_gestures_v1;
 	struct wp_presentation *presentation;
+	clockid_t presentation_clock;
 	struct zwp_linux_dmabuf_v1 *zwp_linux_dmabuf_v1;
 	struct zwp_relative_pointer_manager_v1 *zwp_relative_pointer_manager_v1;
 	struct wl_seat *seat;
@@ -73,6 +76,10 @@ struct wlr_wl_output {
 	struct wl_egl_window *egl_window;
 	EGLSurface egl_surface;
 	struct wl_list presentation_feedbacks;
+	// Without presentation feedback, frame callbacks stand in for vblanks
+	uint32_t frame_seq;
+	uint32_t present_commit_seq;
+	bool present_pending;
 
 	uint32_t enter_serial;
 
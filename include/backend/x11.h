@@ -2,6 +2,7 @@
 #define BACKEND_X11_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include <X11/Xlib-xcb.h>
 #include <wayland-server-core.h>
@@ -38,6 +39,13 @@ struct wlr_x11_output {
 	struct wl_event_source *frame_timer;
 	int frame_delay;
 
+	// The frame timer stands in for vblanks, since the X server doesn't tell
+	// us when buffers are displayed
+	uint64_t refresh_nsec;
+	uint32_t vblank_seq;
+	bool present_pending;
+	uint32_t present_commit_seq;
+
 	bool cursor_hidden;
 };
 
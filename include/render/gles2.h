@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
+#include <wayland-util.h>
 #include <wlr/backend.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/gles2.h>
@@ -21,6 +22,8 @@ struct wlr_gles2_procs {
 	PFNGLPOPDEBUGGROUPKHRPROC glPopDebugGroupKHR;
 	PFNGLPUSHDEBUGGROUPKHRPROC glPushDebugGroupKHR;
 	PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC glEGLImageTargetRenderbufferStorageOES;
+	PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+	PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
 };
 
 extern struct wlr_gles2_procs gles2_procs;
@@ -42,6 +45,98 @@ struct wlr_gles2_tex_shader {
 	GLint tex_attrib;
 };
 
+struct wlr_gles2_vertex {
+	GLfloat x, y; // clip space
+	GLfloat s, t; // texture space, already y-inverted if necessary
+};
+
+/**
+ * A draw call recorded by the batching layer. All quads recorded with the same
+ * shader, texture and uniforms end up in the same draw call, as long as doing
+ * so doesn't change the result of blending.
+ */
+struct wlr_gles2_draw {
+	struct wlr_gles2_tex_shader *shader; // NULL for solid color quads
+	GLenum target;
+	GLuint tex;
+	float color[4]; // solid color quads only
+	float alpha; // textured quads only
+
+	// Bounding box of all quads in this draw call, in clip space
+	GLfloat x1, y1, x2, y2;
+
+	// Filled when flushing
+	GLint first;
+	GLsizei count;
+};
+
+struct wlr_gles2_quad {
+	size_t draw; // index in wlr_gles2_batch.draws
+	struct wlr_gles2_vertex verts[6];
+};
+
+struct wlr_gles2_batch {
+	bool enabled;
+	GLuint vbo;
+
+	struct wl_array draws; // struct wlr_gles2_draw
+	struct wl_array quads; // struct wlr_gles2_quad
+	struct wl_array vertices; // struct wlr_gles2_vertex, used when flushing
+
+	// Scissor rectangle, applied by clipping geometry rather than through
+	// GL_SCISSOR_TEST whenever possible
+	bool scissor;
+	struct wlr_box scissor_box; // in GL coordinates (bottom-left origin)
+	GLfloat scissor_x1, scissor_y1, scissor_x2, scissor_y2; // clip space
+};
+
+struct wlr_gles2_atlas_span {
+	int x, width;
+};
+
+struct wlr_gles2_atlas_shelf {
+	int y, height;
+	struct wl_array free; // struct wlr_gles2_atlas_span, sorted by x
+};
+
+struct wlr_gles2_atlas_page {
+	struct wlr_gles2_atlas *atlas;
+	struct wl_list link; // wlr_gles2_atlas.pages
+
+	GLint gl_format, gl_type;
+	GLuint tex;
+	int size;
+
+	struct wl_array shelves; // struct wlr_gles2_atlas_shelf, sorted by y
+	int shelves_height;
+	size_t entries;
+};
+
+/**
+ * Packs small textures created from pixels into shared texture pages, so that
+ * they can be drawn without switching textures. Textures are moved out of the
+ * atlas when they are exported or when the least recently used entries need
+ * to make room for new ones.
+ */
+struct wlr_gles2_atlas {
+	int max_entry_size; // 0 if the atlas is disabled
+	int page_size;
+	size_t max_pages;
+
+	struct wl_list pages; // wlr_gles2_atlas_page.link
+	struct wl_list lru; // wlr_gles2_texture.atlas.link, most recent first
+	GLuint fbo; // used to copy entries out of a page
+};
+
+/**
+ * On-disk cache of linked program binaries, keyed by driver and shader
+ * sources. Requires GL_OES_get_program_binary.
+ */
+struct wlr_gles2_program_cache {
+	char *dir; // NULL if disabled
+	uint64_t driver_hash;
+};
+
 struct wlr_gles2_renderer {
 	struct wlr_renderer wlr_renderer;
 
@@ -53,8 +148,11 @@ struct wlr_gles2_renderer {
 		bool debug_khr;
 		bool egl_image_external_oes;
 		bool egl_image_oes;
+		bool get_program_binary_oes;
 	} exts;
 
+	struct wlr_gles2_program_cache program_cache;
+
 	struct {
 		struct {
 			GLuint program;
@@ -62,6 +160,7 @@ struct wlr_gles2_renderer {
 			GLint color;
 			GLint pos_attrib;
 		} quad;
+		// Compiled on first use, as few compositors draw ellipses
 		struct {
 			GLuint program;
 			GLint proj;
@@ -71,10 +170,14 @@ struct wlr_gles2_renderer {
 		} ellipse;
 		struct wlr_gles2_tex_shader tex_rgba;
 		struct wlr_gles2_tex_shader tex_rgbx;
+		// Compiled on first use of a GL_TEXTURE_EXTERNAL_OES texture
 		struct wlr_gles2_tex_shader tex_ext;
 	} shaders;
 
 	uint32_t viewport_width, viewport_height;
+
+	struct wlr_gles2_batch batch;
+	struct wlr_gles2_atlas atlas;
 };
 
 struct wlr_gles2_texture {
@@ -94,6 +197,14 @@ struct wlr_gles2_texture {
 
 	// Only affects target == GL_TEXTURE_2D
 	enum wl_shm_format wl_format; // used to interpret upload data
+
+	// Set if the texture lives in a shared atlas page, in which case tex is
+	// the page texture and (x, y) the position of the texture in the page
+	struct {
+		struct wlr_gles2_atlas_page *page;
+		int x, y;
+		struct wl_list link; // wlr_gles2_atlas.lru
+	} atlas;
 };
 
 const struct wlr_gles2_pixel_format *get_gles2_format_from_wl(
@@ -104,6 +215,73 @@ const enum wl_shm_format *get_gles2_wl_formats(size_t *len);
 
 struct wlr_gles2_texture *gles2_get_texture(
 	struct wlr_texture *wlr_texture);
+struct wlr_texture *gles2_texture_create_from_pixels(struct wlr_egl *egl,
+	struct wlr_gles2_atlas *atlas, enum wl_shm_format wl_fmt,
+	uint32_t stride, uint32_t width, uint32_t height, const void *data);
+/**
+ * Wraps a GL_TEXTURE_2D holding RGBA pixels, e.g. one rendered by a context
+ * sharing objects with egl. The texture takes ownership of tex.
+ */
+struct wlr_texture *gles2_texture_create_from_gl(struct wlr_egl *egl,
+	GLuint tex, uint32_t width, uint32_t height, bool inverted_y);
+/**
+ * Moves the texture out of its atlas page into a texture of its own. Returns
+ * true if the texture isn't part of an atlas anymore.
+ */
+bool gles2_texture_leave_atlas(struct wlr_gles2_texture *texture);
+
+void gles2_atlas_init(struct wlr_gles2_atlas *atlas);
+void gles2_atlas_finish(struct wlr_gles2_atlas *atlas);
+/**
+ * Allocates room for the texture in an atlas page, evicting least recently
+ * used entries if necessary. On success, sets texture->tex and texture->atlas.
+ */
+bool gles2_atlas_add(struct wlr_gles2_atlas *atlas,
+	struct wlr_gles2_texture *texture,
+	const struct wlr_gles2_pixel_format *fmt);
+void gles2_atlas_remove(struct wlr_gles2_texture *texture);
+/**
+ * Copies an atlas entry into a texture of its own and releases its room in
+ * the atlas page.
+ */
+bool gles2_atlas_evict(struct wlr_gles2_texture *texture);
+void gles2_atlas_write_pixels(struct wlr_gles2_texture *texture,
+	const struct wlr_gles2_pixel_format *fmt, uint32_t stride,
+	uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+	uint32_t dst_x, uint32_t dst_y, const void *data);
+void gles2_atlas_touch(struct wlr_gles2_texture *texture);
+
+void gles2_batch_init(struct wlr_gles2_batch *batch);
+void gles2_batch_finish(struct wlr_gles2_batch *batch);
+/**
+ * Records a quad covering the unit square transformed by `matrix`. If `shader`
+ * is NULL, the quad is filled with `color`, otherwise `box` selects the region
+ * of `texture` to sample from.
+ */
+void gles2_batch_add_quad(struct wlr_gles2_renderer *renderer,
+	struct wlr_gles2_tex_shader *shader, struct wlr_gles2_texture *texture,
+	const struct wlr_fbox *box, const float color[static 4], float alpha,
+	const float matrix[static 9]);
+/**
+ * Submits all recorded quads to GL. Must be called before any GL operation
+ * that depends on previously recorded quads having been drawn.
+ */
+void gles2_batch_flush(struct wlr_gles2_renderer *renderer);
+/**
+ * Flushes the batch of the renderer currently rendering, if any. Used when a
+ * texture which may be referenced by a pending draw call is destroyed.
+ */
+void gles2_flush_current_batch(void);
+
+void gles2_program_cache_init(struct wlr_gles2_program_cache *cache);
+void gles2_program_cache_finish(struct wlr_gles2_program_cache *cache);
+/**
+ * Returns a program linked from a cached binary, or 0 on cache miss.
+ */
+GLuint gles2_program_cache_load(struct wlr_gles2_program_cache *cache,
+	const GLchar *vert_src, const GLchar *frag_src);
+void gles2_program_cache_store(struct wlr_gles2_program_cache *cache,
+	const GLchar *vert_src, const GLchar *frag_src, GLuint prog);
 
 void push_gles2_marker(const char *file, const char *func);
 void pop_gles2_marker(void);
@@ -0,0 +1,14 @@
+#ifndef TYPES_WLR_BUFFER_H
+#define TYPES_WLR_BUFFER_H
+
+#include <wlr/types/wlr_buffer.h>
+
+/**
+ * Same as wlr_client_buffer_apply_damage, but doesn't check whether someone
+ * else holds a reference to the buffer. The caller is responsible for making
+ * sure no other user expects the texture to stay unchanged.
+ */
+bool client_buffer_apply_damage(struct wlr_client_buffer *buffer,
+	struct wl_resource *resource, pixman_region32_t *damage);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TYPES_WLR_LINUX_DMABUF_V1_H
+#define TYPES_WLR_LINUX_DMABUF_V1_H
+
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
+
+/**
+ * A texture imported from a DMA-BUF, shared by all wl_buffers backed by the
+ * same DMA-BUF planes. Destroyed once the last lock is released.
+ */
+struct wlr_dmabuf_v1_texture;
+
+/**
+ * Locks the texture imported when the buffer was created. Returns NULL if the
+ * buffer wasn't imported with `renderer`.
+ */
+struct wlr_dmabuf_v1_texture *dmabuf_v1_buffer_lock_texture(
+	struct wlr_dmabuf_v1_buffer *buffer, struct wlr_renderer *renderer);
+struct wlr_texture *dmabuf_v1_texture_get_texture(
+	struct wlr_dmabuf_v1_texture *texture);
+void dmabuf_v1_texture_unlock(struct wlr_dmabuf_v1_texture *texture);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef TYPES_WLR_OUTPUT_H
+#define TYPES_WLR_OUTPUT_H
+
+#include <time.h>
+#include <wlr/types/wlr_output.h>
+
+bool output_basic_test(struct wlr_output *output);
+
+/**
+ * wlr_output_commit is split in three steps, so that backends can apply the
+ * pending state of several outputs at once. output_commit_prepare checks the
+ * pending state and emits the precommit event. Once the backend has applied
+ * the state, either output_commit_finish or output_commit_abort must be
+ * called.
+ */
+bool output_commit_prepare(struct wlr_output *output,
+	struct timespec *now);
+void output_commit_finish(struct wlr_output *output,
+	const struct timespec *now);
+void output_commit_abort(struct wlr_output *output);
+
+#endif
@@ -14,6 +14,7 @@ extern const struct wlr_surface_role xdg_toplevel_surface_role;
 extern const struct wlr_surface_role xdg_popup_surface_role;
 
 uint32_t schedule_xdg_surface_configure(struct wlr_xdg_surface *surface);
+void xdg_surface_flush_deferred_configure(struct wlr_xdg_surface *surface);
 struct wlr_xdg_surface *create_xdg_surface(
 	struct wlr_xdg_client *client, struct wlr_surface *surface,
 	uint32_t id);
@@ -0,0 +1,74 @@
+#ifndef UTIL_LOG_BINARY_H
+#define UTIL_LOG_BINARY_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/util/log.h>
+
+/**
+ * Binary log files start with a struct log_binary_file_header, followed by a
+ * sequence of records. Each record starts with a struct log_binary_record,
+ * followed by `size` bytes of payload:
+ *
+ * - LOG_BINARY_FORMAT: the NUL-terminated format string identified by `id`.
+ *   Always written before the first message referencing it.
+ * - LOG_BINARY_MESSAGE: the arguments of a message using the format string
+ *   `id`. Each argument starts with a one-byte enum log_binary_arg tag.
+ * - LOG_BINARY_DROPPED: a uint64_t with the total number of messages dropped
+ *   so far because the ring buffer was full.
+ *
+ * All integers are in host byte order.
+ */
+
+#define LOG_BINARY_MAGIC "WLRBLOG1"
+
+struct log_binary_file_header {
+	char magic[8];
+	// CLOCK_MONOTONIC time at which logging started, in nanoseconds
+	uint64_t start_time;
+};
+
+enum log_binary_record_type {
+	LOG_BINARY_FORMAT = 1,
+	LOG_BINARY_MESSAGE = 2,
+	LOG_BINARY_DROPPED = 3,
+};
+
+enum log_binary_record_flags {
+	// Not all arguments fit in the record
+	LOG_BINARY_TRUNCATED = 1 << 0,
+};
+
+struct log_binary_record {
+	uint8_t type; // enum log_binary_record_type
+	uint8_t importance; // enum wlr_log_importance
+	uint8_t flags; // enum log_binary_record_flags
+	uint8_t pad;
+	uint32_t size;
+	// CLOCK_MONOTONIC time, in nanoseconds
+	uint64_t time;
+	uint64_t id;
+};
+
+enum log_binary_arg {
+	LOG_BINARY_ARG_INT = 1, // int64_t, unsigned values are stored bitwise
+	LOG_BINARY_ARG_DOUBLE = 2, // double
+	LOG_BINARY_ARG_STRING = 3, // uint16_t length, followed by the bytes
+	LOG_BINARY_ARG_POINTER = 4, // uint64_t
+};
+
+/**
+ * Starts logging to `path` via a lock-free ring buffer drained by a
+ * background thread.
+ */
+bool log_binary_init(const char *path);
+/**
+ * A wlr_log_func_t writing to the binary log. Format strings are copied the
+ * first time they're seen. Past a few thousand distinct format strings,
+ * messages are formatted right away instead.
+ */
+void log_binary(enum wlr_log_importance verbosity, const char *fmt,
+	va_list args);
+
+#endif
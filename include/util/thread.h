@@ -0,0 +1,14 @@
+#ifndef UTIL_THREAD_H
+#define UTIL_THREAD_H
+
+#include <pthread.h>
+
+/**
+ * Creates a thread with all signals blocked, so that signals keep being
+ * delivered to the main thread. Returns zero on success, or an error number
+ * like pthread_create.
+ */
+int create_thread_without_signals(pthread_t *thread,
+	void *(*start_routine)(void *), void *arg);
+
+#endif
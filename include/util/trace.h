@@ -0,0 +1,35 @@
+#ifndef UTIL_TRACE_H
+#define UTIL_TRACE_H
+
+#include <stdint.h>
+#include <wlr/config.h>
+
+/**
+ * Frame timeline tracing. Event names must be string literals. Spans must
+ * begin and end on the same thread, async spans may end on any thread and are
+ * matched by name and `id`.
+ *
+ * When wlroots isn't built with the `tracing` option, these expand to
+ * nothing.
+ */
+#if WLR_HAS_TRACING
+
+#define TRACE_BEGIN(name) trace_event('B', name, 0)
+#define TRACE_END(name) trace_event('E', name, 0)
+#define TRACE_INSTANT(name) trace_event('i', name, 0)
+#define TRACE_ASYNC_BEGIN(name, id) trace_event('b', name, id)
+#define TRACE_ASYNC_END(name, id) trace_event('e', name, id)
+
+void trace_event(char phase, const char *name, uint64_t id);
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_INSTANT(name) ((void)0)
+#define TRACE_ASYNC_BEGIN(name, id) ((void)0)
+#define TRACE_ASYNC_END(name, id) ((void)0)
+
+#endif
+
+#endif
@@ -14,6 +14,7 @@
 #include <wlr/render/egl.h>
 
 struct wlr_backend_impl;
+struct wlr_output;
 
 struct wlr_backend {
 	const struct wlr_backend_impl *impl;
@@ -66,5 +67,28 @@ struct wlr_session *wlr_backend_get_session(struct wlr_backend *backend);
  * Returns the clock used by the backend for presentation feedback.
  */
 clockid_t wlr_backend_get_presentation_clock(struct wlr_backend *backend);
+/**
+ * Checks whether the pending state of all the given outputs can be applied
+ * at once with wlr_backend_commit_outputs. The pending state is left intact.
+ */
+bool wlr_backend_test_outputs(struct wlr_backend *backend,
+	struct wlr_output **outputs, size_t outputs_len);
+/**
+ * Applies the pending state of all the given outputs, e.g. a new output
+ * configuration. When supported by the backend (atomic DRM), all outputs are
+ * updated with a single modeset, and either the whole configuration is
+ * applied or none of it is.
+ *
+ * Outputs must belong to `backend` or one of its sub-backends. Outputs
+ * belonging to different DRM devices can't be updated atomically: each device
+ * is tested first, then committed in turn.
+ *
+ * On success, this is equivalent to calling wlr_output_commit on each output.
+ * On failure, the pending state of all outputs is cleared. When the outputs
+ * can't be updated atomically, some of them may have been committed before the
+ * failure: those are updated as if wlr_output_commit had succeeded.
+ */
+bool wlr_backend_commit_outputs(struct wlr_backend *backend,
+	struct wlr_output **outputs, size_t outputs_len);
 
 #endif
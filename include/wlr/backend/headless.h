@@ -13,6 +13,19 @@
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_output.h>
 
+enum wlr_headless_clock {
+	// Frames are paced and timestamped with CLOCK_MONOTONIC
+	WLR_HEADLESS_CLOCK_REALTIME,
+	// Frames are paced with CLOCK_MONOTONIC, but presentation timestamps come
+	// from a simulated clock starting at zero, advanced by exactly one refresh
+	// period per frame
+	WLR_HEADLESS_CLOCK_VIRTUAL,
+	// Like WLR_HEADLESS_CLOCK_VIRTUAL, but the next frame is sent as soon as
+	// the previous one has been committed instead of waiting for the refresh
+	// period to elapse
+	WLR_HEADLESS_CLOCK_FAST,
+};
+
 /**
  * Creates a headless backend. A headless backend has no outputs or inputs by
  * default.
@@ -38,6 +51,13 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *backend,
  */
 struct wlr_input_device *wlr_headless_add_input_device(
 	struct wlr_backend *backend, enum wlr_input_device_type type);
+/**
+ * Sets the clock used to drive the outputs of the headless backend. This must
+ * be called before the backend is started. Defaults to the value of the
+ * WLR_HEADLESS_CLOCK environment variable, or WLR_HEADLESS_CLOCK_REALTIME.
+ */
+void wlr_headless_backend_set_clock(struct wlr_backend *backend,
+	enum wlr_headless_clock clock);
 bool wlr_backend_is_headless(struct wlr_backend *backend);
 bool wlr_input_device_is_headless(struct wlr_input_device *device);
 bool wlr_output_is_headless(struct wlr_output *output);
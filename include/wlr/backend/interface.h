@@ -20,6 +20,14 @@ struct wlr_backend_impl {
 	struct wlr_renderer *(*get_renderer)(struct wlr_backend *backend);
 	struct wlr_session *(*get_session)(struct wlr_backend *backend);
 	clockid_t (*get_presentation_clock)(struct wlr_backend *backend);
+	// Applies the pending state of all outputs at once, or tests it if
+	// test_only is set. All outputs belong to this backend, and their
+	// pending state has passed the backend-agnostic checks. When
+	// committing, committed[i] must be set for each output whose state has
+	// been applied, including when the commit fails partway through.
+	bool (*commit_outputs)(struct wlr_backend *backend,
+		struct wlr_output **outputs, size_t outputs_len, bool test_only,
+		bool *committed);
 };
 
 /**
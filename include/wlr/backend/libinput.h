@@ -17,7 +17,14 @@
 
 struct wlr_backend *wlr_libinput_backend_create(struct wl_display *display,
 		struct wlr_session *session);
-/** Gets the underlying libinput_device handle for the given wlr_input_device */
+/**
+ * Gets the underlying libinput_device handle for the given wlr_input_device.
+ *
+ * When WLR_LIBINPUT_THREAD is enabled, libinput runs on a separate thread:
+ * the handle may only be used from the backend's new_input handler. Device
+ * events are emitted while the input thread keeps running, so the handle must
+ * not be used from their handlers.
+ */
 struct libinput_device *wlr_libinput_get_device_handle(
 		struct wlr_input_device *dev);
 
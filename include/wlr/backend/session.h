@@ -7,6 +7,11 @@
 #include <wayland-server-core.h>
 
 struct session_impl;
+struct wlr_session;
+struct wlr_session_open_request;
+
+typedef void (*wlr_session_open_func_t)(struct wlr_session *session,
+	int fd, void *data);
 
 struct wlr_device {
 	int fd;
@@ -37,7 +42,9 @@ struct wlr_session {
 	struct wl_event_source *udev_event;
 
 	struct wl_list devices;
+	struct wl_list open_requests; // wlr_session_open_request.link
 
+	struct wl_event_loop *event_loop;
 	struct wl_listener display_destroy;
 
 	struct {
@@ -76,6 +83,36 @@ void wlr_session_destroy(struct wlr_session *session);
  */
 int wlr_session_open_file(struct wlr_session *session, const char *path);
 
+/*
+ * Opens the file at path asynchronously, like wlr_session_open_file.
+ *
+ * `callback` is called from the event loop (or from
+ * wlr_session_wait_open_requests) with the opened file descriptor, or with a
+ * negative value on error. This allows multiple devices to be opened in
+ * parallel with sessions relying on a remote service, such as logind. Other
+ * sessions open the file immediately, but still defer the callback.
+ *
+ * Returns NULL on error, in which case `callback` is never called. Pending
+ * requests are cancelled without calling `callback` when the session is
+ * destroyed.
+ */
+struct wlr_session_open_request *wlr_session_open_file_async(
+	struct wlr_session *session, const char *path,
+	wlr_session_open_func_t callback, void *data);
+
+/*
+ * Cancels a pending request. `callback` won't be called, and the file will be
+ * closed if it has been opened in the meantime.
+ */
+void wlr_session_open_request_cancel(struct wlr_session_open_request *request);
+
+/*
+ * Blocks until all pending requests are completed. Must not be called from
+ * `session_signal` handlers: with logind, these run while D-Bus messages are
+ * being processed, and replies can't be read.
+ */
+void wlr_session_wait_open_requests(struct wlr_session *session);
+
 /*
  * Closes a file previously opened with wlr_session_open_file.
  */
@@ -15,8 +15,43 @@ struct session_impl {
 	struct wlr_session *(*create)(struct wl_display *disp);
 	void (*destroy)(struct wlr_session *session);
 	int (*open)(struct wlr_session *session, const char *path);
+	/**
+	 * Starts opening `request->path`, optional. The implementation must call
+	 * wlr_session_open_request_finish once done, unless the request is
+	 * destroyed first. Returns false if the request couldn't be started.
+	 */
+	bool (*open_async)(struct wlr_session *session,
+		struct wlr_session_open_request *request);
+	/**
+	 * Called when a request started with open_async is destroyed before
+	 * being finished, e.g. because the session is being destroyed.
+	 */
+	void (*destroy_open_request)(struct wlr_session *session,
+		struct wlr_session_open_request *request);
+	/**
+	 * Blocks until all requests started with open_async are finished.
+	 */
+	void (*wait_open_requests)(struct wlr_session *session);
 	void (*close)(struct wlr_session *session, int fd);
 	bool (*change_vt)(struct wlr_session *session, unsigned vt);
 };
 
+struct wlr_session_open_request {
+	struct wlr_session *session;
+	struct wl_list link; // wlr_session.open_requests
+
+	char *path;
+	wlr_session_open_func_t callback; // NULL if cancelled
+	void *data;
+
+	// Requests of sessions without open_async are finished on idle
+	struct wl_event_source *idle;
+	int fd;
+
+	void *impl_data;
+};
+
+void wlr_session_open_request_finish(struct wlr_session_open_request *request,
+	int fd);
+
 #endif
@@ -86,6 +86,10 @@ struct wlr_output_impl {
 	 */
 	bool (*export_dmabuf)(struct wlr_output *output,
 		struct wlr_dmabuf_attributes *attribs);
+	/**
+	 * Lock the buffer currently displayed, see wlr_output_lock_front_buffer.
+	 */
+	struct wlr_buffer *(*lock_front_buffer)(struct wlr_output *output);
 };
 
 /**
@@ -46,11 +46,14 @@ struct wlr_egl {
 	struct {
 		bool bind_wayland_display_wl;
 		bool buffer_age_ext;
+		bool fence_sync_khr;
 		bool image_base_khr;
 		bool image_dma_buf_export_mesa;
 		bool image_dmabuf_import_ext;
 		bool image_dmabuf_import_modifiers_ext;
+		bool native_fence_sync_android;
 		bool swap_buffers_with_damage;
+		bool wait_sync_khr;
 	} exts;
 
 	struct {
@@ -67,12 +70,21 @@ struct wlr_egl {
 		PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC eglExportDMABUFImageQueryMESA;
 		PFNEGLEXPORTDMABUFIMAGEMESAPROC eglExportDMABUFImageMESA;
 		PFNEGLDEBUGMESSAGECONTROLKHRPROC eglDebugMessageControlKHR;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+		PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
 	} procs;
 
 	struct wl_display *wl_display;
 
 	struct wlr_drm_format_set dmabuf_formats;
 	EGLBoolean **external_only_dmabuf_formats;
+
+	// Set if the context was created with wlr_egl_init_shared, in which case
+	// the display and the dmabuf formats belong to the parent
+	struct wlr_egl *parent;
 };
 
 // TODO: Allocate and return a wlr_egl
@@ -83,6 +95,13 @@ struct wlr_egl {
 bool wlr_egl_init(struct wlr_egl *egl, EGLenum platform, void *remote_display,
 	const EGLint *config_attribs, EGLint visual_id);
 
+/**
+ * Initializes an EGL context sharing textures, buffers and programs with the
+ * context of the parent. Both contexts can be current on different threads at
+ * the same time. The parent must outlive the shared context.
+ */
+bool wlr_egl_init_shared(struct wlr_egl *egl, struct wlr_egl *parent);
+
 /**
  * Frees all related EGL resources, makes the context not-current and
  * unbinds a bound wayland display.
@@ -156,6 +175,13 @@ void wlr_egl_save_context(struct wlr_egl_context *context);
  */
 bool wlr_egl_restore_context(struct wlr_egl_context *context);
 
+/**
+ * Creates a sync file which is signalled once the commands submitted so far
+ * on the current context have completed, and flushes the context. Returns -1
+ * on error or if EGL_ANDROID_native_fence_sync isn't supported.
+ */
+int wlr_egl_dup_fence_fd(struct wlr_egl *egl);
+
 bool wlr_egl_swap_buffers(struct wlr_egl *egl, EGLSurface surface,
 	pixman_region32_t *damage);
 
@@ -17,7 +17,15 @@ struct wlr_egl;
 
 struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl);
 
+bool wlr_renderer_is_gles2(struct wlr_renderer *renderer);
+
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *renderer);
+/**
+ * Submit all draw operations recorded since the last flush. The GLES2
+ * renderer batches draw operations until wlr_renderer_end, so this must be
+ * called before issuing raw GL calls in the middle of a frame.
+ */
+void wlr_gles2_renderer_flush(struct wlr_renderer *renderer);
 bool wlr_gles2_renderer_check_ext(struct wlr_renderer *renderer,
 	const char *ext);
 
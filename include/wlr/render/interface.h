@@ -67,6 +67,9 @@ struct wlr_renderer_impl {
 	bool (*blit_dmabuf)(struct wlr_renderer *renderer,
 		struct wlr_dmabuf_attributes *dst,
 		struct wlr_dmabuf_attributes *src);
+	bool (*read_pixels_to_dmabuf)(struct wlr_renderer *renderer,
+		struct wlr_dmabuf_attributes *dst, uint32_t *flags,
+		uint32_t src_x, uint32_t src_y, int *fence_fd);
 };
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
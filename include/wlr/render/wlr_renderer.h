@@ -117,6 +117,19 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
  */
 bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 	struct wlr_dmabuf_attributes *dst, struct wlr_dmabuf_attributes *src);
+/**
+ * Copies pixels from the current viewport into a DMA-BUF on the GPU, without
+ * a round trip through the CPU. The copied region starts at (src_x, src_y)
+ * and has the size of the DMA-BUF. `flags` is set as in
+ * wlr_renderer_read_pixels.
+ *
+ * If `fence_fd` isn't NULL, it's set to a sync file signalled once the copy
+ * has completed, or to -1 if none could be created. Without a sync file, the
+ * copy has completed when this function returns.
+ */
+bool wlr_renderer_read_pixels_to_dmabuf(struct wlr_renderer *r,
+	struct wlr_dmabuf_attributes *dst, uint32_t *flags,
+	uint32_t src_x, uint32_t src_y, int *fence_fd);
 /**
  * Checks if a format is supported.
  */
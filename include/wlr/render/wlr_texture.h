@@ -10,6 +10,7 @@
 #define WLR_RENDER_WLR_TEXTURE_H
 
 #include <stdint.h>
+#include <wayland-server-core.h>
 #include <wayland-server-protocol.h>
 #include <wlr/render/dmabuf.h>
 
@@ -19,6 +20,10 @@ struct wlr_texture_impl;
 struct wlr_texture {
 	const struct wlr_texture_impl *impl;
 	uint32_t width, height;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
 };
 
 /**
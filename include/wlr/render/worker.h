@@ -0,0 +1,83 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_RENDER_WORKER_H
+#define WLR_RENDER_WORKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+struct wlr_renderer;
+struct wlr_texture;
+
+/**
+ * A render worker draws on a thread of its own, with its own renderer and a
+ * GL context sharing objects with the parent renderer. Compositors driving
+ * several outputs can create one worker per output, so that a heavy frame on
+ * one output doesn't delay the others.
+ *
+ * Only the GLES2 renderer is supported.
+ */
+struct wlr_render_worker;
+
+struct wlr_render_job {
+	// Size of the image to render
+	uint32_t width, height;
+
+	/**
+	 * Called on the worker thread between wlr_renderer_begin and
+	 * wlr_renderer_end. The image is drawn with the same conventions as an
+	 * output, e.g. with wlr_matrix_projection. The job must not use anything
+	 * but the renderer and the textures it's been given.
+	 */
+	void (*render)(struct wlr_render_job *job, struct wlr_renderer *renderer);
+	/**
+	 * Called on the main thread once the job is over. The texture holds the
+	 * rendered image and belongs to the parent renderer; the caller is
+	 * responsible for destroying it. It's NULL if rendering failed or if the
+	 * worker has been destroyed before running the job.
+	 */
+	void (*done)(struct wlr_render_job *job, struct wlr_texture *texture);
+
+	void *data;
+
+	// private state
+
+	struct wl_list link;
+	struct wlr_texture *texture;
+	void *sync; // EGLSyncKHR
+};
+
+struct wlr_render_worker *wlr_render_worker_create(
+	struct wlr_renderer *parent, struct wl_event_loop *loop);
+/**
+ * Stops the worker thread once the current job, if any, is over. The done
+ * callback of jobs which haven't been run is called with a NULL texture.
+ */
+void wlr_render_worker_destroy(struct wlr_render_worker *worker);
+
+/**
+ * Queues a job. Jobs are run and completed in order.
+ *
+ * The textures used by the job must have been prepared with
+ * wlr_render_worker_prepare_texture, and must not be destroyed until the job
+ * is done. The job sees their contents as of this call; pixels written to them
+ * in the meantime may or may not show up in the rendered image.
+ */
+void wlr_render_worker_submit(struct wlr_render_worker *worker,
+	struct wlr_render_job *job);
+
+/**
+ * Makes a texture of the parent renderer usable by jobs. Must be called on
+ * the main thread.
+ */
+bool wlr_render_worker_prepare_texture(struct wlr_render_worker *worker,
+	struct wlr_texture *texture);
+
+#endif
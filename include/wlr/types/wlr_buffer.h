@@ -77,6 +77,8 @@ void wlr_buffer_unlock(struct wlr_buffer *buffer);
 bool wlr_buffer_get_dmabuf(struct wlr_buffer *buffer,
 	struct wlr_dmabuf_attributes *attribs);
 
+struct wlr_dmabuf_v1_texture;
+
 /**
  * A client buffer.
  */
@@ -96,6 +98,11 @@ struct wlr_client_buffer {
 	 * client destroys the buffer before it has been released.
 	 */
 	struct wlr_texture *texture;
+	/**
+	 * The linux-dmabuf import cache entry the texture belongs to, if any. The
+	 * texture is then owned by the cache.
+	 */
+	struct wlr_dmabuf_v1_texture *dmabuf_texture;
 
 	struct wl_listener resource_destroy;
 	struct wl_listener release;
@@ -0,0 +1,129 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_CLIENT_ACCOUNTING_H
+#define WLR_TYPES_WLR_CLIENT_ACCOUNTING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+struct wlr_compositor;
+
+/**
+ * Keeps track of the resources held by each client, and enforces optional
+ * limits on them.
+ *
+ * Objects are counted as they're created and destroyed, whatever the global
+ * they come from. Buffer memory and commit rates are only tracked for surfaces
+ * created through the wlr_compositor given at creation time.
+ */
+
+enum wlr_client_object_type {
+	WLR_CLIENT_OBJECT_SURFACE, // wl_surface
+	WLR_CLIENT_OBJECT_SUBSURFACE, // wl_subsurface
+	WLR_CLIENT_OBJECT_REGION, // wl_region
+	WLR_CLIENT_OBJECT_SHM_POOL, // wl_shm_pool
+	WLR_CLIENT_OBJECT_DMABUF_PARAMS, // zwp_linux_buffer_params_v1
+	WLR_CLIENT_OBJECT_BUFFER, // wl_buffer
+	WLR_CLIENT_OBJECT_INPUT_DEVICE, // wl_pointer, wl_keyboard, wl_touch
+	WLR_CLIENT_OBJECT_SHELL_SURFACE, // xdg-shell, layer-shell, wl_shell
+	WLR_CLIENT_OBJECT_OTHER,
+	WLR_CLIENT_OBJECT_TYPE_LAST,
+};
+
+/**
+ * Limits on the resources of a single client. Zero means unlimited.
+ */
+struct wlr_client_limits {
+	size_t objects[WLR_CLIENT_OBJECT_TYPE_LAST];
+	size_t total_objects;
+	// Memory used by the buffers currently attached to the client's surfaces,
+	// in bytes
+	size_t buffer_bytes;
+	// Surface commits per second
+	uint32_t commit_rate;
+};
+
+struct wlr_client_usage {
+	struct wlr_client_accounting *accounting;
+	struct wl_client *client;
+	struct wl_list link; // wlr_client_accounting::clients
+
+	size_t objects[WLR_CLIENT_OBJECT_TYPE_LAST];
+	size_t total_objects;
+	size_t buffer_bytes;
+	// Number of surface commits during the last full second
+	uint32_t commit_rate;
+	// The commit rate limit has been exceeded during the current second, the
+	// compositor may want to hold back frame callbacks until it's cleared
+	bool throttled;
+
+	// private state
+
+	uint32_t commits; // during the current second
+	int64_t commits_start_msec;
+	struct wl_list resources; // client_resource::link
+	struct wl_list surfaces; // client_surface::link
+
+	struct wl_listener client_destroy;
+	struct wl_listener resource_created;
+};
+
+enum wlr_client_limit {
+	WLR_CLIENT_LIMIT_OBJECTS, // see object_type
+	WLR_CLIENT_LIMIT_TOTAL_OBJECTS,
+	WLR_CLIENT_LIMIT_BUFFER_BYTES,
+	WLR_CLIENT_LIMIT_COMMIT_RATE,
+};
+
+struct wlr_client_limit_event {
+	struct wlr_client_usage *usage;
+	enum wlr_client_limit limit;
+	enum wlr_client_object_type object_type; // WLR_CLIENT_LIMIT_OBJECTS only
+	// Whether to disconnect the client, can be changed by listeners. Defaults
+	// to true, except for WLR_CLIENT_LIMIT_COMMIT_RATE.
+	bool reject;
+};
+
+struct wlr_client_accounting {
+	struct wl_display *display;
+	struct wl_list clients; // wlr_client_usage::link
+
+	struct wlr_client_limits limits;
+
+	struct {
+		// Emitted when a client goes over a limit, with a
+		// struct wlr_client_limit_event
+		struct wl_signal limit_exceeded;
+		struct wl_signal destroy;
+	} events;
+
+	struct wl_listener display_destroy;
+	struct wl_listener client_created;
+	struct wl_listener new_surface;
+	struct wl_listener compositor_destroy;
+
+	void *data;
+};
+
+/**
+ * Starts tracking the resources of all clients of the display. The compositor
+ * is optional, buffer memory and commit rates aren't tracked without it.
+ */
+struct wlr_client_accounting *wlr_client_accounting_create(
+	struct wl_display *display, struct wlr_compositor *compositor);
+
+/**
+ * Get the resource usage of a client, or NULL if the client isn't known.
+ */
+struct wlr_client_usage *wlr_client_accounting_get_usage(
+	struct wlr_client_accounting *accounting, struct wl_client *client);
+
+#endif
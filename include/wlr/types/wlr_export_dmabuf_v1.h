@@ -13,10 +13,23 @@
 #include <wayland-server-core.h>
 #include <wlr/render/dmabuf.h>
 
+enum wlr_export_dmabuf_drop_policy {
+	// Cancel the client's oldest frame to make room for a new one
+	WLR_EXPORT_DMABUF_DROP_OLDEST,
+	// Cancel new frames until the client destroys an older one
+	WLR_EXPORT_DMABUF_DROP_NEWEST,
+};
+
 struct wlr_export_dmabuf_manager_v1 {
 	struct wl_global *global;
 	struct wl_list frames; // wlr_export_dmabuf_frame_v1::link
 
+	// Frames keep the output buffer they export away from rendering until
+	// the client destroys them. Maximum number of such frames per client,
+	// zero means unlimited. Defaults to 2.
+	size_t max_frames_per_client;
+	enum wlr_export_dmabuf_drop_policy drop_policy;
+
 	struct wl_listener display_destroy;
 
 	struct {
@@ -30,11 +43,16 @@ struct wlr_export_dmabuf_frame_v1 {
 	struct wl_list link; // wlr_export_dmabuf_manager_v1::frames
 
 	struct wlr_dmabuf_attributes attribs;
+	// NULL once the frame has been sent
 	struct wlr_output *output;
+	// Locked output buffer, NULL if the frame hasn't been sent or if the
+	// backend can't lock buffers
+	struct wlr_buffer *buffer;
 
 	bool cursor_locked;
 
-	struct wl_listener output_precommit;
+	struct wl_listener output_present;
+	struct wl_listener output_destroy;
 };
 
 struct wlr_export_dmabuf_manager_v1 *wlr_export_dmabuf_manager_v1_create(
@@ -9,6 +9,7 @@
 #ifndef WLR_TYPES_WLR_IDLE_H
 #define WLR_TYPES_WLR_IDLE_H
 
+#include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_seat.h>
 
@@ -27,6 +28,12 @@ struct wlr_idle {
 	struct wl_event_loop *event_loop;
 	bool enabled;
 
+	// A single timer is shared by all idle timeouts, armed for the earliest
+	// deadline
+	struct wl_event_source *timer_source;
+	bool timer_armed;
+	int64_t timer_deadline; // CLOCK_MONOTONIC, in milliseconds
+
 	struct wl_listener display_destroy;
 	struct {
 		struct wl_signal activity_notify;
@@ -39,12 +46,13 @@ struct wlr_idle {
 struct wlr_idle_timeout {
 	struct wl_resource *resource;
 	struct wl_list link;
+	struct wlr_idle *idle;
 	struct wlr_seat *seat;
 
-	struct wl_event_source *idle_source;
 	bool idle_state;
 	bool enabled;
 	uint32_t timeout; // milliseconds
+	int64_t deadline; // CLOCK_MONOTONIC, in milliseconds
 
 	struct {
 		struct wl_signal idle;
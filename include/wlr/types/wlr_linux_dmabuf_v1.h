@@ -13,12 +13,23 @@
 #include <wayland-server-protocol.h>
 #include <wlr/render/dmabuf.h>
 
+struct wlr_dmabuf_v1_texture;
+
 struct wlr_dmabuf_v1_buffer {
 	struct wlr_renderer *renderer;
 	struct wl_resource *buffer_resource;
 	struct wl_resource *params_resource;
 	struct wlr_dmabuf_attributes attributes;
 	bool has_modifier;
+
+	// private state
+
+	struct wlr_linux_dmabuf_v1 *linux_dmabuf; // NULL if destroyed
+	struct wl_list link; // wlr_linux_dmabuf_v1.buffers
+
+	// Imported when the buffer is created, shared with other buffers backed
+	// by the same DMA-BUF planes
+	struct wlr_dmabuf_v1_texture *texture;
 };
 
 /**
@@ -50,6 +61,12 @@ struct wlr_linux_dmabuf_v1 {
 		struct wl_signal destroy;
 	} events;
 
+	// private state
+
+	struct wl_list buffers; // wlr_dmabuf_v1_buffer.link
+	// Import cache, keyed by DMA-BUF plane identity
+	struct wl_list textures; // wlr_dmabuf_v1_texture.link
+
 	struct wl_listener display_destroy;
 	struct wl_listener renderer_destroy;
 };
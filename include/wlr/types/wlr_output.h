@@ -35,6 +35,9 @@ struct wlr_output_cursor {
 
 	// only when using a software cursor without a surface
 	struct wlr_texture *texture;
+	// Textures of the images set recently, private to wlr_output, so that
+	// switching back to an image reuses its texture
+	struct wl_list image_cache; // output_cursor_image::link
 
 	// only when using a cursor surface
 	struct wlr_surface *surface;
@@ -393,6 +396,13 @@ void wlr_output_set_gamma(struct wlr_output *output, size_t size,
  */
 bool wlr_output_export_dmabuf(struct wlr_output *output,
 	struct wlr_dmabuf_attributes *attribs);
+/**
+ * Locks the buffer currently displayed by the output, so that later frames
+ * don't overwrite it. The caller must release it with wlr_buffer_unlock.
+ *
+ * Returns NULL if the backend doesn't support this or can't spare the buffer.
+ */
+struct wlr_buffer *wlr_output_lock_front_buffer(struct wlr_output *output);
 /**
  * Returns the wlr_output matching the provided wl_output resource. If the
  * resource isn't a wl_output, it aborts. If the resource is inert (because the
@@ -10,6 +10,7 @@
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
 #include <stdbool.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_box.h>
 
@@ -56,6 +57,11 @@ struct wlr_screencopy_frame_v1 {
 	struct wl_listener output_destroy;
 	struct wl_listener output_enable;
 
+	// Set while the ready event waits for a GPU copy to complete
+	int fence_fd;
+	struct wl_event_source *fence_source;
+	struct timespec ready_time;
+
 	void *data;
 };
 
@@ -126,6 +126,11 @@ struct wlr_surface {
 	// wlr_subsurface::parent_pending_link
 	struct wl_list subsurface_pending_list;
 
+	// private state
+
+	// Textures of recently attached wl_shm buffers
+	struct wl_list shm_textures; // wlr_surface_shm_texture::link
+
 	struct wl_listener renderer_destroy;
 
 	void *data;
@@ -0,0 +1,98 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_VISIBILITY_TRACKER_H
+#define WLR_TYPES_WLR_VISIBILITY_TRACKER_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+
+struct wlr_output_layout;
+struct wlr_surface;
+
+/**
+ * Helps throttling clients whose surfaces can't be seen.
+ *
+ * Each time the scene changes, the compositor describes the surfaces it
+ * displays, from top to bottom. Surfaces that are off-screen, fully covered
+ * by the opaque regions of the surfaces above them, or not part of the scene
+ * are hidden.
+ *
+ * The compositor should only send frame done events to visible surfaces, see
+ * wlr_visibility_tracker_surface_is_visible. The tracker sends frame done
+ * events to hidden surfaces at a low rate, so that their clients don't stall
+ * completely.
+ */
+struct wlr_visibility_tracker {
+	struct wl_list surfaces; // wlr_visibility_surface::link
+
+	// Milliseconds between frame done events sent to hidden surfaces. Zero
+	// means that hidden surfaces don't get any. Defaults to one second.
+	uint32_t hidden_frame_interval;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	// private state
+
+	struct wl_event_source *timer;
+	bool timer_armed;
+
+	bool in_pass;
+	uint32_t pass_seq;
+	pixman_region32_t screen; // layout coordinates
+	pixman_region32_t covered; // by the surfaces added so far in the pass
+
+	struct wl_listener display_destroy;
+};
+
+struct wlr_visibility_surface {
+	struct wlr_surface *surface;
+	struct wl_list link; // wlr_visibility_tracker::surfaces
+
+	bool visible;
+
+	// private state
+
+	uint32_t pass_seq;
+
+	struct wl_listener surface_destroy;
+};
+
+struct wlr_visibility_tracker *wlr_visibility_tracker_create(
+	struct wl_display *display);
+
+/**
+ * Start describing the scene. The screen is made of the outputs of the
+ * layout.
+ */
+void wlr_visibility_tracker_begin(struct wlr_visibility_tracker *tracker,
+	struct wlr_output_layout *layout);
+/**
+ * Add a surface to the scene, below the ones added before. The coordinates are
+ * in the layout's coordinate space. Subsurfaces need to be added separately,
+ * e.g. with wlr_surface_for_each_surface.
+ */
+void wlr_visibility_tracker_add_surface(struct wlr_visibility_tracker *tracker,
+	struct wlr_surface *surface, int lx, int ly);
+/**
+ * Finish describing the scene. Surfaces which haven't been added are hidden.
+ */
+void wlr_visibility_tracker_end(struct wlr_visibility_tracker *tracker);
+
+/**
+ * Checks whether a surface was visible as of the last scene description.
+ * Surfaces which have never been added are considered visible.
+ */
+bool wlr_visibility_tracker_surface_is_visible(
+	struct wlr_visibility_tracker *tracker, struct wlr_surface *surface);
+
+#endif
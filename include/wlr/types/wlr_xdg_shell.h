@@ -13,12 +13,29 @@
 #include <wayland-server-core.h>
 #include "xdg-shell-protocol.h"
 
+enum wlr_xdg_configure_throttle {
+	// Send configures as soon as the event loop is idle
+	WLR_XDG_CONFIGURE_THROTTLE_NONE,
+	// Send at most one configure per surface commit
+	WLR_XDG_CONFIGURE_THROTTLE_COMMIT,
+	// Additionally wait for the previous configure to be acked
+	WLR_XDG_CONFIGURE_THROTTLE_ACK,
+};
+
 struct wlr_xdg_shell {
 	struct wl_global *global;
 	struct wl_list clients;
 	struct wl_list popup_grabs;
 	uint32_t ping_timeout;
 
+	/**
+	 * Throttling of configure events. When a configure is throttled, state
+	 * changes keep being coalesced into it until the client catches up, e.g.
+	 * so that an interactive resize doesn't make clients draw sizes that are
+	 * already outdated. Defaults to WLR_XDG_CONFIGURE_THROTTLE_NONE.
+	 */
+	enum wlr_xdg_configure_throttle configure_throttle;
+
 	struct wl_listener display_destroy;
 
 	struct {
@@ -179,6 +196,10 @@ struct wlr_xdg_surface {
 	struct wl_event_source *configure_idle;
 	uint32_t configure_next_serial;
 	struct wl_list configure_list;
+	// A configure is scheduled but held back by the shell's throttling
+	bool configure_deferred;
+	// The surface hasn't been committed since the last configure was sent
+	bool configure_awaiting_commit;
 
 	bool has_next_geometry;
 	struct wlr_box next_geometry;
@@ -0,0 +1,116 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_XDG_TRANSACTION_H
+#define WLR_TYPES_WLR_XDG_TRANSACTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <wayland-server-core.h>
+#include <wayland-server-protocol.h>
+#include <wlr/types/wlr_box.h>
+
+struct wlr_client_buffer;
+struct wlr_xdg_surface;
+
+/**
+ * A transaction groups configures sent to several xdg-surfaces, e.g. when a
+ * tiling compositor resizes the windows of a workspace, so that they can be
+ * displayed all at once.
+ *
+ * When a surface is added, the buffers it displays are saved. The compositor
+ * should render the saved buffers instead of the surface until the `apply`
+ * event, which is emitted once all surfaces have acked their configure and
+ * committed, or when the timeout expires. The compositor should then damage
+ * the affected outputs so that the new layout is displayed in a single frame.
+ * The transaction is destroyed after the `apply` event.
+ */
+struct wlr_xdg_transaction {
+	struct wl_list surfaces; // wlr_xdg_transaction_surface::link
+
+	struct {
+		struct wl_signal apply;
+		struct wl_signal destroy;
+	} events;
+
+	// private state
+
+	struct wl_event_source *timer;
+	bool committed;
+	size_t pending; // number of surfaces which aren't ready yet
+
+	void *data;
+};
+
+/**
+ * A buffer displayed when the surface was added to the transaction.
+ */
+struct wlr_xdg_transaction_saved_buffer {
+	struct wlr_client_buffer *buffer;
+	// Position relative to the xdg-surface's surface
+	int sx, sy;
+	// Size in surface-local coordinates
+	int width, height;
+	enum wl_output_transform transform;
+
+	struct wl_list link; // wlr_xdg_transaction_surface::saved_buffers
+};
+
+struct wlr_xdg_transaction_surface {
+	struct wlr_xdg_transaction *transaction;
+	// NULL if the xdg-surface has been destroyed
+	struct wlr_xdg_surface *xdg_surface;
+	struct wl_list link; // wlr_xdg_transaction::surfaces
+
+	uint32_t serial; // configure serial the transaction waits for
+	bool ready;
+
+	// Geometry of the xdg-surface when it was added
+	struct wlr_box saved_geometry;
+	// Buffers of the surface and its subsurfaces, from bottom to top
+	struct wl_list saved_buffers; // wlr_xdg_transaction_saved_buffer::link
+
+	// private state
+
+	struct wl_listener surface_commit;
+	struct wl_listener xdg_surface_destroy;
+};
+
+struct wlr_xdg_transaction *wlr_xdg_transaction_create(
+	struct wl_display *display);
+/**
+ * Destroys the transaction without emitting the `apply` event.
+ */
+void wlr_xdg_transaction_destroy(struct wlr_xdg_transaction *transaction);
+
+/**
+ * Adds a surface to the transaction, waiting for the configure with the
+ * provided serial, as returned by e.g. wlr_xdg_toplevel_set_size. Surfaces
+ * can't be added once the transaction has been committed.
+ */
+struct wlr_xdg_transaction_surface *wlr_xdg_transaction_add_surface(
+	struct wlr_xdg_transaction *transaction,
+	struct wlr_xdg_surface *xdg_surface, uint32_t serial);
+
+/**
+ * Finishes describing the transaction. The `apply` event is emitted as soon
+ * as all surfaces are ready, or after the timeout in milliseconds. A zero
+ * timeout waits forever.
+ */
+void wlr_xdg_transaction_commit(struct wlr_xdg_transaction *transaction,
+	uint32_t timeout);
+
+/**
+ * Returns the state of a surface in the transaction, or NULL if the surface
+ * isn't part of it.
+ */
+struct wlr_xdg_transaction_surface *wlr_xdg_transaction_get_surface(
+	struct wlr_xdg_transaction *transaction,
+	struct wlr_xdg_surface *xdg_surface);
+
+#endif
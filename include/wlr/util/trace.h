@@ -0,0 +1,24 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_UTIL_TRACE_H
+#define WLR_UTIL_TRACE_H
+
+#include <stdbool.h>
+
+/**
+ * Writes the frame timeline events recorded so far to `path`, in the Chrome
+ * trace event JSON format. The result can be loaded in chrome://tracing or
+ * Perfetto.
+ *
+ * Events are only recorded if wlroots has been built with the `tracing`
+ * option, this function fails otherwise.
+ */
+bool wlr_trace_dump(const char *path);
+
+#endif
@@ -279,6 +279,27 @@ bool wlr_egl_init(struct wlr_egl *egl, EGLenum platform, void *remote_display,
 			"eglExportDMABUFImageMESA");
 	}
 
+	if (check_egl_ext(display_exts_str, "EGL_KHR_fence_sync")) {
+		egl->exts.fence_sync_khr = true;
+		load_egl_proc(&egl->procs.eglCreateSyncKHR, "eglCreateSyncKHR");
+		load_egl_proc(&egl->procs.eglDestroySyncKHR, "eglDestroySyncKHR");
+		load_egl_proc(&egl->procs.eglClientWaitSyncKHR,
+			"eglClientWaitSyncKHR");
+	}
+
+	if (egl->exts.fence_sync_khr &&
+			check_egl_ext(display_exts_str, "EGL_ANDROID_native_fence_sync")) {
+		egl->exts.native_fence_sync_android = true;
+		load_egl_proc(&egl->procs.eglDupNativeFenceFDANDROID,
+			"eglDupNativeFenceFDANDROID");
+	}
+
+	if (egl->exts.fence_sync_khr &&
+			check_egl_ext(display_exts_str, "EGL_KHR_wait_sync")) {
+		egl->exts.wait_sync_khr = true;
+		load_egl_proc(&egl->procs.eglWaitSyncKHR, "eglWaitSyncKHR");
+	}
+
 	if (check_egl_ext(display_exts_str, "EGL_WL_bind_wayland_display")) {
 		egl->exts.bind_wayland_display_wl = true;
 		load_egl_proc(&egl->procs.eglBindWaylandDisplayWL,
@@ -352,11 +373,45 @@ error:
 	return false;
 }
 
+bool wlr_egl_init_shared(struct wlr_egl *egl, struct wlr_egl *parent) {
+	assert(parent->parent == NULL);
+
+	*egl = *parent;
+	egl->wl_display = NULL;
+	egl->parent = parent;
+
+	if (eglBindAPI(EGL_OPENGL_ES_API) == EGL_FALSE) {
+		wlr_log(WLR_ERROR, "Failed to bind to the OpenGL ES API");
+		return false;
+	}
+
+	const EGLint attribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE,
+	};
+	egl->context = eglCreateContext(egl->display, egl->config,
+		parent->context, attribs);
+	if (egl->context == EGL_NO_CONTEXT) {
+		wlr_log(WLR_ERROR, "Failed to create shared EGL context");
+		return false;
+	}
+
+	return true;
+}
+
 void wlr_egl_finish(struct wlr_egl *egl) {
 	if (egl == NULL) {
 		return;
 	}
 
+	if (egl->parent != NULL) {
+		eglMakeCurrent(egl->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			EGL_NO_CONTEXT);
+		eglDestroyContext(egl->display, egl->context);
+		eglReleaseThread();
+		return;
+	}
+
 	for (size_t i = 0; i < egl->dmabuf_formats.len; i++) {
 		free(egl->external_only_dmabuf_formats[i]);
 	}
@@ -476,6 +531,35 @@ bool wlr_egl_restore_context(struct wlr_egl_context *context) {
 			context->read_surface, context->context);
 }
 
+int wlr_egl_dup_fence_fd(struct wlr_egl *egl) {
+	if (!egl->exts.native_fence_sync_android) {
+		return -1;
+	}
+
+	static const EGLint attribs[] = {
+		EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID,
+		EGL_NONE,
+	};
+	EGLSyncKHR sync = egl->procs.eglCreateSyncKHR(egl->display,
+		EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+	if (sync == EGL_NO_SYNC_KHR) {
+		wlr_log(WLR_ERROR, "eglCreateSyncKHR failed");
+		return -1;
+	}
+
+	// The sync file only exists once the fence command has been flushed
+	egl->procs.eglClientWaitSyncKHR(egl->display, sync,
+		EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 0);
+
+	int fd = egl->procs.eglDupNativeFenceFDANDROID(egl->display, sync);
+	egl->procs.eglDestroySyncKHR(egl->display, sync);
+	if (fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+		wlr_log(WLR_ERROR, "eglDupNativeFenceFDANDROID failed");
+		return -1;
+	}
+	return fd;
+}
+
 bool wlr_egl_swap_buffers(struct wlr_egl *egl, EGLSurface surface,
 		pixman_region32_t *damage) {
 	// Never block when swapping buffers on Wayland
@@ -0,0 +1,460 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+// Entries are surrounded by a border replicating their edge pixels, so that
+// linear filtering doesn't sample neighbouring entries
+#define ENTRY_BORDER 1
+// Shelf heights are rounded up to a multiple of this, so that shelves can be
+// reused by entries of slightly different heights
+#define SHELF_ALIGN 4
+// Maximum number of entries evicted to make room for a new one
+#define MAX_EVICTIONS 8
+
+void gles2_atlas_init(struct wlr_gles2_atlas *atlas) {
+	wl_list_init(&atlas->pages);
+	wl_list_init(&atlas->lru);
+}
+
+static void page_destroy(struct wlr_gles2_atlas_page *page) {
+	struct wlr_gles2_atlas_shelf *shelf;
+	wl_array_for_each(shelf, &page->shelves) {
+		wl_array_release(&shelf->free);
+	}
+	wl_array_release(&page->shelves);
+
+	glDeleteTextures(1, &page->tex);
+	wl_list_remove(&page->link);
+	free(page);
+}
+
+void gles2_atlas_finish(struct wlr_gles2_atlas *atlas) {
+	// Textures outliving the renderer can't be sampled anymore, but must
+	// still be safe to destroy
+	struct wlr_gles2_texture *texture, *tmp_texture;
+	wl_list_for_each_safe(texture, tmp_texture, &atlas->lru, atlas.link) {
+		wl_list_remove(&texture->atlas.link);
+		wl_list_init(&texture->atlas.link);
+		texture->atlas.page = NULL;
+		texture->tex = 0;
+	}
+
+	struct wlr_gles2_atlas_page *page, *tmp_page;
+	wl_list_for_each_safe(page, tmp_page, &atlas->pages, link) {
+		page_destroy(page);
+	}
+
+	if (atlas->fbo != 0) {
+		glDeleteFramebuffers(1, &atlas->fbo);
+	}
+}
+
+static struct wlr_gles2_atlas_page *page_create(struct wlr_gles2_atlas *atlas,
+		const struct wlr_gles2_pixel_format *fmt) {
+	struct wlr_gles2_atlas_page *page =
+		calloc(1, sizeof(struct wlr_gles2_atlas_page));
+	if (page == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	page->atlas = atlas;
+	page->gl_format = fmt->gl_format;
+	page->gl_type = fmt->gl_type;
+	page->size = atlas->page_size;
+	wl_array_init(&page->shelves);
+
+	PUSH_GLES2_DEBUG;
+	glGenTextures(1, &page->tex);
+	glBindTexture(GL_TEXTURE_2D, page->tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, fmt->gl_format, page->size, page->size, 0,
+		fmt->gl_format, fmt->gl_type, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	POP_GLES2_DEBUG;
+
+	wl_list_insert(atlas->pages.prev, &page->link);
+
+	wlr_log(WLR_DEBUG, "Created %dx%d texture atlas page", page->size,
+		page->size);
+	return page;
+}
+
+static bool shelf_alloc(struct wlr_gles2_atlas_shelf *shelf, int width,
+		int *x) {
+	struct wlr_gles2_atlas_span *spans = shelf->free.data;
+	size_t spans_len = shelf->free.size / sizeof(struct wlr_gles2_atlas_span);
+	for (size_t i = 0; i < spans_len; i++) {
+		if (spans[i].width < width) {
+			continue;
+		}
+		*x = spans[i].x;
+		spans[i].x += width;
+		spans[i].width -= width;
+		if (spans[i].width == 0) {
+			memmove(&spans[i], &spans[i + 1],
+				(spans_len - i - 1) * sizeof(struct wlr_gles2_atlas_span));
+			shelf->free.size -= sizeof(struct wlr_gles2_atlas_span);
+		}
+		return true;
+	}
+	return false;
+}
+
+static void shelf_free(struct wlr_gles2_atlas_shelf *shelf, int x, int width) {
+	struct wlr_gles2_atlas_span *spans = shelf->free.data;
+	size_t spans_len = shelf->free.size / sizeof(struct wlr_gles2_atlas_span);
+
+	size_t i = 0;
+	while (i < spans_len && spans[i].x < x) {
+		i++;
+	}
+
+	// Coalesce with the previous and next spans if they're adjacent
+	bool merge_prev = i > 0 && spans[i - 1].x + spans[i - 1].width == x;
+	bool merge_next = i < spans_len && x + width == spans[i].x;
+	if (merge_prev && merge_next) {
+		spans[i - 1].width += width + spans[i].width;
+		memmove(&spans[i], &spans[i + 1],
+			(spans_len - i - 1) * sizeof(struct wlr_gles2_atlas_span));
+		shelf->free.size -= sizeof(struct wlr_gles2_atlas_span);
+	} else if (merge_prev) {
+		spans[i - 1].width += width;
+	} else if (merge_next) {
+		spans[i].x = x;
+		spans[i].width += width;
+	} else {
+		if (wl_array_add(&shelf->free,
+				sizeof(struct wlr_gles2_atlas_span)) == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed, leaking atlas space");
+			return;
+		}
+		spans = shelf->free.data;
+		memmove(&spans[i + 1], &spans[i],
+			(spans_len - i) * sizeof(struct wlr_gles2_atlas_span));
+		spans[i] = (struct wlr_gles2_atlas_span){ .x = x, .width = width };
+	}
+}
+
+static bool page_alloc(struct wlr_gles2_atlas_page *page, int width,
+		int height, int *x, int *y) {
+	// Best fit: the lowest shelf with enough room, without wasting more than
+	// half of its height
+	struct wlr_gles2_atlas_shelf *best = NULL, *shelf;
+	wl_array_for_each(shelf, &page->shelves) {
+		if (shelf->height < height || shelf->height > 2 * height) {
+			continue;
+		}
+		if (best != NULL && best->height <= shelf->height) {
+			continue;
+		}
+		struct wlr_gles2_atlas_span *span;
+		wl_array_for_each(span, &shelf->free) {
+			if (span->width >= width) {
+				best = shelf;
+				break;
+			}
+		}
+	}
+	if (best != NULL) {
+		*y = best->y;
+		return shelf_alloc(best, width, x);
+	}
+
+	int shelf_height = (height + SHELF_ALIGN - 1) / SHELF_ALIGN * SHELF_ALIGN;
+	if (page->shelves_height + shelf_height > page->size) {
+		return false;
+	}
+
+	shelf = wl_array_add(&page->shelves, sizeof(struct wlr_gles2_atlas_shelf));
+	if (shelf == NULL) {
+		return false;
+	}
+	shelf->y = page->shelves_height;
+	shelf->height = shelf_height;
+	wl_array_init(&shelf->free);
+	struct wlr_gles2_atlas_span *span =
+		wl_array_add(&shelf->free, sizeof(struct wlr_gles2_atlas_span));
+	if (span == NULL) {
+		page->shelves.size -= sizeof(struct wlr_gles2_atlas_shelf);
+		return false;
+	}
+	*span = (struct wlr_gles2_atlas_span){ .x = 0, .width = page->size };
+	page->shelves_height += shelf_height;
+
+	*y = shelf->y;
+	return shelf_alloc(shelf, width, x);
+}
+
+static void page_free(struct wlr_gles2_atlas_page *page, int x, int y,
+		int width) {
+	struct wlr_gles2_atlas_shelf *shelves = page->shelves.data;
+	size_t shelves_len =
+		page->shelves.size / sizeof(struct wlr_gles2_atlas_shelf);
+
+	size_t i = 0;
+	while (i < shelves_len && shelves[i].y != y) {
+		i++;
+	}
+	assert(i < shelves_len);
+	shelf_free(&shelves[i], x, width);
+
+	// Release trailing empty shelves, so that their room can be used by
+	// shelves of a different height
+	while (shelves_len > 0) {
+		struct wlr_gles2_atlas_shelf *last = &shelves[shelves_len - 1];
+		struct wlr_gles2_atlas_span *spans = last->free.data;
+		if (last->free.size != sizeof(struct wlr_gles2_atlas_span) ||
+				spans[0].width != page->size) {
+			break;
+		}
+		page->shelves_height -= last->height;
+		wl_array_release(&last->free);
+		shelves_len--;
+		page->shelves.size -= sizeof(struct wlr_gles2_atlas_shelf);
+	}
+}
+
+static bool atlas_alloc(struct wlr_gles2_atlas *atlas,
+		const struct wlr_gles2_pixel_format *fmt, int width, int height,
+		struct wlr_gles2_atlas_page **page_ptr, int *x, int *y) {
+	size_t pages_len = 0;
+	struct wlr_gles2_atlas_page *page;
+	wl_list_for_each(page, &atlas->pages, link) {
+		pages_len++;
+		if (page->gl_format != fmt->gl_format ||
+				page->gl_type != fmt->gl_type) {
+			continue;
+		}
+		if (page_alloc(page, width, height, x, y)) {
+			*page_ptr = page;
+			return true;
+		}
+	}
+
+	if (pages_len >= atlas->max_pages) {
+		return false;
+	}
+
+	page = page_create(atlas, fmt);
+	if (page == NULL) {
+		return false;
+	}
+	if (!page_alloc(page, width, height, x, y)) {
+		page_destroy(page);
+		return false;
+	}
+	*page_ptr = page;
+	return true;
+}
+
+bool gles2_atlas_add(struct wlr_gles2_atlas *atlas,
+		struct wlr_gles2_texture *texture,
+		const struct wlr_gles2_pixel_format *fmt) {
+	int width = texture->wlr_texture.width;
+	int height = texture->wlr_texture.height;
+	if (atlas->max_entry_size == 0 || width > atlas->max_entry_size ||
+			height > atlas->max_entry_size) {
+		return false;
+	}
+
+	int slot_width = width + 2 * ENTRY_BORDER;
+	int slot_height = height + 2 * ENTRY_BORDER;
+
+	struct wlr_gles2_atlas_page *page = NULL;
+	int x, y;
+	bool ok = atlas_alloc(atlas, fmt, slot_width, slot_height, &page, &x, &y);
+	for (size_t i = 0; !ok && i < MAX_EVICTIONS; i++) {
+		// Make room by evicting the least recently used entry with the
+		// same format
+		struct wlr_gles2_texture *victim = NULL, *entry;
+		wl_list_for_each_reverse(entry, &atlas->lru, atlas.link) {
+			if (entry->atlas.page->gl_format == fmt->gl_format &&
+					entry->atlas.page->gl_type == fmt->gl_type) {
+				victim = entry;
+				break;
+			}
+		}
+		if (victim == NULL || !gles2_atlas_evict(victim)) {
+			break;
+		}
+		ok = atlas_alloc(atlas, fmt, slot_width, slot_height, &page, &x, &y);
+	}
+	if (!ok) {
+		return false;
+	}
+
+	page->entries++;
+	texture->tex = page->tex;
+	texture->atlas.page = page;
+	texture->atlas.x = x + ENTRY_BORDER;
+	texture->atlas.y = y + ENTRY_BORDER;
+	wl_list_insert(&atlas->lru, &texture->atlas.link);
+	return true;
+}
+
+void gles2_atlas_remove(struct wlr_gles2_texture *texture) {
+	struct wlr_gles2_atlas_page *page = texture->atlas.page;
+	if (page == NULL) {
+		return;
+	}
+
+	page_free(page, texture->atlas.x - ENTRY_BORDER,
+		texture->atlas.y - ENTRY_BORDER,
+		texture->wlr_texture.width + 2 * ENTRY_BORDER);
+	page->entries--;
+
+	wl_list_remove(&texture->atlas.link);
+	wl_list_init(&texture->atlas.link);
+	texture->atlas.page = NULL;
+	texture->tex = 0;
+
+	// Keep the first page around, it's likely to be needed again soon
+	struct wlr_gles2_atlas *atlas = page->atlas;
+	if (page->entries == 0 && atlas->pages.next != &page->link) {
+		page_destroy(page);
+	}
+}
+
+bool gles2_atlas_evict(struct wlr_gles2_texture *texture) {
+	struct wlr_gles2_atlas_page *page = texture->atlas.page;
+	assert(page != NULL);
+	struct wlr_gles2_atlas *atlas = page->atlas;
+	uint32_t width = texture->wlr_texture.width;
+	uint32_t height = texture->wlr_texture.height;
+
+	// The entry's room is about to be reused, pending draw calls must sample
+	// it before that
+	gles2_flush_current_batch();
+
+	PUSH_GLES2_DEBUG;
+
+	if (atlas->fbo == 0) {
+		glGenFramebuffers(1, &atlas->fbo);
+	}
+
+	GLint prev_fbo = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+	glGetError(); // Clear the error flag
+
+	glBindFramebuffer(GL_FRAMEBUFFER, atlas->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D, page->tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		wlr_log(WLR_DEBUG, "Cannot evict atlas entry: atlas page is not "
+			"renderable");
+		glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+		POP_GLES2_DEBUG;
+		return false;
+	}
+
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, page->gl_format, width, height, 0,
+		page->gl_format, page->gl_type, NULL);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+		texture->atlas.x, texture->atlas.y, width, height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D, 0, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+
+	if (glGetError() != GL_NO_ERROR) {
+		wlr_log(WLR_DEBUG, "Failed to copy atlas entry");
+		glDeleteTextures(1, &tex);
+		POP_GLES2_DEBUG;
+		return false;
+	}
+
+	POP_GLES2_DEBUG;
+
+	gles2_atlas_remove(texture);
+	texture->tex = tex;
+	return true;
+}
+
+static void upload(const struct wlr_gles2_pixel_format *fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		int dst_x, int dst_y, const void *data) {
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, src_x);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, src_y);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, dst_x, dst_y, width, height,
+		fmt->gl_format, fmt->gl_type, data);
+}
+
+void gles2_atlas_write_pixels(struct wlr_gles2_texture *texture,
+		const struct wlr_gles2_pixel_format *fmt, uint32_t stride,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		uint32_t dst_x, uint32_t dst_y, const void *data) {
+	assert(texture->atlas.page != NULL);
+	int x = texture->atlas.x, y = texture->atlas.y;
+	uint32_t tex_width = texture->wlr_texture.width;
+	uint32_t tex_height = texture->wlr_texture.height;
+
+	bool left = dst_x == 0, top = dst_y == 0;
+	bool right = dst_x + width == tex_width;
+	bool bottom = dst_y + height == tex_height;
+	uint32_t last_x = src_x + width - 1, last_y = src_y + height - 1;
+
+	PUSH_GLES2_DEBUG;
+
+	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / (fmt->bpp / 8));
+
+	upload(fmt, width, height, src_x, src_y,
+		x + dst_x, y + dst_y, data);
+
+	// Replicate the edges into the entry's border
+	if (left) {
+		upload(fmt, 1, height, src_x, src_y,
+			x - 1, y + dst_y, data);
+	}
+	if (right) {
+		upload(fmt, 1, height, last_x, src_y,
+			x + tex_width, y + dst_y, data);
+	}
+	if (top) {
+		upload(fmt, width, 1, src_x, src_y,
+			x + dst_x, y - 1, data);
+	}
+	if (bottom) {
+		upload(fmt, width, 1, src_x, last_y,
+			x + dst_x, y + tex_height, data);
+	}
+	if (top && left) {
+		upload(fmt, 1, 1, src_x, src_y, x - 1, y - 1, data);
+	}
+	if (top && right) {
+		upload(fmt, 1, 1, last_x, src_y, x + tex_width, y - 1, data);
+	}
+	if (bottom && left) {
+		upload(fmt, 1, 1, src_x, last_y, x - 1, y + tex_height, data);
+	}
+	if (bottom && right) {
+		upload(fmt, 1, 1, last_x, last_y,
+			x + tex_width, y + tex_height, data);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	POP_GLES2_DEBUG;
+}
+
+void gles2_atlas_touch(struct wlr_gles2_texture *texture) {
+	struct wlr_gles2_atlas_page *page = texture->atlas.page;
+	if (page == NULL) {
+		return;
+	}
+	wl_list_remove(&texture->atlas.link);
+	wl_list_insert(&page->atlas->lru, &texture->atlas.link);
+}
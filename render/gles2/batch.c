@@ -0,0 +1,354 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wayland-util.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+// How many draw calls to look back through when trying to merge a quad into
+// an existing draw call. Keeps recording linear in the number of quads.
+#define MERGE_LOOKBEHIND 16
+
+static const float identity[9] = {
+	1.0f, 0.0f, 0.0f,
+	0.0f, 1.0f, 0.0f,
+	0.0f, 0.0f, 1.0f,
+};
+
+void gles2_batch_init(struct wlr_gles2_batch *batch) {
+	wl_array_init(&batch->draws);
+	wl_array_init(&batch->quads);
+	wl_array_init(&batch->vertices);
+}
+
+void gles2_batch_finish(struct wlr_gles2_batch *batch) {
+	wl_array_release(&batch->draws);
+	wl_array_release(&batch->quads);
+	wl_array_release(&batch->vertices);
+}
+
+static bool draw_matches(const struct wlr_gles2_draw *draw,
+		struct wlr_gles2_tex_shader *shader, struct wlr_gles2_texture *texture,
+		const float color[static 4], float alpha) {
+	if (draw->shader != shader) {
+		return false;
+	}
+	if (shader == NULL) {
+		return memcmp(draw->color, color, sizeof(draw->color)) == 0;
+	}
+	return draw->target == texture->target && draw->tex == texture->tex &&
+		draw->alpha == alpha;
+}
+
+static bool draw_overlaps(const struct wlr_gles2_draw *draw,
+		GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2) {
+	return draw->x1 < x2 && x1 < draw->x2 && draw->y1 < y2 && y1 < draw->y2;
+}
+
+/**
+ * Finds a draw call the quad can be appended to without changing the
+ * rendering result, i.e. one with the same state and such that no later draw
+ * call overlaps the quad. Creates a new draw call if there is none.
+ */
+static size_t get_draw(struct wlr_gles2_batch *batch,
+		struct wlr_gles2_tex_shader *shader, struct wlr_gles2_texture *texture,
+		const float color[static 4], float alpha,
+		GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2) {
+	struct wlr_gles2_draw *draws = batch->draws.data;
+	size_t draws_len = batch->draws.size / sizeof(struct wlr_gles2_draw);
+
+	size_t min = draws_len > MERGE_LOOKBEHIND ?
+		draws_len - MERGE_LOOKBEHIND : 0;
+	for (size_t i = draws_len; i > min; i--) {
+		struct wlr_gles2_draw *draw = &draws[i - 1];
+		if (draw_matches(draw, shader, texture, color, alpha)) {
+			if (x1 < draw->x1) {
+				draw->x1 = x1;
+			}
+			if (y1 < draw->y1) {
+				draw->y1 = y1;
+			}
+			if (x2 > draw->x2) {
+				draw->x2 = x2;
+			}
+			if (y2 > draw->y2) {
+				draw->y2 = y2;
+			}
+			return i - 1;
+		}
+		if (draw_overlaps(draw, x1, y1, x2, y2)) {
+			break;
+		}
+	}
+
+	struct wlr_gles2_draw *draw =
+		wl_array_add(&batch->draws, sizeof(struct wlr_gles2_draw));
+	if (draw == NULL) {
+		return (size_t)-1;
+	}
+	memset(draw, 0, sizeof(*draw));
+	draw->shader = shader;
+	if (shader != NULL) {
+		draw->target = texture->target;
+		draw->tex = texture->tex;
+		draw->alpha = alpha;
+	} else {
+		memcpy(draw->color, color, sizeof(draw->color));
+	}
+	draw->x1 = x1;
+	draw->y1 = y1;
+	draw->x2 = x2;
+	draw->y2 = y2;
+	return draws_len;
+}
+
+static void transform_point(const float mat[static 9], GLfloat u, GLfloat v,
+		GLfloat *x, GLfloat *y) {
+	*x = mat[0] * u + mat[1] * v + mat[2];
+	*y = mat[3] * u + mat[4] * v + mat[5];
+}
+
+static void add_quad(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_tex_shader *shader, struct wlr_gles2_texture *texture,
+		const struct wlr_fbox *box, const float color[static 4], float alpha,
+		const float matrix[static 9],
+		GLfloat u1, GLfloat v1, GLfloat u2, GLfloat v2) {
+	struct wlr_gles2_batch *batch = &renderer->batch;
+
+	// Corners in parameter space: top left, top right, bottom left,
+	// bottom right
+	const GLfloat params[4][2] = {
+		{ u1, v1 }, { u2, v1 }, { u1, v2 }, { u2, v2 },
+	};
+
+	// Textures living in an atlas page only cover part of the GL texture
+	GLfloat tex_x = 0.0f, tex_y = 0.0f, tex_width = 1.0f, tex_height = 1.0f;
+	if (shader != NULL && texture->atlas.page != NULL) {
+		tex_x = texture->atlas.x;
+		tex_y = texture->atlas.y;
+		tex_width = tex_height = texture->atlas.page->size;
+		gles2_atlas_touch(texture);
+	} else if (shader != NULL) {
+		tex_width = texture->wlr_texture.width;
+		tex_height = texture->wlr_texture.height;
+	}
+
+	struct wlr_gles2_vertex corners[4] = {0};
+	for (size_t i = 0; i < 4; i++) {
+		GLfloat u = params[i][0], v = params[i][1];
+		transform_point(matrix, u, v, &corners[i].x, &corners[i].y);
+
+		if (shader != NULL) {
+			corners[i].s = (tex_x + box->x + u * box->width) / tex_width;
+			corners[i].t = (tex_y + box->y + v * box->height) / tex_height;
+			if (texture->inverted_y) {
+				corners[i].t = 1.0f - corners[i].t;
+			}
+		}
+	}
+
+	GLfloat x1 = corners[0].x, y1 = corners[0].y;
+	GLfloat x2 = corners[0].x, y2 = corners[0].y;
+	for (size_t i = 1; i < 4; i++) {
+		x1 = corners[i].x < x1 ? corners[i].x : x1;
+		y1 = corners[i].y < y1 ? corners[i].y : y1;
+		x2 = corners[i].x > x2 ? corners[i].x : x2;
+		y2 = corners[i].y > y2 ? corners[i].y : y2;
+	}
+
+	size_t draw = get_draw(batch, shader, texture, color, alpha,
+		x1, y1, x2, y2);
+	if (draw == (size_t)-1) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	struct wlr_gles2_quad *quad =
+		wl_array_add(&batch->quads, sizeof(struct wlr_gles2_quad));
+	if (quad == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	quad->draw = draw;
+	quad->verts[0] = corners[0];
+	quad->verts[1] = corners[1];
+	quad->verts[2] = corners[2];
+	quad->verts[3] = corners[1];
+	quad->verts[4] = corners[3];
+	quad->verts[5] = corners[2];
+}
+
+void gles2_batch_add_quad(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_tex_shader *shader, struct wlr_gles2_texture *texture,
+		const struct wlr_fbox *box, const float color[static 4], float alpha,
+		const float matrix[static 9]) {
+	struct wlr_gles2_batch *batch = &renderer->batch;
+
+	GLfloat u1 = 0.0f, v1 = 0.0f, u2 = 1.0f, v2 = 1.0f;
+
+	if (batch->scissor) {
+		bool axis_aligned = (matrix[1] == 0.0f && matrix[3] == 0.0f) ||
+			(matrix[0] == 0.0f && matrix[4] == 0.0f);
+		float det = matrix[0] * matrix[4] - matrix[1] * matrix[3];
+		if (det == 0.0f) {
+			return; // degenerate quad, nothing would be drawn
+		}
+
+		if (!axis_aligned) {
+			// The scissor rectangle can't be expressed in the quad's
+			// parameter space, let GL do the clipping
+			gles2_batch_flush(renderer);
+			glScissor(batch->scissor_box.x, batch->scissor_box.y,
+				batch->scissor_box.width, batch->scissor_box.height);
+			glEnable(GL_SCISSOR_TEST);
+			add_quad(renderer, shader, texture, box, color, alpha, matrix,
+				u1, v1, u2, v2);
+			gles2_batch_flush(renderer);
+			glDisable(GL_SCISSOR_TEST);
+			return;
+		}
+
+		// Map the scissor rectangle back to the quad's parameter space and
+		// clip the unit square against it
+		GLfloat sx[2] = { batch->scissor_x1, batch->scissor_x2 };
+		GLfloat sy[2] = { batch->scissor_y1, batch->scissor_y2 };
+		GLfloat su[2], sv[2];
+		for (size_t i = 0; i < 2; i++) {
+			GLfloat dx = sx[i] - matrix[2], dy = sy[i] - matrix[5];
+			su[i] = (matrix[4] * dx - matrix[1] * dy) / det;
+			sv[i] = (matrix[0] * dy - matrix[3] * dx) / det;
+		}
+		GLfloat su1 = su[0] < su[1] ? su[0] : su[1];
+		GLfloat su2 = su[0] < su[1] ? su[1] : su[0];
+		GLfloat sv1 = sv[0] < sv[1] ? sv[0] : sv[1];
+		GLfloat sv2 = sv[0] < sv[1] ? sv[1] : sv[0];
+
+		u1 = su1 > u1 ? su1 : u1;
+		v1 = sv1 > v1 ? sv1 : v1;
+		u2 = su2 < u2 ? su2 : u2;
+		v2 = sv2 < v2 ? sv2 : v2;
+		if (u1 >= u2 || v1 >= v2) {
+			return; // fully clipped
+		}
+	}
+
+	add_quad(renderer, shader, texture, box, color, alpha, matrix,
+		u1, v1, u2, v2);
+
+	if (!batch->enabled) {
+		gles2_batch_flush(renderer);
+	}
+}
+
+void gles2_batch_flush(struct wlr_gles2_renderer *renderer) {
+	struct wlr_gles2_batch *batch = &renderer->batch;
+
+	struct wlr_gles2_draw *draws = batch->draws.data;
+	size_t draws_len = batch->draws.size / sizeof(struct wlr_gles2_draw);
+	struct wlr_gles2_quad *quads = batch->quads.data;
+	size_t quads_len = batch->quads.size / sizeof(struct wlr_gles2_quad);
+	if (quads_len == 0) {
+		batch->draws.size = 0;
+		return;
+	}
+
+	// Sort the vertices by draw call, preserving submission order within
+	// each draw call
+	for (size_t i = 0; i < quads_len; i++) {
+		draws[quads[i].draw].count += 6;
+	}
+	GLint first = 0;
+	for (size_t i = 0; i < draws_len; i++) {
+		draws[i].first = first;
+		first += draws[i].count;
+		draws[i].count = 0;
+	}
+
+	batch->vertices.size = 0;
+	struct wlr_gles2_vertex *vertices = wl_array_add(&batch->vertices,
+		first * sizeof(struct wlr_gles2_vertex));
+	if (vertices == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		goto out;
+	}
+	for (size_t i = 0; i < quads_len; i++) {
+		struct wlr_gles2_draw *draw = &draws[quads[i].draw];
+		memcpy(&vertices[draw->first + draw->count], quads[i].verts,
+			sizeof(quads[i].verts));
+		draw->count += 6;
+	}
+
+	PUSH_GLES2_DEBUG;
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch->vbo);
+	glBufferData(GL_ARRAY_BUFFER, batch->vertices.size, vertices,
+		GL_STREAM_DRAW);
+
+	GLuint program = 0;
+	for (size_t i = 0; i < draws_len; i++) {
+		struct wlr_gles2_draw *draw = &draws[i];
+		struct wlr_gles2_tex_shader *shader = draw->shader;
+
+		GLint pos_attrib, tex_attrib = -1;
+		if (shader == NULL) {
+			if (program != renderer->shaders.quad.program) {
+				program = renderer->shaders.quad.program;
+				glUseProgram(program);
+				glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE,
+					identity);
+			}
+			glUniform4f(renderer->shaders.quad.color, draw->color[0],
+				draw->color[1], draw->color[2], draw->color[3]);
+			pos_attrib = renderer->shaders.quad.pos_attrib;
+		} else {
+			if (program != shader->program) {
+				program = shader->program;
+				glUseProgram(program);
+				glUniformMatrix3fv(shader->proj, 1, GL_FALSE, identity);
+				glUniform1i(shader->invert_y, 0);
+				glUniform1i(shader->tex, 0);
+			}
+			glUniform1f(shader->alpha, draw->alpha);
+			pos_attrib = shader->pos_attrib;
+			tex_attrib = shader->tex_attrib;
+
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(draw->target, draw->tex);
+			glTexParameteri(draw->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		}
+
+		glVertexAttribPointer(pos_attrib, 2, GL_FLOAT, GL_FALSE,
+			sizeof(struct wlr_gles2_vertex),
+			(const void *)offsetof(struct wlr_gles2_vertex, x));
+		glEnableVertexAttribArray(pos_attrib);
+		if (tex_attrib >= 0) {
+			glVertexAttribPointer(tex_attrib, 2, GL_FLOAT, GL_FALSE,
+				sizeof(struct wlr_gles2_vertex),
+				(const void *)offsetof(struct wlr_gles2_vertex, s));
+			glEnableVertexAttribArray(tex_attrib);
+		}
+
+		glDrawArrays(GL_TRIANGLES, draw->first, draw->count);
+
+		glDisableVertexAttribArray(pos_attrib);
+		if (tex_attrib >= 0) {
+			glDisableVertexAttribArray(tex_attrib);
+		}
+		if (shader != NULL) {
+			glBindTexture(draw->target, 0);
+		}
+	}
+
+	// Other draw paths use client-side vertex arrays
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	POP_GLES2_DEBUG;
+
+out:
+	batch->draws.size = 0;
+	batch->quads.size = 0;
+}
@@ -0,0 +1,249 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+static const char cache_magic[8] = "WLRPROG1";
+
+struct program_header {
+	char magic[8];
+	uint64_t hash;
+	uint32_t format;
+	uint32_t length;
+};
+
+static uint64_t hash_str(uint64_t hash, const char *str) {
+	// FNV-1a
+	for (const char *c = str; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 0x100000001b3;
+	}
+	// Separator, so that ("ab", "c") and ("a", "bc") differ
+	hash ^= 0xff;
+	hash *= 0x100000001b3;
+	return hash;
+}
+
+static bool mkdir_p(char *path) {
+	for (char *p = path + 1; *p != '\0'; p++) {
+		if (*p != '/') {
+			continue;
+		}
+		*p = '\0';
+		int ret = mkdir(path, 0700);
+		*p = '/';
+		if (ret != 0 && errno != EEXIST) {
+			return false;
+		}
+	}
+	return mkdir(path, 0700) == 0 || errno == EEXIST;
+}
+
+static char *get_cache_dir(void) {
+	const char *dir = getenv("WLR_GLES2_SHADER_CACHE_DIR");
+	if (dir != NULL) {
+		return dir[0] != '\0' ? strdup(dir) : NULL;
+	}
+
+	const char *base = getenv("XDG_CACHE_HOME");
+	const char *suffix = "/wlroots/gles2-programs";
+	if (base == NULL || base[0] == '\0') {
+		base = getenv("HOME");
+		suffix = "/.cache/wlroots/gles2-programs";
+		if (base == NULL || base[0] == '\0') {
+			return NULL;
+		}
+	}
+
+	size_t len = strlen(base) + strlen(suffix) + 1;
+	char *path = malloc(len);
+	if (path == NULL) {
+		return NULL;
+	}
+	snprintf(path, len, "%s%s", base, suffix);
+	return path;
+}
+
+void gles2_program_cache_init(struct wlr_gles2_program_cache *cache) {
+	cache->dir = get_cache_dir();
+	if (cache->dir == NULL) {
+		wlr_log(WLR_DEBUG, "GLES2 program cache disabled");
+		return;
+	}
+
+	if (!mkdir_p(cache->dir)) {
+		wlr_log_errno(WLR_ERROR, "Failed to create GLES2 program cache "
+			"directory '%s'", cache->dir);
+		free(cache->dir);
+		cache->dir = NULL;
+		return;
+	}
+
+	// Program binaries are only valid for the driver which produced them
+	uint64_t hash = 0xcbf29ce484222325;
+	hash = hash_str(hash, (const char *)glGetString(GL_VENDOR));
+	hash = hash_str(hash, (const char *)glGetString(GL_RENDERER));
+	hash = hash_str(hash, (const char *)glGetString(GL_VERSION));
+	cache->driver_hash = hash;
+
+	wlr_log(WLR_DEBUG, "Using GLES2 program cache in '%s'", cache->dir);
+}
+
+void gles2_program_cache_finish(struct wlr_gles2_program_cache *cache) {
+	free(cache->dir);
+	cache->dir = NULL;
+}
+
+static uint64_t get_program_hash(struct wlr_gles2_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	uint64_t hash = hash_str(cache->driver_hash, vert_src);
+	return hash_str(hash, frag_src);
+}
+
+static char *get_program_path(struct wlr_gles2_program_cache *cache,
+		uint64_t hash) {
+	size_t len = strlen(cache->dir) + 22;
+	char *path = malloc(len);
+	if (path == NULL) {
+		return NULL;
+	}
+	snprintf(path, len, "%s/%016"PRIx64".bin", cache->dir, hash);
+	return path;
+}
+
+GLuint gles2_program_cache_load(struct wlr_gles2_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	if (cache->dir == NULL) {
+		return 0;
+	}
+
+	uint64_t hash = get_program_hash(cache, vert_src, frag_src);
+	char *path = get_program_path(cache, hash);
+	if (path == NULL) {
+		return 0;
+	}
+
+	GLuint prog = 0;
+	void *data = NULL;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		goto out;
+	}
+
+	// The entry may have been truncated or tampered with, don't trust the
+	// length it claims
+	struct stat st;
+	struct program_header header;
+	if (fstat(fd, &st) != 0 ||
+			read(fd, &header, sizeof(header)) != sizeof(header) ||
+			memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 ||
+			header.hash != hash || header.length == 0 ||
+			(uint64_t)st.st_size != sizeof(header) + (uint64_t)header.length) {
+		wlr_log(WLR_DEBUG, "Ignoring invalid program cache entry '%s'", path);
+		goto out;
+	}
+
+	data = malloc(header.length);
+	if (data == NULL ||
+			read(fd, data, header.length) != (ssize_t)header.length) {
+		goto out;
+	}
+
+	PUSH_GLES2_DEBUG;
+	prog = glCreateProgram();
+	gles2_procs.glProgramBinaryOES(prog, header.format, data, header.length);
+	GLint ok;
+	glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+	if (ok == GL_FALSE) {
+		// Most likely the driver was updated without changing its version
+		// string, the caller will overwrite the entry
+		wlr_log(WLR_DEBUG, "Driver rejected program cache entry '%s'", path);
+		glDeleteProgram(prog);
+		prog = 0;
+	}
+	POP_GLES2_DEBUG;
+
+out:
+	if (fd >= 0) {
+		close(fd);
+	}
+	free(data);
+	free(path);
+	return prog;
+}
+
+void gles2_program_cache_store(struct wlr_gles2_program_cache *cache,
+		const GLchar *vert_src, const GLchar *frag_src, GLuint prog) {
+	if (cache->dir == NULL) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0) {
+		return;
+	}
+
+	struct program_header header = {
+		.hash = get_program_hash(cache, vert_src, frag_src),
+		.length = length,
+	};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+
+	void *data = malloc(length);
+	char *path = get_program_path(cache, header.hash);
+	char *tmp_path = NULL;
+	int fd = -1;
+	if (data == NULL || path == NULL) {
+		goto out;
+	}
+
+	GLenum format;
+	GLsizei written = 0;
+	gles2_procs.glGetProgramBinaryOES(prog, length, &written, &format, data);
+	if (written != length) {
+		goto out;
+	}
+	header.format = format;
+
+	// Write to a temporary file first, so that concurrent compositors never
+	// read a partial entry
+	size_t tmp_len = strlen(path) + 8;
+	tmp_path = malloc(tmp_len);
+	if (tmp_path == NULL) {
+		goto out;
+	}
+	snprintf(tmp_path, tmp_len, "%s.XXXXXX", path);
+	fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to create '%s'", tmp_path);
+		goto out;
+	}
+
+	if (write(fd, &header, sizeof(header)) != sizeof(header) ||
+			write(fd, data, length) != length ||
+			rename(tmp_path, path) != 0) {
+		wlr_log_errno(WLR_DEBUG, "Failed to write program cache entry '%s'",
+			path);
+		unlink(tmp_path);
+	}
+
+out:
+	if (fd >= 0) {
+		close(fd);
+	}
+	free(tmp_path);
+	free(path);
+	free(data);
+}
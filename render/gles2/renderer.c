@@ -13,6 +13,12 @@
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/util/log.h>
 #include "render/gles2.h"
+#include "util/trace.h"
+
+// Texture atlas defaults, see atlas.c
+#define ATLAS_PAGE_SIZE 2048
+#define ATLAS_MAX_PAGES 4
+#define ATLAS_MAX_ENTRY_SIZE 256
 
 static const GLfloat verts[] = {
 	1, 0, // top right
@@ -25,6 +31,12 @@ struct wlr_gles2_procs gles2_procs = {0};
 
 static const struct wlr_renderer_impl renderer_impl;
 
+static bool init_ellipse_shader(struct wlr_gles2_renderer *renderer);
+static bool init_tex_ext_shader(struct wlr_gles2_renderer *renderer);
+
+// Renderer between gles2_begin and gles2_end on this thread, if any
+static _Thread_local struct wlr_gles2_renderer *current_renderer = NULL;
+
 static struct wlr_gles2_renderer *gles2_get_renderer(
 		struct wlr_renderer *wlr_renderer) {
 	assert(wlr_renderer->impl == &renderer_impl);
@@ -43,11 +55,14 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	TRACE_BEGIN("gles2_render");
+
 	PUSH_GLES2_DEBUG;
 
 	glViewport(0, 0, width, height);
 	renderer->viewport_width = width;
 	renderer->viewport_height = height;
+	renderer->batch.scissor = false;
 
 	// enable transparency
 	glEnable(GL_BLEND);
@@ -57,20 +72,56 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 	// for users to sling matricies themselves
 
 	POP_GLES2_DEBUG;
+
+	current_renderer = renderer;
 }
 
 static void gles2_end(struct wlr_renderer *wlr_renderer) {
-	gles2_get_renderer_in_context(wlr_renderer);
-	// no-op
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	gles2_batch_flush(renderer);
+	current_renderer = NULL;
+
+	TRACE_END("gles2_render");
+}
+
+void gles2_flush_current_batch(void) {
+	if (current_renderer != NULL) {
+		gles2_batch_flush(current_renderer);
+	}
+}
+
+/**
+ * Enables GL_SCISSOR_TEST if a scissor rectangle is set. Used by operations
+ * which don't go through the batch, after flushing it.
+ */
+static void gles2_begin_scissor(struct wlr_gles2_renderer *renderer) {
+	if (renderer->batch.scissor) {
+		struct wlr_box *box = &renderer->batch.scissor_box;
+		glScissor(box->x, box->y, box->width, box->height);
+		glEnable(GL_SCISSOR_TEST);
+	}
+}
+
+static void gles2_end_scissor(struct wlr_gles2_renderer *renderer) {
+	if (renderer->batch.scissor) {
+		glDisable(GL_SCISSOR_TEST);
+	}
 }
 
 static void gles2_clear(struct wlr_renderer *wlr_renderer,
 		const float color[static 4]) {
-	gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	gles2_batch_flush(renderer);
 
 	PUSH_GLES2_DEBUG;
+	gles2_begin_scissor(renderer);
 	glClearColor(color[0], color[1], color[2], color[3]);
 	glClear(GL_COLOR_BUFFER_BIT);
+	gles2_end_scissor(renderer);
 	POP_GLES2_DEBUG;
 }
 
@@ -78,19 +129,29 @@ static void gles2_scissor(struct wlr_renderer *wlr_renderer,
 		struct wlr_box *box) {
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_batch *batch = &renderer->batch;
 
-	PUSH_GLES2_DEBUG;
-	if (box != NULL) {
-		struct wlr_box gl_box;
-		wlr_box_transform(&gl_box, box, WL_OUTPUT_TRANSFORM_FLIPPED_180,
-			renderer->viewport_width, renderer->viewport_height);
-
-		glScissor(gl_box.x, gl_box.y, gl_box.width, gl_box.height);
-		glEnable(GL_SCISSOR_TEST);
-	} else {
-		glDisable(GL_SCISSOR_TEST);
+	// The scissor rectangle is applied by clipping recorded geometry, so
+	// changing it doesn't require flushing the batch
+	if (box == NULL) {
+		batch->scissor = false;
+		return;
 	}
-	POP_GLES2_DEBUG;
+
+	struct wlr_box gl_box;
+	wlr_box_transform(&gl_box, box, WL_OUTPUT_TRANSFORM_FLIPPED_180,
+		renderer->viewport_width, renderer->viewport_height);
+
+	batch->scissor = true;
+	batch->scissor_box = gl_box;
+	batch->scissor_x1 =
+		2.0f * gl_box.x / renderer->viewport_width - 1.0f;
+	batch->scissor_y1 =
+		2.0f * gl_box.y / renderer->viewport_height - 1.0f;
+	batch->scissor_x2 =
+		2.0f * (gl_box.x + gl_box.width) / renderer->viewport_width - 1.0f;
+	batch->scissor_y2 =
+		2.0f * (gl_box.y + gl_box.height) / renderer->viewport_height - 1.0f;
 }
 
 static bool gles2_render_subtexture_with_matrix(
@@ -102,6 +163,13 @@ static bool gles2_render_subtexture_with_matrix(
 	struct wlr_gles2_texture *texture =
 		gles2_get_texture(wlr_texture);
 
+	// Atlas pages are managed by the thread of the texture's renderer
+	if (texture->egl != renderer->egl && texture->atlas.page != NULL) {
+		wlr_log(WLR_ERROR, "Failed to render texture: texture is part of "
+			"another renderer's atlas");
+		return false;
+	}
+
 	struct wlr_gles2_tex_shader *shader = NULL;
 
 	switch (texture->target) {
@@ -120,55 +188,18 @@ static bool gles2_render_subtexture_with_matrix(
 				"GL_TEXTURE_EXTERNAL_OES not supported");
 			return false;
 		}
+		if (!shader->program && !init_tex_ext_shader(renderer)) {
+			wlr_log(WLR_ERROR, "Failed to render texture: "
+				"failed to compile external texture shader");
+			return false;
+		}
 		break;
 	default:
 		abort();
 	}
 
-	// OpenGL ES 2 requires the glUniformMatrix3fv transpose parameter to be set
-	// to GL_FALSE
-	float transposition[9];
-	wlr_matrix_transpose(transposition, matrix);
-
-	PUSH_GLES2_DEBUG;
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
-
-	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-	glUseProgram(shader->program);
-
-	glUniformMatrix3fv(shader->proj, 1, GL_FALSE, transposition);
-	glUniform1i(shader->invert_y, texture->inverted_y);
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
-
-	const GLfloat x1 = box->x / wlr_texture->width;
-	const GLfloat y1 = box->y / wlr_texture->height;
-	const GLfloat x2 = (box->x + box->width) / wlr_texture->width;
-	const GLfloat y2 = (box->y + box->height) / wlr_texture->height;
-	const GLfloat texcoord[] = {
-		x2, y1, // top right
-		x1, y1, // top left
-		x2, y2, // bottom right
-		x1, y2, // bottom left
-	};
-
-	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-	glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, texcoord);
-
-	glEnableVertexAttribArray(shader->pos_attrib);
-	glEnableVertexAttribArray(shader->tex_attrib);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	glDisableVertexAttribArray(shader->pos_attrib);
-	glDisableVertexAttribArray(shader->tex_attrib);
-
-	glBindTexture(texture->target, 0);
-
-	POP_GLES2_DEBUG;
+	gles2_batch_add_quad(renderer, shader, texture, box,
+		(float[4]){ 0 }, alpha, matrix);
 	return true;
 }
 
@@ -177,27 +208,7 @@ static void gles2_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
-	// OpenGL ES 2 requires the glUniformMatrix3fv transpose parameter to be set
-	// to GL_FALSE
-	float transposition[9];
-	wlr_matrix_transpose(transposition, matrix);
-
-	PUSH_GLES2_DEBUG;
-	glUseProgram(renderer->shaders.quad.program);
-
-	glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE, transposition);
-	glUniform4f(renderer->shaders.quad.color, color[0], color[1], color[2], color[3]);
-
-	glVertexAttribPointer(renderer->shaders.quad.pos_attrib, 2, GL_FLOAT, GL_FALSE,
-			0, verts);
-
-	glEnableVertexAttribArray(renderer->shaders.quad.pos_attrib);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	glDisableVertexAttribArray(renderer->shaders.quad.pos_attrib);
-
-	POP_GLES2_DEBUG;
+	gles2_batch_add_quad(renderer, NULL, NULL, NULL, color, 1.0f, matrix);
 }
 
 static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
@@ -205,6 +216,12 @@ static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	if (!renderer->shaders.ellipse.program && !init_ellipse_shader(renderer)) {
+		wlr_log(WLR_ERROR, "Failed to render ellipse: "
+			"failed to compile ellipse shader");
+		return;
+	}
+
 	// OpenGL ES 2 requires the glUniformMatrix3fv transpose parameter to be set
 	// to GL_FALSE
 	float transposition[9];
@@ -217,7 +234,10 @@ static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
 		0, 1, // bottom left
 	};
 
+	gles2_batch_flush(renderer);
+
 	PUSH_GLES2_DEBUG;
+	gles2_begin_scissor(renderer);
 	glUseProgram(renderer->shaders.ellipse.program);
 
 	glUniformMatrix3fv(renderer->shaders.ellipse.proj, 1, GL_FALSE, transposition);
@@ -235,6 +255,7 @@ static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
 
 	glDisableVertexAttribArray(renderer->shaders.ellipse.pos_attrib);
 	glDisableVertexAttribArray(renderer->shaders.ellipse.tex_attrib);
+	gles2_end_scissor(renderer);
 	POP_GLES2_DEBUG;
 }
 
@@ -328,6 +349,8 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 		return false;
 	}
 
+	gles2_batch_flush(renderer);
+
 	PUSH_GLES2_DEBUG;
 
 	// Make sure any pending drawing is finished before we try to read it
@@ -360,6 +383,64 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 	return glGetError() == GL_NO_ERROR;
 }
 
+static bool gles2_read_pixels_to_dmabuf(struct wlr_renderer *wlr_renderer,
+		struct wlr_dmabuf_attributes *dst, uint32_t *flags,
+		uint32_t src_x, uint32_t src_y, int *fence_fd) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	if (!gles2_procs.glEGLImageTargetTexture2DOES) {
+		return false;
+	}
+
+	bool external_only = false;
+	EGLImageKHR image = wlr_egl_create_image_from_dmabuf(renderer->egl, dst,
+		&external_only);
+	if (image == EGL_NO_IMAGE_KHR) {
+		return false;
+	}
+	if (external_only) {
+		// Can't be bound to a GL_TEXTURE_2D
+		wlr_egl_destroy_image(renderer->egl, image);
+		return false;
+	}
+
+	gles2_batch_flush(renderer);
+
+	PUSH_GLES2_DEBUG;
+
+	glGetError(); // Clear the error flag
+
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	gles2_procs.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+	// Copies from the framebuffer currently bound, bottom row first
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, src_x,
+		renderer->viewport_height - dst->height - src_y,
+		dst->width, dst->height);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glDeleteTextures(1, &tex);
+
+	bool ok = glGetError() == GL_NO_ERROR;
+
+	POP_GLES2_DEBUG;
+
+	int fd = -1;
+	if (ok && fence_fd != NULL) {
+		fd = wlr_egl_dup_fence_fd(renderer->egl);
+		*fence_fd = fd;
+	}
+	if (fd < 0) {
+		glFinish();
+	}
+
+	wlr_egl_destroy_image(renderer->egl, image);
+
+	*flags = WLR_RENDERER_READ_PIXELS_Y_INVERT;
+	return ok;
+}
+
 static bool gles2_blit_dmabuf(struct wlr_renderer *wlr_renderer,
 		struct wlr_dmabuf_attributes *dst_attr,
 		struct wlr_dmabuf_attributes *src_attr) {
@@ -446,8 +527,8 @@ static struct wlr_texture *gles2_texture_from_pixels(
 		struct wlr_renderer *wlr_renderer, enum wl_shm_format wl_fmt,
 		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
-	return wlr_gles2_texture_from_pixels(renderer->egl, wl_fmt, stride, width,
-		height, data);
+	return gles2_texture_create_from_pixels(renderer->egl, &renderer->atlas,
+		wl_fmt, stride, width, height, data);
 }
 
 static struct wlr_texture *gles2_texture_from_wl_drm(
@@ -488,6 +569,16 @@ static bool gles2_init_wl_display(struct wlr_renderer *wlr_renderer,
 	return true;
 }
 
+void wlr_gles2_renderer_flush(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	gles2_batch_flush(renderer);
+}
+
+bool wlr_renderer_is_gles2(struct wlr_renderer *wlr_renderer) {
+	return wlr_renderer->impl == &renderer_impl;
+}
+
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer(wlr_renderer);
@@ -505,6 +596,8 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
 	glDeleteProgram(renderer->shaders.tex_rgbx.program);
 	glDeleteProgram(renderer->shaders.tex_ext.program);
+	glDeleteBuffers(1, &renderer->batch.vbo);
+	gles2_atlas_finish(&renderer->atlas);
 	POP_GLES2_DEBUG;
 
 	if (renderer->exts.debug_khr) {
@@ -514,6 +607,8 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 
 	wlr_egl_unset_current(renderer->egl);
 
+	gles2_batch_finish(&renderer->batch);
+	gles2_program_cache_finish(&renderer->program_cache);
 	free(renderer);
 }
 
@@ -538,6 +633,7 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.texture_from_dmabuf = gles2_texture_from_dmabuf,
 	.init_wl_display = gles2_init_wl_display,
 	.blit_dmabuf = gles2_blit_dmabuf,
+	.read_pixels_to_dmabuf = gles2_read_pixels_to_dmabuf,
 };
 
 void push_gles2_marker(const char *file, const char *func) {
@@ -595,7 +691,14 @@ static GLuint compile_shader(GLuint type, const GLchar *src) {
 	return shader;
 }
 
-static GLuint link_program(const GLchar *vert_src, const GLchar *frag_src) {
+static GLuint link_program(struct wlr_gles2_renderer *renderer,
+		const GLchar *vert_src, const GLchar *frag_src) {
+	GLuint prog = gles2_program_cache_load(&renderer->program_cache,
+		vert_src, frag_src);
+	if (prog) {
+		return prog;
+	}
+
 	PUSH_GLES2_DEBUG;
 
 	GLuint vert = compile_shader(GL_VERTEX_SHADER, vert_src);
@@ -609,7 +712,7 @@ static GLuint link_program(const GLchar *vert_src, const GLchar *frag_src) {
 		goto error;
 	}
 
-	GLuint prog = glCreateProgram();
+	prog = glCreateProgram();
 	glAttachShader(prog, vert);
 	glAttachShader(prog, frag);
 	glLinkProgram(prog);
@@ -626,6 +729,9 @@ static GLuint link_program(const GLchar *vert_src, const GLchar *frag_src) {
 		goto error;
 	}
 
+	gles2_program_cache_store(&renderer->program_cache, vert_src, frag_src,
+		prog);
+
 	POP_GLES2_DEBUG;
 	return prog;
 
@@ -669,6 +775,45 @@ extern const GLchar tex_fragment_src_rgba[];
 extern const GLchar tex_fragment_src_rgbx[];
 extern const GLchar tex_fragment_src_external[];
 
+static bool init_tex_shader(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_tex_shader *shader, const GLchar *frag_src) {
+	GLuint prog = link_program(renderer, tex_vertex_src, frag_src);
+	if (!prog) {
+		return false;
+	}
+	shader->program = prog;
+	shader->proj = glGetUniformLocation(prog, "proj");
+	shader->invert_y = glGetUniformLocation(prog, "invert_y");
+	shader->tex = glGetUniformLocation(prog, "tex");
+	shader->alpha = glGetUniformLocation(prog, "alpha");
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->tex_attrib = glGetAttribLocation(prog, "texcoord");
+	return true;
+}
+
+static bool init_tex_ext_shader(struct wlr_gles2_renderer *renderer) {
+	PUSH_GLES2_DEBUG;
+	bool ok = init_tex_shader(renderer, &renderer->shaders.tex_ext,
+		tex_fragment_src_external);
+	POP_GLES2_DEBUG;
+	return ok;
+}
+
+static bool init_ellipse_shader(struct wlr_gles2_renderer *renderer) {
+	PUSH_GLES2_DEBUG;
+	GLuint prog = link_program(renderer, quad_vertex_src, ellipse_fragment_src);
+	if (prog) {
+		renderer->shaders.ellipse.program = prog;
+		renderer->shaders.ellipse.proj = glGetUniformLocation(prog, "proj");
+		renderer->shaders.ellipse.color = glGetUniformLocation(prog, "color");
+		renderer->shaders.ellipse.pos_attrib = glGetAttribLocation(prog, "pos");
+		renderer->shaders.ellipse.tex_attrib =
+			glGetAttribLocation(prog, "texcoord");
+	}
+	POP_GLES2_DEBUG;
+	return prog != 0;
+}
+
 struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	if (!wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL)) {
 		return NULL;
@@ -724,6 +869,23 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			"glEGLImageTargetRenderbufferStorageOES");
 	}
 
+	if (check_gl_ext(exts_str, "GL_OES_get_program_binary")) {
+		GLint formats_len = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats_len);
+		// Some drivers advertise the extension without any binary format
+		if (formats_len > 0) {
+			renderer->exts.get_program_binary_oes = true;
+			load_gl_proc(&gles2_procs.glGetProgramBinaryOES,
+				"glGetProgramBinaryOES");
+			load_gl_proc(&gles2_procs.glProgramBinaryOES,
+				"glProgramBinaryOES");
+		}
+	}
+
+	if (renderer->exts.get_program_binary_oes) {
+		gles2_program_cache_init(&renderer->program_cache);
+	}
+
 	if (renderer->exts.debug_khr) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -738,9 +900,10 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 
 	PUSH_GLES2_DEBUG;
 
+	// The ellipse and external texture shaders are compiled on first use
 	GLuint prog;
 	renderer->shaders.quad.program = prog =
-		link_program(quad_vertex_src, quad_fragment_src);
+		link_program(renderer, quad_vertex_src, quad_fragment_src);
 	if (!renderer->shaders.quad.program) {
 		goto error;
 	}
@@ -748,56 +911,49 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	renderer->shaders.quad.color = glGetUniformLocation(prog, "color");
 	renderer->shaders.quad.pos_attrib = glGetAttribLocation(prog, "pos");
 
-	renderer->shaders.ellipse.program = prog =
-		link_program(quad_vertex_src, ellipse_fragment_src);
-	if (!renderer->shaders.ellipse.program) {
+	if (!init_tex_shader(renderer, &renderer->shaders.tex_rgba,
+			tex_fragment_src_rgba)) {
 		goto error;
 	}
-	renderer->shaders.ellipse.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.ellipse.color = glGetUniformLocation(prog, "color");
-	renderer->shaders.ellipse.pos_attrib = glGetAttribLocation(prog, "pos");
-	renderer->shaders.ellipse.tex_attrib = glGetAttribLocation(prog, "texcoord");
-
-	renderer->shaders.tex_rgba.program = prog =
-		link_program(tex_vertex_src, tex_fragment_src_rgba);
-	if (!renderer->shaders.tex_rgba.program) {
+	if (!init_tex_shader(renderer, &renderer->shaders.tex_rgbx,
+			tex_fragment_src_rgbx)) {
 		goto error;
 	}
-	renderer->shaders.tex_rgba.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgba.invert_y = glGetUniformLocation(prog, "invert_y");
-	renderer->shaders.tex_rgba.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgba.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgba.pos_attrib = glGetAttribLocation(prog, "pos");
-	renderer->shaders.tex_rgba.tex_attrib = glGetAttribLocation(prog, "texcoord");
 
-	renderer->shaders.tex_rgbx.program = prog =
-		link_program(tex_vertex_src, tex_fragment_src_rgbx);
-	if (!renderer->shaders.tex_rgbx.program) {
-		goto error;
-	}
-	renderer->shaders.tex_rgbx.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgbx.invert_y = glGetUniformLocation(prog, "invert_y");
-	renderer->shaders.tex_rgbx.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgbx.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgbx.pos_attrib = glGetAttribLocation(prog, "pos");
-	renderer->shaders.tex_rgbx.tex_attrib = glGetAttribLocation(prog, "texcoord");
-
-	if (renderer->exts.egl_image_external_oes) {
-		renderer->shaders.tex_ext.program = prog =
-			link_program(tex_vertex_src, tex_fragment_src_external);
-		if (!renderer->shaders.tex_ext.program) {
-			goto error;
-		}
-		renderer->shaders.tex_ext.proj = glGetUniformLocation(prog, "proj");
-		renderer->shaders.tex_ext.invert_y = glGetUniformLocation(prog, "invert_y");
-		renderer->shaders.tex_ext.tex = glGetUniformLocation(prog, "tex");
-		renderer->shaders.tex_ext.alpha = glGetUniformLocation(prog, "alpha");
-		renderer->shaders.tex_ext.pos_attrib = glGetAttribLocation(prog, "pos");
-		renderer->shaders.tex_ext.tex_attrib = glGetAttribLocation(prog, "texcoord");
-	}
+	glGenBuffers(1, &renderer->batch.vbo);
 
 	POP_GLES2_DEBUG;
 
+	gles2_batch_init(&renderer->batch);
+	const char *no_batching = getenv("WLR_GLES2_NO_BATCHING");
+	if (no_batching && strcmp(no_batching, "1") == 0) {
+		wlr_log(WLR_DEBUG, "WLR_GLES2_NO_BATCHING set, disabling draw batching");
+	} else {
+		renderer->batch.enabled = true;
+	}
+
+	gles2_atlas_init(&renderer->atlas);
+	GLint max_texture_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	renderer->atlas.page_size = max_texture_size < ATLAS_PAGE_SIZE ?
+		max_texture_size : ATLAS_PAGE_SIZE;
+	renderer->atlas.max_pages = ATLAS_MAX_PAGES;
+	renderer->atlas.max_entry_size = ATLAS_MAX_ENTRY_SIZE;
+	const char *atlas_max_size = getenv("WLR_GLES2_ATLAS_MAX_SIZE");
+	if (atlas_max_size != NULL) {
+		char *end;
+		long size = strtol(atlas_max_size, &end, 10);
+		if (*end != '\0' || size < 0) {
+			wlr_log(WLR_ERROR, "Invalid WLR_GLES2_ATLAS_MAX_SIZE, ignoring");
+		} else {
+			renderer->atlas.max_entry_size = size;
+		}
+	}
+	// Leave room for the entry border
+	if (renderer->atlas.max_entry_size > renderer->atlas.page_size / 2) {
+		renderer->atlas.max_entry_size = renderer->atlas.page_size / 2;
+	}
+
 	wlr_egl_unset_current(renderer->egl);
 
 	return &renderer->wlr_renderer;
@@ -818,6 +974,7 @@ error:
 
 	wlr_egl_unset_current(renderer->egl);
 
+	gles2_program_cache_finish(&renderer->program_cache);
 	free(renderer);
 	return NULL;
 }
@@ -55,6 +55,16 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 		get_gles2_format_from_wl(texture->wl_format);
 	assert(fmt);
 
+	// Pending draw calls must sample the old contents
+	gles2_flush_current_batch();
+
+	if (texture->atlas.page != NULL) {
+		gles2_atlas_write_pixels(texture, fmt, stride, width, height,
+			src_x, src_y, dst_x, dst_y, data);
+		wlr_egl_unset_current(texture->egl);
+		return true;
+	}
+
 	// TODO: what if the unpack subimage extension isn't supported?
 	PUSH_GLES2_DEBUG;
 
@@ -79,10 +89,40 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	return true;
 }
 
+bool gles2_texture_leave_atlas(struct wlr_gles2_texture *texture) {
+	if (texture->atlas.page == NULL) {
+		return true;
+	}
+
+	// This may be called while rendering to an output, keep its surface
+	struct wlr_egl_context saved_context;
+	wlr_egl_save_context(&saved_context);
+	bool switched = !wlr_egl_is_current(texture->egl);
+	if (switched &&
+			!wlr_egl_make_current(texture->egl, EGL_NO_SURFACE, NULL)) {
+		return false;
+	}
+
+	bool ok = gles2_atlas_evict(texture);
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to move texture out of atlas");
+	}
+
+	if (switched) {
+		wlr_egl_restore_context(&saved_context);
+	}
+	return ok;
+}
+
 static bool gles2_texture_to_dmabuf(struct wlr_texture *wlr_texture,
 		struct wlr_dmabuf_attributes *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
 
+	// Only whole textures can be exported
+	if (!gles2_texture_leave_atlas(texture)) {
+		return false;
+	}
+
 	if (!texture->image) {
 		assert(texture->target == GL_TEXTURE_2D);
 
@@ -115,9 +155,16 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 	struct wlr_gles2_texture *texture =
 		get_gles2_texture_in_context(wlr_texture);
 
+	// Pending draw calls may still reference this texture
+	gles2_flush_current_batch();
+
 	PUSH_GLES2_DEBUG;
 
-	glDeleteTextures(1, &texture->tex);
+	if (texture->atlas.page != NULL) {
+		gles2_atlas_remove(texture);
+	} else {
+		glDeleteTextures(1, &texture->tex);
+	}
 	wlr_egl_destroy_image(texture->egl, texture->image);
 
 	POP_GLES2_DEBUG;
@@ -134,9 +181,9 @@ static const struct wlr_texture_impl texture_impl = {
 	.destroy = gles2_texture_destroy,
 };
 
-struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
-		enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width,
-		uint32_t height, const void *data) {
+struct wlr_texture *gles2_texture_create_from_pixels(struct wlr_egl *egl,
+		struct wlr_gles2_atlas *atlas, enum wl_shm_format wl_fmt,
+		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
 	wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL);
 
 	const struct wlr_gles2_pixel_format *fmt = get_gles2_format_from_wl(wl_fmt);
@@ -156,6 +203,14 @@ struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
 	texture->target = GL_TEXTURE_2D;
 	texture->has_alpha = fmt->has_alpha;
 	texture->wl_format = fmt->wl_format;
+	wl_list_init(&texture->atlas.link);
+
+	if (atlas != NULL && gles2_atlas_add(atlas, texture, fmt)) {
+		gles2_atlas_write_pixels(texture, fmt, stride, width, height,
+			0, 0, 0, 0, data);
+		wlr_egl_unset_current(egl);
+		return &texture->wlr_texture;
+	}
 
 	PUSH_GLES2_DEBUG;
 
@@ -175,6 +230,32 @@ struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
 	return &texture->wlr_texture;
 }
 
+struct wlr_texture *gles2_texture_create_from_gl(struct wlr_egl *egl,
+		GLuint tex, uint32_t width, uint32_t height, bool inverted_y) {
+	struct wlr_gles2_texture *texture =
+		calloc(1, sizeof(struct wlr_gles2_texture));
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_init(&texture->wlr_texture, &texture_impl, width, height);
+	texture->egl = egl;
+	texture->target = GL_TEXTURE_2D;
+	texture->tex = tex;
+	texture->inverted_y = inverted_y;
+	texture->has_alpha = true;
+	texture->wl_format = WL_SHM_FORMAT_ABGR8888;
+	wl_list_init(&texture->atlas.link);
+	return &texture->wlr_texture;
+}
+
+struct wlr_texture *wlr_gles2_texture_from_pixels(struct wlr_egl *egl,
+		enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width,
+		uint32_t height, const void *data) {
+	return gles2_texture_create_from_pixels(egl, NULL, wl_fmt, stride,
+		width, height, data);
+}
+
 struct wlr_texture *wlr_gles2_texture_from_wl_drm(struct wlr_egl *egl,
 		struct wl_resource *resource) {
 	wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL);
@@ -305,6 +386,8 @@ struct wlr_texture *wlr_gles2_texture_from_dmabuf(struct wlr_egl *egl,
 void wlr_gles2_texture_get_attribs(struct wlr_texture *wlr_texture,
 		struct wlr_gles2_texture_attribs *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	// Callers may sample the whole GL texture
+	gles2_texture_leave_atlas(texture);
 	memset(attribs, 0, sizeof(*attribs));
 	attribs->target = texture->target;
 	attribs->tex = texture->tex;
@@ -179,6 +179,16 @@ bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 	return r->impl->blit_dmabuf(r, dst, src);
 }
 
+bool wlr_renderer_read_pixels_to_dmabuf(struct wlr_renderer *r,
+		struct wlr_dmabuf_attributes *dst, uint32_t *flags,
+		uint32_t src_x, uint32_t src_y, int *fence_fd) {
+	if (!r->impl->read_pixels_to_dmabuf) {
+		return false;
+	}
+	return r->impl->read_pixels_to_dmabuf(r, dst, flags, src_x, src_y,
+		fence_fd);
+}
+
 bool wlr_renderer_format_supported(struct wlr_renderer *r,
 		enum wl_shm_format fmt) {
 	return r->impl->format_supported(r, fmt);
@@ -0,0 +1,337 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <GLES2/gl2.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/gles2.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/worker.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+#include "util/thread.h"
+
+struct wlr_render_worker {
+	struct wlr_egl *parent_egl;
+	struct wlr_egl egl; // shared with the parent
+	struct wlr_renderer *renderer; // only used on the worker thread
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	// Protected by the lock
+	struct wl_list pending; // wlr_render_job::link
+	struct wl_list finished; // wlr_render_job::link
+	bool started, stopping;
+
+	int wake_main_fd;
+	struct wl_event_source *wake_main_event;
+};
+
+static void job_destroy_sync(struct wlr_render_worker *worker,
+		struct wlr_render_job *job) {
+	if (job->sync != EGL_NO_SYNC_KHR) {
+		worker->egl.procs.eglDestroySyncKHR(worker->egl.display, job->sync);
+		job->sync = EGL_NO_SYNC_KHR;
+	}
+}
+
+/**
+ * Makes sure that the writes submitted so far by the parent context, e.g.
+ * texture uploads, are visible to the worker context. Must be called on the
+ * main thread.
+ */
+static void job_sync_parent(struct wlr_render_worker *worker,
+		struct wlr_render_job *job) {
+	struct wlr_egl *egl = worker->parent_egl;
+
+	job->sync = EGL_NO_SYNC_KHR;
+
+	struct wlr_egl_context saved_context;
+	wlr_egl_save_context(&saved_context);
+	bool switched = !wlr_egl_is_current(egl);
+	if (switched && !wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL)) {
+		return;
+	}
+
+	if (egl->exts.fence_sync_khr) {
+		job->sync = egl->procs.eglCreateSyncKHR(egl->display,
+			EGL_SYNC_FENCE_KHR, NULL);
+		if (job->sync == EGL_NO_SYNC_KHR) {
+			wlr_log(WLR_ERROR, "eglCreateSyncKHR failed");
+		}
+	}
+	if (job->sync != EGL_NO_SYNC_KHR) {
+		// Other contexts can only wait for fences which have been flushed
+		glFlush();
+	} else {
+		glFinish();
+	}
+
+	if (switched) {
+		wlr_egl_restore_context(&saved_context);
+	}
+}
+
+static struct wlr_texture *worker_render_job(struct wlr_render_worker *worker,
+		struct wlr_render_job *job) {
+	if (!wlr_egl_make_current(&worker->egl, EGL_NO_SURFACE, NULL)) {
+		job_destroy_sync(worker, job);
+		return NULL;
+	}
+
+	if (job->sync != EGL_NO_SYNC_KHR) {
+		if (worker->egl.exts.wait_sync_khr) {
+			// Only makes the GPU wait, the worker thread doesn't block
+			worker->egl.procs.eglWaitSyncKHR(worker->egl.display, job->sync, 0);
+		} else {
+			worker->egl.procs.eglClientWaitSyncKHR(worker->egl.display,
+				job->sync, 0, EGL_FOREVER_KHR);
+		}
+		job_destroy_sync(worker, job);
+	}
+
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, job->width, job->height, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	GLuint fbo;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_TEXTURE_2D, tex, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		wlr_log(WLR_ERROR, "Failed to create render job framebuffer: 0x%x",
+			status);
+		goto error;
+	}
+
+	wlr_renderer_begin(worker->renderer, job->width, job->height);
+	job->render(job, worker->renderer);
+	wlr_renderer_end(worker->renderer);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+
+	// Other contexts are only guaranteed to see the image once it's complete
+	glFinish();
+	wlr_egl_unset_current(&worker->egl);
+
+	// Wrapping the texture doesn't involve any GL call
+	struct wlr_texture *texture = gles2_texture_create_from_gl(
+		worker->parent_egl, tex, job->width, job->height, true);
+	if (texture == NULL) {
+		wlr_egl_make_current(&worker->egl, EGL_NO_SURFACE, NULL);
+		glDeleteTextures(1, &tex);
+		wlr_egl_unset_current(&worker->egl);
+	}
+	return texture;
+
+error:
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &tex);
+	wlr_egl_unset_current(&worker->egl);
+	return NULL;
+}
+
+static void *worker_run(void *data) {
+	struct wlr_render_worker *worker = data;
+
+	worker->renderer = wlr_gles2_renderer_create(&worker->egl);
+
+	pthread_mutex_lock(&worker->lock);
+	worker->started = true;
+	pthread_cond_broadcast(&worker->cond);
+
+	while (worker->renderer != NULL) {
+		while (!worker->stopping && wl_list_empty(&worker->pending)) {
+			pthread_cond_wait(&worker->cond, &worker->lock);
+		}
+		if (worker->stopping) {
+			break;
+		}
+
+		struct wlr_render_job *job =
+			wl_container_of(worker->pending.next, job, link);
+		wl_list_remove(&job->link);
+		pthread_mutex_unlock(&worker->lock);
+
+		job->texture = worker_render_job(worker, job);
+
+		pthread_mutex_lock(&worker->lock);
+		wl_list_insert(worker->finished.prev, &job->link);
+
+		uint64_t one = 1;
+		if (write(worker->wake_main_fd, &one, sizeof(one)) < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to write to eventfd");
+		}
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	// The context needs to be released by the thread it's current on
+	wlr_renderer_destroy(worker->renderer);
+	wlr_egl_finish(&worker->egl);
+	return NULL;
+}
+
+static void worker_complete_finished(struct wlr_render_worker *worker) {
+	struct wl_list finished;
+	wl_list_init(&finished);
+	pthread_mutex_lock(&worker->lock);
+	wl_list_insert_list(&finished, &worker->finished);
+	wl_list_init(&worker->finished);
+	pthread_mutex_unlock(&worker->lock);
+
+	struct wlr_render_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &finished, link) {
+		wl_list_remove(&job->link);
+		struct wlr_texture *texture = job->texture;
+		job->texture = NULL;
+		job->done(job, texture);
+	}
+}
+
+static int handle_wake_main(int fd, uint32_t mask, void *data) {
+	struct wlr_render_worker *worker = data;
+
+	uint64_t n;
+	if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "Failed to read from eventfd");
+	}
+
+	worker_complete_finished(worker);
+	return 0;
+}
+
+static void worker_destroy(struct wlr_render_worker *worker) {
+	if (worker->wake_main_event != NULL) {
+		wl_event_source_remove(worker->wake_main_event);
+	}
+	if (worker->wake_main_fd >= 0) {
+		close(worker->wake_main_fd);
+	}
+	pthread_cond_destroy(&worker->cond);
+	pthread_mutex_destroy(&worker->lock);
+	free(worker);
+}
+
+struct wlr_render_worker *wlr_render_worker_create(
+		struct wlr_renderer *parent, struct wl_event_loop *loop) {
+	if (!wlr_renderer_is_gles2(parent)) {
+		wlr_log(WLR_ERROR, "Render workers require a GLES2 renderer");
+		return NULL;
+	}
+
+	struct wlr_render_worker *worker = calloc(1, sizeof(*worker));
+	if (worker == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	worker->parent_egl = wlr_gles2_renderer_get_egl(parent);
+	wl_list_init(&worker->pending);
+	wl_list_init(&worker->finished);
+	pthread_mutex_init(&worker->lock, NULL);
+	pthread_cond_init(&worker->cond, NULL);
+
+	worker->wake_main_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (worker->wake_main_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create eventfd");
+		goto error;
+	}
+	worker->wake_main_event = wl_event_loop_add_fd(loop,
+		worker->wake_main_fd, WL_EVENT_READABLE, handle_wake_main, worker);
+	if (worker->wake_main_event == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add render worker to event loop");
+		goto error;
+	}
+
+	if (!wlr_egl_init_shared(&worker->egl, worker->parent_egl)) {
+		goto error;
+	}
+
+	int ret = create_thread_without_signals(&worker->thread, worker_run,
+		worker);
+	if (ret != 0) {
+		wlr_log(WLR_ERROR, "Failed to create render worker thread: %s",
+			strerror(ret));
+		wlr_egl_finish(&worker->egl);
+		goto error;
+	}
+
+	// Creating the renderer loads GL procs shared with the main thread, wait
+	// for it to be done
+	pthread_mutex_lock(&worker->lock);
+	while (!worker->started) {
+		pthread_cond_wait(&worker->cond, &worker->lock);
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	if (worker->renderer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create render worker renderer");
+		pthread_join(worker->thread, NULL);
+		goto error;
+	}
+
+	wlr_log(WLR_DEBUG, "Started render worker thread");
+	return worker;
+
+error:
+	worker_destroy(worker);
+	return NULL;
+}
+
+void wlr_render_worker_destroy(struct wlr_render_worker *worker) {
+	if (worker == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&worker->lock);
+	worker->stopping = true;
+	pthread_cond_broadcast(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+	pthread_join(worker->thread, NULL);
+
+	worker_complete_finished(worker);
+
+	struct wlr_render_job *job, *tmp;
+	wl_list_for_each_safe(job, tmp, &worker->pending, link) {
+		wl_list_remove(&job->link);
+		job_destroy_sync(worker, job);
+		job->done(job, NULL);
+	}
+
+	worker_destroy(worker);
+}
+
+void wlr_render_worker_submit(struct wlr_render_worker *worker,
+		struct wlr_render_job *job) {
+	job->texture = NULL;
+	job_sync_parent(worker, job);
+
+	pthread_mutex_lock(&worker->lock);
+	wl_list_insert(worker->pending.prev, &job->link);
+	pthread_cond_broadcast(&worker->cond);
+	pthread_mutex_unlock(&worker->lock);
+}
+
+bool wlr_render_worker_prepare_texture(struct wlr_render_worker *worker,
+		struct wlr_texture *wlr_texture) {
+	if (!wlr_texture_is_gles2(wlr_texture)) {
+		wlr_log(WLR_ERROR, "Render workers require GLES2 textures");
+		return false;
+	}
+
+	// Atlas pages are rearranged by the main thread when textures are created
+	// or destroyed
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	return gles2_texture_leave_atlas(texture);
+}
@@ -4,7 +4,10 @@
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/util/log.h>
+#include "types/wlr_buffer.h"
+#include "types/wlr_linux_dmabuf_v1.h"
 #include "util/signal.h"
+#include "util/trace.h"
 
 void wlr_buffer_init(struct wlr_buffer *buffer,
 		const struct wlr_buffer_impl *impl, int width, int height) {
@@ -110,7 +113,11 @@ static void client_buffer_destroy(struct wlr_buffer *_buffer) {
 	}
 
 	wl_list_remove(&buffer->resource_destroy.link);
-	wlr_texture_destroy(buffer->texture);
+	if (buffer->dmabuf_texture != NULL) {
+		dmabuf_v1_texture_unlock(buffer->dmabuf_texture);
+	} else {
+		wlr_texture_destroy(buffer->texture);
+	}
 	free(buffer);
 }
 
@@ -170,8 +177,11 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 	assert(wlr_resource_is_buffer(resource));
 
 	struct wlr_texture *texture = NULL;
+	struct wlr_dmabuf_v1_texture *dmabuf_texture = NULL;
 	bool resource_released = false;
 
+	TRACE_BEGIN("client_buffer_import");
+
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
 	if (shm_buf != NULL) {
 		enum wl_shm_format fmt = wl_shm_buffer_get_format(shm_buf);
@@ -194,7 +204,13 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 	} else if (wlr_dmabuf_v1_resource_is_buffer(resource)) {
 		struct wlr_dmabuf_v1_buffer *dmabuf =
 			wlr_dmabuf_v1_buffer_from_buffer_resource(resource);
-		texture = wlr_texture_from_dmabuf(renderer, &dmabuf->attributes);
+		// Re-use the texture imported when the wl_buffer was created
+		dmabuf_texture = dmabuf_v1_buffer_lock_texture(dmabuf, renderer);
+		if (dmabuf_texture != NULL) {
+			texture = dmabuf_v1_texture_get_texture(dmabuf_texture);
+		} else {
+			texture = wlr_texture_from_dmabuf(renderer, &dmabuf->attributes);
+		}
 
 		// We have imported the DMA-BUF, but we need to prevent the client from
 		// re-using the same DMA-BUF for the next frames, so we don't release
@@ -205,9 +221,12 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 		// Instead of just logging the error, also disconnect the client with a
 		// fatal protocol error so that it's clear something went wrong.
 		wl_resource_post_error(resource, 0, "unknown buffer type");
+		TRACE_END("client_buffer_import");
 		return NULL;
 	}
 
+	TRACE_END("client_buffer_import");
+
 	if (texture == NULL) {
 		wlr_log(WLR_ERROR, "Failed to upload texture");
 		wl_buffer_send_release(resource);
@@ -220,13 +239,18 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 	struct wlr_client_buffer *buffer =
 		calloc(1, sizeof(struct wlr_client_buffer));
 	if (buffer == NULL) {
-		wlr_texture_destroy(texture);
+		if (dmabuf_texture != NULL) {
+			dmabuf_v1_texture_unlock(dmabuf_texture);
+		} else {
+			wlr_texture_destroy(texture);
+		}
 		wl_resource_post_no_memory(resource);
 		return NULL;
 	}
 	wlr_buffer_init(&buffer->base, &client_buffer_impl, width, height);
 	buffer->resource = resource;
 	buffer->texture = texture;
+	buffer->dmabuf_texture = dmabuf_texture;
 	buffer->resource_released = resource_released;
 
 	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
@@ -245,26 +269,34 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		struct wlr_client_buffer *buffer, struct wl_resource *resource,
 		pixman_region32_t *damage) {
-	assert(wlr_resource_is_buffer(resource));
-
 	if (buffer->base.n_locks > 1) {
 		// Someone else still has a reference to the buffer
 		return NULL;
 	}
 
+	if (!client_buffer_apply_damage(buffer, resource, damage)) {
+		return NULL;
+	}
+	return buffer;
+}
+
+bool client_buffer_apply_damage(struct wlr_client_buffer *buffer,
+		struct wl_resource *resource, pixman_region32_t *damage) {
+	assert(wlr_resource_is_buffer(resource));
+
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
 	struct wl_shm_buffer *old_shm_buf = wl_shm_buffer_get(buffer->resource);
 	if (shm_buf == NULL || old_shm_buf == NULL) {
 		// Uploading only damaged regions only works for wl_shm buffers and
 		// mutable textures (created from wl_shm buffer)
-		return NULL;
+		return false;
 	}
 
 	enum wl_shm_format new_fmt = wl_shm_buffer_get_format(shm_buf);
 	enum wl_shm_format old_fmt = wl_shm_buffer_get_format(old_shm_buf);
 	if (new_fmt != old_fmt) {
 		// Uploading to textures can't change the format
-		return NULL;
+		return false;
 	}
 
 	int32_t stride = wl_shm_buffer_get_stride(shm_buf);
@@ -274,7 +306,7 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 	int32_t texture_width, texture_height;
 	wlr_texture_get_size(buffer->texture, &texture_width, &texture_height);
 	if (width != texture_width || height != texture_height) {
-		return NULL;
+		return false;
 	}
 
 	wl_shm_buffer_begin_access(shm_buf);
@@ -288,7 +320,7 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
 				r->x1, r->y1, data)) {
 			wl_shm_buffer_end_access(shm_buf);
-			return NULL;
+			return false;
 		}
 	}
 
@@ -304,5 +336,5 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 
 	buffer->resource = resource;
 	buffer->resource_released = true;
-	return buffer;
+	return true;
 }
@@ -0,0 +1,353 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_client_accounting.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+struct client_resource {
+	struct wl_list link; // wlr_client_usage::resources
+	struct wlr_client_usage *usage;
+	enum wlr_client_object_type type;
+	struct wl_listener destroy;
+};
+
+struct client_surface {
+	struct wl_list link; // wlr_client_usage::surfaces
+	struct wlr_client_usage *usage;
+	struct wlr_surface *surface;
+	size_t buffer_bytes;
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+static const struct {
+	const char *interface;
+	enum wlr_client_object_type type;
+} object_types[] = {
+	{ "wl_surface", WLR_CLIENT_OBJECT_SURFACE },
+	{ "wl_subsurface", WLR_CLIENT_OBJECT_SUBSURFACE },
+	{ "wl_region", WLR_CLIENT_OBJECT_REGION },
+	{ "wl_shm_pool", WLR_CLIENT_OBJECT_SHM_POOL },
+	{ "zwp_linux_buffer_params_v1", WLR_CLIENT_OBJECT_DMABUF_PARAMS },
+	{ "wl_buffer", WLR_CLIENT_OBJECT_BUFFER },
+	{ "wl_pointer", WLR_CLIENT_OBJECT_INPUT_DEVICE },
+	{ "wl_keyboard", WLR_CLIENT_OBJECT_INPUT_DEVICE },
+	{ "wl_touch", WLR_CLIENT_OBJECT_INPUT_DEVICE },
+	{ "xdg_surface", WLR_CLIENT_OBJECT_SHELL_SURFACE },
+	{ "zxdg_surface_v6", WLR_CLIENT_OBJECT_SHELL_SURFACE },
+	{ "zwlr_layer_surface_v1", WLR_CLIENT_OBJECT_SHELL_SURFACE },
+	{ "wl_shell_surface", WLR_CLIENT_OBJECT_SHELL_SURFACE },
+};
+
+static enum wlr_client_object_type get_object_type(
+		struct wl_resource *resource) {
+	const char *class = wl_resource_get_class(resource);
+	for (size_t i = 0; i < sizeof(object_types) / sizeof(object_types[0]); i++) {
+		if (strcmp(class, object_types[i].interface) == 0) {
+			return object_types[i].type;
+		}
+	}
+	return WLR_CLIENT_OBJECT_OTHER;
+}
+
+static int64_t get_current_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Emits the limit_exceeded event, and disconnects the client if requested.
+ * Returns false if the client has been disconnected.
+ */
+static bool usage_exceed_limit(struct wlr_client_usage *usage,
+		enum wlr_client_limit limit, enum wlr_client_object_type type) {
+	struct wlr_client_accounting *accounting = usage->accounting;
+
+	struct wlr_client_limit_event event = {
+		.usage = usage,
+		.limit = limit,
+		.object_type = type,
+		.reject = limit != WLR_CLIENT_LIMIT_COMMIT_RATE,
+	};
+	wlr_signal_emit_safe(&accounting->events.limit_exceeded, &event);
+
+	if (!event.reject) {
+		return true;
+	}
+
+	pid_t pid;
+	wl_client_get_credentials(usage->client, &pid, NULL, NULL);
+	wlr_log(WLR_INFO, "Disconnecting client (pid %d): resource limit "
+		"exceeded", (int)pid);
+	// The client is destroyed once the current request has been processed
+	wl_client_post_no_memory(usage->client);
+	return false;
+}
+
+static void client_resource_destroy(struct client_resource *res) {
+	wl_list_remove(&res->link);
+	wl_list_remove(&res->destroy.link);
+	free(res);
+}
+
+static void client_resource_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct client_resource *res = wl_container_of(listener, res, destroy);
+	res->usage->objects[res->type]--;
+	res->usage->total_objects--;
+	client_resource_destroy(res);
+}
+
+static void usage_handle_resource_created(struct wl_listener *listener,
+		void *data) {
+	struct wlr_client_usage *usage =
+		wl_container_of(listener, usage, resource_created);
+	struct wl_resource *resource = data;
+
+	struct client_resource *res = calloc(1, sizeof(*res));
+	if (res == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	res->usage = usage;
+	res->type = get_object_type(resource);
+	res->destroy.notify = client_resource_handle_destroy;
+	wl_resource_add_destroy_listener(resource, &res->destroy);
+	wl_list_insert(&usage->resources, &res->link);
+
+	usage->objects[res->type]++;
+	usage->total_objects++;
+
+	// Only notify when going over a limit, not for each object past it
+	const struct wlr_client_limits *limits = &usage->accounting->limits;
+	size_t type_limit = limits->objects[res->type];
+	if (type_limit != 0 && usage->objects[res->type] == type_limit + 1) {
+		if (!usage_exceed_limit(usage, WLR_CLIENT_LIMIT_OBJECTS, res->type)) {
+			return;
+		}
+	}
+	if (limits->total_objects != 0 &&
+			usage->total_objects == limits->total_objects + 1) {
+		usage_exceed_limit(usage, WLR_CLIENT_LIMIT_TOTAL_OBJECTS, res->type);
+	}
+}
+
+static void client_surface_destroy(struct client_surface *cs) {
+	cs->usage->buffer_bytes -= cs->buffer_bytes;
+	wl_list_remove(&cs->link);
+	wl_list_remove(&cs->commit.link);
+	wl_list_remove(&cs->destroy.link);
+	free(cs);
+}
+
+static void usage_update_commit_rate(struct wlr_client_usage *usage,
+		int64_t now) {
+	int64_t elapsed = now - usage->commits_start_msec;
+	if (elapsed < 1000) {
+		return;
+	}
+	usage->commit_rate = elapsed < 2000 ? usage->commits : 0;
+	usage->commits = 0;
+	usage->commits_start_msec = now;
+	usage->throttled = false;
+}
+
+static void client_surface_handle_commit(struct wl_listener *listener,
+		void *data) {
+	struct client_surface *cs = wl_container_of(listener, cs, commit);
+	struct wlr_client_usage *usage = cs->usage;
+	const struct wlr_client_limits *limits = &usage->accounting->limits;
+
+	size_t bytes = 0;
+	if (cs->surface->buffer != NULL) {
+		// The compositor keeps a texture of the buffer, count it as 32bpp
+		struct wlr_buffer *buffer = &cs->surface->buffer->base;
+		bytes = (size_t)buffer->width * buffer->height * 4;
+	}
+	size_t prev_total = usage->buffer_bytes;
+	usage->buffer_bytes += bytes - cs->buffer_bytes;
+	cs->buffer_bytes = bytes;
+	if (limits->buffer_bytes != 0 && prev_total <= limits->buffer_bytes &&
+			usage->buffer_bytes > limits->buffer_bytes) {
+		if (!usage_exceed_limit(usage, WLR_CLIENT_LIMIT_BUFFER_BYTES,
+				WLR_CLIENT_OBJECT_BUFFER)) {
+			return;
+		}
+	}
+
+	usage_update_commit_rate(usage, get_current_time_msec());
+	usage->commits++;
+	if (limits->commit_rate != 0 && usage->commits == limits->commit_rate + 1) {
+		usage->throttled = true;
+		usage_exceed_limit(usage, WLR_CLIENT_LIMIT_COMMIT_RATE,
+			WLR_CLIENT_OBJECT_SURFACE);
+	}
+}
+
+static void client_surface_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct client_surface *cs = wl_container_of(listener, cs, destroy);
+	client_surface_destroy(cs);
+}
+
+static void usage_destroy(struct wlr_client_usage *usage) {
+	struct client_resource *res, *res_tmp;
+	wl_list_for_each_safe(res, res_tmp, &usage->resources, link) {
+		client_resource_destroy(res);
+	}
+	struct client_surface *cs, *cs_tmp;
+	wl_list_for_each_safe(cs, cs_tmp, &usage->surfaces, link) {
+		client_surface_destroy(cs);
+	}
+	wl_list_remove(&usage->resource_created.link);
+	wl_list_remove(&usage->client_destroy.link);
+	wl_list_remove(&usage->link);
+	free(usage);
+}
+
+static void usage_handle_client_destroy(struct wl_listener *listener,
+		void *data) {
+	// The client's resources are destroyed after this signal
+	struct wlr_client_usage *usage =
+		wl_container_of(listener, usage, client_destroy);
+	usage_destroy(usage);
+}
+
+static void accounting_add_client(struct wlr_client_accounting *accounting,
+		struct wl_client *client) {
+	struct wlr_client_usage *usage = calloc(1, sizeof(*usage));
+	if (usage == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	usage->accounting = accounting;
+	usage->client = client;
+	usage->commits_start_msec = get_current_time_msec();
+	wl_list_init(&usage->resources);
+	wl_list_init(&usage->surfaces);
+
+	usage->client_destroy.notify = usage_handle_client_destroy;
+	wl_client_add_destroy_listener(client, &usage->client_destroy);
+	usage->resource_created.notify = usage_handle_resource_created;
+	wl_client_add_resource_created_listener(client, &usage->resource_created);
+
+	wl_list_insert(&accounting->clients, &usage->link);
+}
+
+static void handle_client_created(struct wl_listener *listener, void *data) {
+	struct wlr_client_accounting *accounting =
+		wl_container_of(listener, accounting, client_created);
+	struct wl_client *client = data;
+	accounting_add_client(accounting, client);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct wlr_client_accounting *accounting =
+		wl_container_of(listener, accounting, new_surface);
+	struct wlr_surface *surface = data;
+
+	struct wlr_client_usage *usage = wlr_client_accounting_get_usage(
+		accounting, wl_resource_get_client(surface->resource));
+	if (usage == NULL) {
+		return;
+	}
+
+	struct client_surface *cs = calloc(1, sizeof(*cs));
+	if (cs == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	cs->usage = usage;
+	cs->surface = surface;
+	cs->commit.notify = client_surface_handle_commit;
+	wl_signal_add(&surface->events.commit, &cs->commit);
+	cs->destroy.notify = client_surface_handle_destroy;
+	wl_signal_add(&surface->events.destroy, &cs->destroy);
+	wl_list_insert(&usage->surfaces, &cs->link);
+}
+
+static void handle_compositor_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_client_accounting *accounting =
+		wl_container_of(listener, accounting, compositor_destroy);
+	wl_list_remove(&accounting->new_surface.link);
+	wl_list_init(&accounting->new_surface.link);
+	wl_list_remove(&accounting->compositor_destroy.link);
+	wl_list_init(&accounting->compositor_destroy.link);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_client_accounting *accounting =
+		wl_container_of(listener, accounting, display_destroy);
+	wlr_signal_emit_safe(&accounting->events.destroy, accounting);
+
+	struct wlr_client_usage *usage, *tmp;
+	wl_list_for_each_safe(usage, tmp, &accounting->clients, link) {
+		usage_destroy(usage);
+	}
+
+	wl_list_remove(&accounting->display_destroy.link);
+	wl_list_remove(&accounting->client_created.link);
+	wl_list_remove(&accounting->new_surface.link);
+	wl_list_remove(&accounting->compositor_destroy.link);
+	free(accounting);
+}
+
+struct wlr_client_accounting *wlr_client_accounting_create(
+		struct wl_display *display, struct wlr_compositor *compositor) {
+	struct wlr_client_accounting *accounting = calloc(1, sizeof(*accounting));
+	if (accounting == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	accounting->display = display;
+	wl_list_init(&accounting->clients);
+	wl_signal_init(&accounting->events.limit_exceeded);
+	wl_signal_init(&accounting->events.destroy);
+
+	accounting->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &accounting->display_destroy);
+	accounting->client_created.notify = handle_client_created;
+	wl_display_add_client_created_listener(display,
+		&accounting->client_created);
+
+	wl_list_init(&accounting->new_surface.link);
+	wl_list_init(&accounting->compositor_destroy.link);
+	if (compositor != NULL) {
+		accounting->new_surface.notify = handle_new_surface;
+		wl_signal_add(&compositor->events.new_surface,
+			&accounting->new_surface);
+		accounting->compositor_destroy.notify = handle_compositor_destroy;
+		wl_signal_add(&compositor->events.destroy,
+			&accounting->compositor_destroy);
+	}
+
+	// Objects created before are unknown, start counting from there
+	struct wl_list *clients = wl_display_get_client_list(display);
+	struct wl_client *client;
+	wl_client_for_each(client, clients) {
+		accounting_add_client(accounting, client);
+	}
+
+	return accounting;
+}
+
+struct wlr_client_usage *wlr_client_accounting_get_usage(
+		struct wlr_client_accounting *accounting, struct wl_client *client) {
+	struct wlr_client_usage *usage;
+	wl_list_for_each(usage, &accounting->clients, link) {
+		if (usage->client == client) {
+			usage_update_commit_rate(usage, get_current_time_msec());
+			return usage;
+		}
+	}
+	return NULL;
+}
@@ -3,6 +3,7 @@
 #include <unistd.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/dmabuf.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_export_dmabuf_v1.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
@@ -30,18 +31,34 @@ static const struct zwlr_export_dmabuf_frame_v1_interface frame_impl = {
 	.destroy = frame_handle_destroy,
 };
 
+/**
+ * Releases the locks the frame holds on its output, once the frame has been
+ * sent or is being destroyed.
+ */
+static void frame_release_output(struct wlr_export_dmabuf_frame_v1 *frame) {
+	if (frame->output == NULL) {
+		return;
+	}
+	wlr_output_lock_attach_render(frame->output, false);
+	if (frame->cursor_locked) {
+		wlr_output_lock_software_cursors(frame->output, false);
+	}
+	wl_list_remove(&frame->output_present.link);
+	wl_list_init(&frame->output_present.link);
+	wl_list_remove(&frame->output_destroy.link);
+	wl_list_init(&frame->output_destroy.link);
+	frame->output = NULL;
+}
+
 static void frame_destroy(struct wlr_export_dmabuf_frame_v1 *frame) {
 	if (frame == NULL) {
 		return;
 	}
-	if (frame->output != NULL) {
-		wlr_output_lock_attach_render(frame->output, false);
-		if (frame->cursor_locked) {
-			wlr_output_lock_software_cursors(frame->output, false);
-		}
-	}
+	frame_release_output(frame);
+	wlr_buffer_unlock(frame->buffer);
 	wl_list_remove(&frame->link);
-	wl_list_remove(&frame->output_precommit.link);
+	wl_list_remove(&frame->output_present.link);
+	wl_list_remove(&frame->output_destroy.link);
 	wlr_dmabuf_attributes_finish(&frame->attribs);
 	// Make the frame resource inert
 	wl_resource_set_user_data(frame->resource, NULL);
@@ -53,24 +70,111 @@ static void frame_handle_resource_destroy(struct wl_resource *resource) {
 	frame_destroy(frame);
 }
 
-static void frame_output_handle_precommit(struct wl_listener *listener,
+/**
+ * Applies the drop policy so that the frame's client can hold one more
+ * buffer. Returns false if the frame needs to be dropped.
+ */
+static bool frame_make_room(struct wlr_export_dmabuf_frame_v1 *frame) {
+	struct wlr_export_dmabuf_manager_v1 *manager = frame->manager;
+	if (manager->max_frames_per_client == 0) {
+		return true;
+	}
+
+	struct wl_client *client = wl_resource_get_client(frame->resource);
+	while (true) {
+		// Frames are ordered from the newest to the oldest
+		size_t held = 0;
+		struct wlr_export_dmabuf_frame_v1 *oldest = NULL, *iter;
+		wl_list_for_each(iter, &manager->frames, link) {
+			if (iter->buffer != NULL &&
+					wl_resource_get_client(iter->resource) == client) {
+				held++;
+				oldest = iter;
+			}
+		}
+
+		if (held < manager->max_frames_per_client) {
+			return true;
+		}
+		if (manager->drop_policy == WLR_EXPORT_DMABUF_DROP_NEWEST) {
+			return false;
+		}
+
+		zwlr_export_dmabuf_frame_v1_send_cancel(oldest->resource,
+			ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_TEMPORARY);
+		frame_destroy(oldest);
+	}
+}
+
+static bool frame_export(struct wlr_export_dmabuf_frame_v1 *frame,
+		uint32_t *frame_flags) {
+	// Locked buffers can be used as long as the client needs them, other
+	// ones need to be copied right away
+	*frame_flags = 0;
+	frame->buffer = wlr_output_lock_front_buffer(frame->output);
+	if (frame->buffer != NULL) {
+		struct wlr_dmabuf_attributes attribs;
+		if (wlr_buffer_get_dmabuf(frame->buffer, &attribs) &&
+				wlr_dmabuf_attributes_copy(&frame->attribs, &attribs)) {
+			return true;
+		}
+		wlr_buffer_unlock(frame->buffer);
+		frame->buffer = NULL;
+	}
+
+	*frame_flags = ZWLR_EXPORT_DMABUF_FRAME_V1_FLAGS_TRANSIENT;
+	return wlr_output_export_dmabuf(frame->output, &frame->attribs);
+}
+
+static void frame_output_handle_present(struct wl_listener *listener,
 		void *data) {
 	struct wlr_export_dmabuf_frame_v1 *frame =
-		wl_container_of(listener, frame, output_precommit);
-	struct wlr_output_event_precommit *event = data;
+		wl_container_of(listener, frame, output_present);
+	struct wlr_output_event_present *event = data;
+	struct wlr_output *output = frame->output;
 
-	if (!(event->output->pending.committed & WLR_OUTPUT_STATE_BUFFER)) {
+	uint32_t frame_flags;
+	if (!frame_make_room(frame) || !frame_export(frame, &frame_flags)) {
+		zwlr_export_dmabuf_frame_v1_send_cancel(frame->resource,
+			ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_TEMPORARY);
+		frame_destroy(frame);
 		return;
 	}
 
-	wl_list_remove(&frame->output_precommit.link);
-	wl_list_init(&frame->output_precommit.link);
+	struct wlr_dmabuf_attributes *attribs = &frame->attribs;
+	uint32_t mod_high = attribs->modifier >> 32;
+	uint32_t mod_low = attribs->modifier & 0xFFFFFFFF;
+
+	zwlr_export_dmabuf_frame_v1_send_frame(frame->resource,
+		output->width, output->height, 0, 0, attribs->flags, frame_flags,
+		attribs->format, mod_high, mod_low, attribs->n_planes);
+
+	for (int i = 0; i < attribs->n_planes; ++i) {
+		off_t size = lseek(attribs->fd[i], 0, SEEK_END);
 
+		zwlr_export_dmabuf_frame_v1_send_object(frame->resource, i,
+			attribs->fd[i], size, attribs->offset[i], attribs->stride[i], i);
+	}
+
+	// The buffer has just been flipped to, its contents are complete
 	time_t tv_sec = event->when->tv_sec;
 	uint32_t tv_sec_hi = (sizeof(tv_sec) > 4) ? tv_sec >> 32 : 0;
 	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
 	zwlr_export_dmabuf_frame_v1_send_ready(frame->resource,
 		tv_sec_hi, tv_sec_lo, event->when->tv_nsec);
+
+	frame_release_output(frame);
+	if (frame->buffer == NULL) {
+		frame_destroy(frame);
+	}
+}
+
+static void frame_output_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_export_dmabuf_frame_v1 *frame =
+		wl_container_of(listener, frame, output_destroy);
+	zwlr_export_dmabuf_frame_v1_send_cancel(frame->resource,
+		ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_PERMANENT);
 	frame_destroy(frame);
 }
 
@@ -98,7 +202,8 @@ static void manager_handle_capture_output(struct wl_client *client,
 		return;
 	}
 	frame->manager = manager;
-	wl_list_init(&frame->output_precommit.link);
+	wl_list_init(&frame->output_present.link);
+	wl_list_init(&frame->output_destroy.link);
 
 	uint32_t version = wl_resource_get_version(manager_resource);
 	frame->resource = wl_resource_create(client,
@@ -113,21 +218,14 @@ static void manager_handle_capture_output(struct wl_client *client,
 
 	wl_list_insert(&manager->frames, &frame->link);
 
-	if (output == NULL || !output->enabled || !output->impl->export_dmabuf) {
+	if (output == NULL || !output->enabled ||
+			(!output->impl->export_dmabuf && !output->impl->lock_front_buffer)) {
 		zwlr_export_dmabuf_frame_v1_send_cancel(frame->resource,
 			ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_PERMANENT);
 		frame_destroy(frame);
 		return;
 	}
 
-	struct wlr_dmabuf_attributes *attribs = &frame->attribs;
-	if (!wlr_output_export_dmabuf(output, attribs)) {
-		zwlr_export_dmabuf_frame_v1_send_cancel(frame->resource,
-			ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_TEMPORARY);
-		frame_destroy(frame);
-		return;
-	}
-
 	frame->output = output;
 
 	wlr_output_lock_attach_render(frame->output, true);
@@ -136,26 +234,14 @@ static void manager_handle_capture_output(struct wl_client *client,
 		frame->cursor_locked = true;
 	}
 
-	uint32_t frame_flags = ZWLR_EXPORT_DMABUF_FRAME_V1_FLAGS_TRANSIENT;
-	uint32_t mod_high = attribs->modifier >> 32;
-	uint32_t mod_low = attribs->modifier & 0xFFFFFFFF;
-
-	zwlr_export_dmabuf_frame_v1_send_frame(frame->resource,
-		output->width, output->height, 0, 0, attribs->flags, frame_flags,
-		attribs->format, mod_high, mod_low, attribs->n_planes);
-
-	for (int i = 0; i < attribs->n_planes; ++i) {
-		off_t size = lseek(attribs->fd[i], 0, SEEK_END);
-
-		zwlr_export_dmabuf_frame_v1_send_object(frame->resource, i,
-			attribs->fd[i], size, attribs->offset[i], attribs->stride[i], i);
-	}
+	// The frame is exported once it's on screen, so that its timestamp is
+	// the one of the page-flip
+	wl_signal_add(&output->events.present, &frame->output_present);
+	frame->output_present.notify = frame_output_handle_present;
+	wl_signal_add(&output->events.destroy, &frame->output_destroy);
+	frame->output_destroy.notify = frame_output_handle_destroy;
 
 	wlr_output_schedule_frame(output);
-
-	wl_list_remove(&frame->output_precommit.link);
-	wl_signal_add(&output->events.precommit, &frame->output_precommit);
-	frame->output_precommit.notify = frame_output_handle_precommit;
 }
 
 static void manager_handle_destroy(struct wl_client *client,
@@ -200,6 +286,8 @@ struct wlr_export_dmabuf_manager_v1 *wlr_export_dmabuf_manager_v1_create(
 	}
 	wl_list_init(&manager->frames);
 	wl_signal_init(&manager->events.destroy);
+	manager->max_frames_per_client = 2;
+	manager->drop_policy = WLR_EXPORT_DMABUF_DROP_OLDEST;
 
 	manager->global = wl_global_create(display,
 		&zwlr_export_dmabuf_manager_v1_interface, EXPORT_DMABUF_MANAGER_VERSION,
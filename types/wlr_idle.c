@@ -1,6 +1,9 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_idle.h>
 #include <wlr/util/log.h>
@@ -16,10 +19,15 @@ static struct wlr_idle_timeout *idle_timeout_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
-static int idle_notify(void *data) {
-	struct wlr_idle_timeout *timer = data;
+static int64_t get_current_time_msec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static void idle_notify(struct wlr_idle_timeout *timer) {
 	if (timer->idle_state) {
-		return 0;
+		return;
 	}
 	timer->idle_state = true;
 	wlr_signal_emit_safe(&timer->events.idle, timer);
@@ -27,7 +35,81 @@ static int idle_notify(void *data) {
 	if (timer->resource) {
 		org_kde_kwin_idle_timeout_send_idle(timer->resource);
 	}
-	return 1;
+}
+
+static void idle_arm_timer(struct wlr_idle *idle, int64_t deadline,
+		int64_t now) {
+	int64_t delay = deadline > now ? deadline - now : 0;
+	if (delay == 0) {
+		delay = 1; // A zero delay disarms the timer
+	} else if (delay > INT_MAX) {
+		// The timer will fire early and re-arm itself
+		delay = INT_MAX;
+	}
+	wl_event_source_timer_update(idle->timer_source, delay);
+	idle->timer_armed = true;
+	idle->timer_deadline = deadline;
+}
+
+/**
+ * Makes sure the shared timer fires no later than `deadline`. Activity only
+ * ever pushes deadlines back, so the timer is left alone when it's already
+ * armed for an earlier time: it'll re-arm itself for the next deadline when
+ * it fires.
+ */
+static void idle_schedule(struct wlr_idle *idle, int64_t deadline,
+		int64_t now) {
+	if (idle->timer_armed && idle->timer_deadline <= deadline) {
+		return;
+	}
+	idle_arm_timer(idle, deadline, now);
+}
+
+static int handle_idle_timer(void *data) {
+	struct wlr_idle *idle = data;
+	idle->timer_armed = false;
+
+	int64_t now = get_current_time_msec();
+
+	// Handlers may create or destroy timers, so restart the scan after each
+	// notification
+	bool notified;
+	do {
+		notified = false;
+		struct wlr_idle_timeout *timer;
+		wl_list_for_each(timer, &idle->idle_timers, link) {
+			if (timer->enabled && !timer->idle_state &&
+					timer->deadline <= now) {
+				idle_notify(timer);
+				notified = true;
+				break;
+			}
+		}
+	} while (notified);
+
+	bool found = false;
+	int64_t next = 0;
+	struct wlr_idle_timeout *timer;
+	wl_list_for_each(timer, &idle->idle_timers, link) {
+		if (timer->enabled && !timer->idle_state &&
+				(!found || timer->deadline < next)) {
+			next = timer->deadline;
+			found = true;
+		}
+	}
+	if (found) {
+		idle_arm_timer(idle, next, now);
+	}
+	return 0;
+}
+
+static void timer_reset(struct wlr_idle_timeout *timer, int64_t now) {
+	timer->deadline = now + timer->timeout;
+	if (timer->timeout == 0) {
+		idle_notify(timer);
+	} else {
+		idle_schedule(timer->idle, timer->deadline, now);
+	}
 }
 
 static void handle_activity(struct wlr_idle_timeout *timer) {
@@ -45,11 +127,8 @@ static void handle_activity(struct wlr_idle_timeout *timer) {
 		}
 	}
 
-	// rearm the timer
-	wl_event_source_timer_update(timer->idle_source, timer->timeout);
-	if (timer->timeout == 0) {
-		idle_notify(timer);
-	}
+	// Only the deadline moves, the shared timer is re-armed lazily
+	timer_reset(timer, get_current_time_msec());
 }
 
 static void handle_timer_resource_destroy(struct wl_resource *timer_resource) {
@@ -108,6 +187,7 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 		return NULL;
 	}
 
+	timer->idle = idle;
 	timer->seat = seat;
 	timer->timeout = timeout;
 	timer->idle_state = false;
@@ -123,16 +203,6 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 
 	timer->input_listener.notify = handle_input_notification;
 	wl_signal_add(&idle->events.activity_notify, &timer->input_listener);
-	// create the timer
-	timer->idle_source =
-		wl_event_loop_add_timer(idle->event_loop, idle_notify, timer);
-	if (timer->idle_source == NULL) {
-		wl_list_remove(&timer->link);
-		wl_list_remove(&timer->input_listener.link);
-		wl_list_remove(&timer->seat_destroy.link);
-		free(timer);
-		return NULL;
-	}
 
 	if (resource) {
 		timer->resource = resource;
@@ -140,11 +210,7 @@ static struct wlr_idle_timeout *create_timer(struct wlr_idle *idle,
 	}
 
 	if (timer->enabled) {
-		// arm the timer
-		wl_event_source_timer_update(timer->idle_source, timer->timeout);
-		if (timer->timeout == 0) {
-			idle_notify(timer);
-		}
+		timer_reset(timer, get_current_time_msec());
 	}
 
 	return timer;
@@ -185,14 +251,18 @@ void wlr_idle_set_enabled(struct wlr_idle *idle, struct wlr_seat *seat,
 		enabled ? "Enabling" : "Disabling",
 		seat ? seat->name : "all seats");
 	idle->enabled = enabled;
+	int64_t now = get_current_time_msec();
 	struct wlr_idle_timeout *timer;
 	wl_list_for_each(timer, &idle->idle_timers, link) {
 		if (seat != NULL && timer->seat != seat) {
 			continue;
 		}
-		int timeout = enabled ? timer->timeout : 0;
-		wl_event_source_timer_update(timer->idle_source, timeout);
+		// Disabled timers are skipped when the shared timer fires
 		timer->enabled = enabled;
+		if (enabled) {
+			timer->deadline = now + timer->timeout;
+			idle_schedule(idle, timer->deadline, now);
+		}
 	}
 }
 
@@ -214,6 +284,7 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_idle *idle = wl_container_of(listener, idle, display_destroy);
 	wlr_signal_emit_safe(&idle->events.destroy, idle);
 	wl_list_remove(&idle->display_destroy.link);
+	wl_event_source_remove(idle->timer_source);
 	wl_global_destroy(idle->global);
 	free(idle);
 }
@@ -234,6 +305,13 @@ struct wlr_idle *wlr_idle_create(struct wl_display *display) {
 		return NULL;
 	}
 
+	idle->timer_source =
+		wl_event_loop_add_timer(idle->event_loop, handle_idle_timer, idle);
+	if (idle->timer_source == NULL) {
+		free(idle);
+		return NULL;
+	}
+
 	idle->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &idle->display_destroy);
 
@@ -241,6 +319,7 @@ struct wlr_idle *wlr_idle_create(struct wl_display *display) {
 		1, idle, idle_bind);
 	if (idle->global == NULL) {
 		wl_list_remove(&idle->display_destroy.link);
+		wl_event_source_remove(idle->timer_source);
 		free(idle);
 		return NULL;
 	}
@@ -262,7 +341,6 @@ void wlr_idle_timeout_destroy(struct wlr_idle_timeout *timer) {
 
 	wl_list_remove(&timer->input_listener.link);
 	wl_list_remove(&timer->seat_destroy.link);
-	wl_event_source_remove(timer->idle_source);
 	wl_list_remove(&timer->link);
 
 	if (timer->resource) {
@@ -1,7 +1,9 @@
-#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include <assert.h>
 #include <drm_fourcc.h>
+#include <fcntl.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/render/drm_format_set.h>
@@ -9,10 +11,28 @@
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/util/log.h>
 #include "linux-dmabuf-unstable-v1-protocol.h"
+#include "types/wlr_linux_dmabuf_v1.h"
 #include "util/signal.h"
 
+#if defined(__linux__)
+#include <linux/kcmp.h>
+#include <sys/syscall.h>
+#endif
+
 #define LINUX_DMABUF_VERSION 3
 
+struct wlr_dmabuf_v1_texture {
+	struct wl_list link; // wlr_linux_dmabuf_v1.textures
+	size_t n_locks;
+
+	// Owns duplicated FDs, used to check DMA-BUF identity
+	struct wlr_dmabuf_attributes attributes;
+	dev_t dev[WLR_DMABUF_MAX_PLANES];
+	ino_t ino[WLR_DMABUF_MAX_PLANES];
+
+	struct wlr_texture *texture;
+};
+
 static void buffer_handle_destroy(struct wl_client *client,
 		struct wl_resource *resource) {
 	wl_resource_destroy(resource);
@@ -54,10 +74,154 @@ struct wlr_dmabuf_v1_buffer *wlr_dmabuf_v1_buffer_from_buffer_resource(
 }
 
 static void linux_dmabuf_buffer_destroy(struct wlr_dmabuf_v1_buffer *buffer) {
+	if (buffer->texture != NULL) {
+		dmabuf_v1_texture_unlock(buffer->texture);
+	}
+	wl_list_remove(&buffer->link);
 	wlr_dmabuf_attributes_finish(&buffer->attributes);
 	free(buffer);
 }
 
+struct wlr_dmabuf_v1_texture *dmabuf_v1_buffer_lock_texture(
+		struct wlr_dmabuf_v1_buffer *buffer, struct wlr_renderer *renderer) {
+	if (buffer->texture == NULL || buffer->renderer != renderer) {
+		return NULL;
+	}
+	buffer->texture->n_locks++;
+	return buffer->texture;
+}
+
+struct wlr_texture *dmabuf_v1_texture_get_texture(
+		struct wlr_dmabuf_v1_texture *texture) {
+	return texture->texture;
+}
+
+void dmabuf_v1_texture_unlock(struct wlr_dmabuf_v1_texture *texture) {
+	assert(texture->n_locks > 0);
+	texture->n_locks--;
+	if (texture->n_locks > 0) {
+		return;
+	}
+
+	wl_list_remove(&texture->link);
+	wlr_texture_destroy(texture->texture);
+	wlr_dmabuf_attributes_finish(&texture->attributes);
+	free(texture);
+}
+
+static bool same_file(int fd1, int fd2) {
+#if defined(__linux__)
+	// DMA-BUFs sent over the wire by the same client share their struct file,
+	// even if the FD numbers differ
+	pid_t pid = getpid();
+	return syscall(SYS_kcmp, pid, pid, KCMP_FILE, fd1, fd2) == 0;
+#else
+	return false;
+#endif
+}
+
+static bool texture_matches(struct wlr_dmabuf_v1_texture *texture,
+		const struct wlr_dmabuf_attributes *attribs,
+		const struct stat st[static WLR_DMABUF_MAX_PLANES]) {
+	const struct wlr_dmabuf_attributes *cached = &texture->attributes;
+	if (cached->width != attribs->width ||
+			cached->height != attribs->height ||
+			cached->format != attribs->format ||
+			cached->flags != attribs->flags ||
+			cached->modifier != attribs->modifier ||
+			cached->n_planes != attribs->n_planes) {
+		return false;
+	}
+
+	for (int i = 0; i < attribs->n_planes; i++) {
+		if (cached->offset[i] != attribs->offset[i] ||
+				cached->stride[i] != attribs->stride[i] ||
+				texture->dev[i] != st[i].st_dev ||
+				texture->ino[i] != st[i].st_ino) {
+			return false;
+		}
+	}
+
+	// Older kernels give all DMA-BUFs the same inode, so the above is only a
+	// cheap way to reject mismatches
+	for (int i = 0; i < attribs->n_planes; i++) {
+		if (!same_file(cached->fd[i], attribs->fd[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Imports the buffer's DMA-BUF, re-using the texture of a live buffer backed
+ * by the same DMA-BUF planes if any. Clients often re-create wl_buffers for
+ * the same swapchain images, e.g. on resize or when a surface is re-mapped.
+ */
+static struct wlr_dmabuf_v1_texture *import_dmabuf(
+		struct wlr_linux_dmabuf_v1 *linux_dmabuf,
+		struct wlr_dmabuf_v1_buffer *buffer) {
+	struct wlr_dmabuf_attributes *attribs = &buffer->attributes;
+
+	bool cacheable = true;
+	struct stat st[WLR_DMABUF_MAX_PLANES] = {0};
+	for (int i = 0; i < attribs->n_planes; i++) {
+		if (fstat(attribs->fd[i], &st[i]) != 0) {
+			cacheable = false;
+			break;
+		}
+	}
+
+	if (cacheable) {
+		struct wlr_dmabuf_v1_texture *texture;
+		wl_list_for_each(texture, &linux_dmabuf->textures, link) {
+			if (texture_matches(texture, attribs, st)) {
+				texture->n_locks++;
+				return texture;
+			}
+		}
+	}
+
+	struct wlr_dmabuf_v1_texture *texture = calloc(1, sizeof(*texture));
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	texture->texture = wlr_texture_from_dmabuf(buffer->renderer, attribs);
+	if (texture->texture == NULL) {
+		free(texture);
+		return NULL;
+	}
+
+	wl_list_init(&texture->link);
+	if (!cacheable) {
+		texture->n_locks = 1;
+		return texture;
+	}
+
+	texture->attributes = *attribs;
+	texture->attributes.n_planes = 0;
+	for (int i = 0; i < attribs->n_planes; i++) {
+		int fd = fcntl(attribs->fd[i], F_DUPFD_CLOEXEC, 0);
+		if (fd < 0) {
+			// Keep the texture out of the cache
+			wlr_log_errno(WLR_DEBUG, "fcntl(F_DUPFD_CLOEXEC) failed");
+			wlr_dmabuf_attributes_finish(&texture->attributes);
+			texture->n_locks = 1;
+			return texture;
+		}
+		texture->attributes.fd[i] = fd;
+		texture->attributes.n_planes++;
+		texture->dev[i] = st[i].st_dev;
+		texture->ino[i] = st[i].st_ino;
+	}
+	wl_list_insert(&linux_dmabuf->textures, &texture->link);
+
+	texture->n_locks = 1;
+	return texture;
+}
+
 static void params_destroy(struct wl_client *client,
 		struct wl_resource *resource) {
 	wl_resource_destroy(resource);
@@ -122,16 +286,14 @@ static void buffer_handle_resource_destroy(struct wl_resource *buffer_resource)
 }
 
 static bool check_import_dmabuf(struct wlr_dmabuf_v1_buffer *buffer) {
-	struct wlr_texture *texture =
-		wlr_texture_from_dmabuf(buffer->renderer, &buffer->attributes);
-	if (texture == NULL) {
+	if (buffer->linux_dmabuf == NULL) {
 		return false;
 	}
 
-	// We can import the image, good. No need to keep it since wlr_surface will
-	// import it again on commit.
-	wlr_texture_destroy(texture);
-	return true;
+	// We can import the image, good. Keep the texture around so that
+	// wlr_surface doesn't need to import it again on commit.
+	buffer->texture = import_dmabuf(buffer->linux_dmabuf, buffer);
+	return buffer->texture != NULL;
 }
 
 static void params_create_common(struct wl_client *client,
@@ -349,11 +511,13 @@ static void linux_dmabuf_create_params(struct wl_client *client,
 	}
 
 	buffer->renderer = linux_dmabuf->renderer;
+	buffer->linux_dmabuf = linux_dmabuf;
 	buffer->params_resource = wl_resource_create(client,
 		&zwp_linux_buffer_params_v1_interface, version, params_id);
 	if (!buffer->params_resource) {
 		goto err_free;
 	}
+	wl_list_insert(&linux_dmabuf->buffers, &buffer->link);
 
 	wl_resource_set_implementation(buffer->params_resource,
 		&linux_buffer_params_impl, buffer, handle_params_destroy);
@@ -443,6 +607,24 @@ static void linux_dmabuf_v1_destroy(struct wlr_linux_dmabuf_v1 *linux_dmabuf) {
 	wl_list_remove(&linux_dmabuf->display_destroy.link);
 	wl_list_remove(&linux_dmabuf->renderer_destroy.link);
 
+	// Textures may outlive the renderer otherwise. Client buffers still
+	// holding a lock keep theirs until they're destroyed, like before.
+	struct wlr_dmabuf_v1_buffer *buffer, *buffer_tmp;
+	wl_list_for_each_safe(buffer, buffer_tmp, &linux_dmabuf->buffers, link) {
+		if (buffer->texture != NULL) {
+			dmabuf_v1_texture_unlock(buffer->texture);
+			buffer->texture = NULL;
+		}
+		buffer->linux_dmabuf = NULL;
+		wl_list_remove(&buffer->link);
+		wl_list_init(&buffer->link);
+	}
+	struct wlr_dmabuf_v1_texture *texture, *texture_tmp;
+	wl_list_for_each_safe(texture, texture_tmp, &linux_dmabuf->textures, link) {
+		wl_list_remove(&texture->link);
+		wl_list_init(&texture->link);
+	}
+
 	wl_global_destroy(linux_dmabuf->global);
 	free(linux_dmabuf);
 }
@@ -470,6 +652,8 @@ struct wlr_linux_dmabuf_v1 *wlr_linux_dmabuf_v1_create(struct wl_display *displa
 	linux_dmabuf->renderer = renderer;
 
 	wl_signal_init(&linux_dmabuf->events.destroy);
+	wl_list_init(&linux_dmabuf->buffers);
+	wl_list_init(&linux_dmabuf->textures);
 
 	linux_dmabuf->global =
 		wl_global_create(display, &zwp_linux_dmabuf_v1_interface,
@@ -15,8 +15,10 @@
 #include <wlr/types/wlr_surface.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
+#include "types/wlr_output.h"
 #include "util/global.h"
 #include "util/signal.h"
+#include "util/trace.h"
 
 #define OUTPUT_VERSION 3
 
@@ -501,7 +503,7 @@ static void output_pending_resolution(struct wlr_output *output, int *width,
 	}
 }
 
-static bool output_basic_test(struct wlr_output *output) {
+bool output_basic_test(struct wlr_output *output) {
 	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
 		if (output->frame_pending) {
 			wlr_log(WLR_DEBUG, "Tried to commit a buffer while a frame is pending");
@@ -562,7 +564,8 @@ bool wlr_output_test(struct wlr_output *output) {
 	return output->impl->test(output);
 }
 
-bool wlr_output_commit(struct wlr_output *output) {
+bool output_commit_prepare(struct wlr_output *output,
+		struct timespec *now) {
 	if (!output_basic_test(output)) {
 		wlr_log(WLR_ERROR, "Basic output test failed");
 		return false;
@@ -574,27 +577,44 @@ bool wlr_output_commit(struct wlr_output *output) {
 		output->idle_frame = NULL;
 	}
 
-	struct timespec now;
-	clock_gettime(CLOCK_MONOTONIC, &now);
-
 	struct wlr_output_event_precommit event = {
 		.output = output,
-		.when = &now,
+		.when = now,
 	};
 	wlr_signal_emit_safe(&output->events.precommit, &event);
+	return true;
+}
+
+void output_commit_abort(struct wlr_output *output) {
+	output_state_clear(&output->pending);
+}
+
+bool wlr_output_commit(struct wlr_output *output) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (!output_commit_prepare(output, &now)) {
+		return false;
+	}
 
 	if (!output->impl->commit(output)) {
-		output_state_clear(&output->pending);
+		output_commit_abort(output);
 		return false;
 	}
 
+	output_commit_finish(output, &now);
+	return true;
+}
+
+void output_commit_finish(struct wlr_output *output,
+		const struct timespec *now) {
 	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
 		struct wlr_output_cursor *cursor;
 		wl_list_for_each(cursor, &output->cursors, link) {
 			if (!cursor->enabled || !cursor->visible || cursor->surface == NULL) {
 				continue;
 			}
-			wlr_surface_send_frame_done(cursor->surface, &now);
+			wlr_surface_send_frame_done(cursor->surface, now);
 		}
 	}
 
@@ -635,7 +655,6 @@ bool wlr_output_commit(struct wlr_output *output) {
 	}
 
 	output_state_clear(&output->pending);
-	return true;
 }
 
 void wlr_output_rollback(struct wlr_output *output) {
@@ -708,7 +727,9 @@ void wlr_output_send_present(struct wlr_output *output,
 		event->when = &now;
 	}
 
+	TRACE_BEGIN("output_present");
 	wlr_signal_emit_safe(&output->events.present, event);
+	TRACE_END("output_present");
 }
 
 void wlr_output_set_gamma(struct wlr_output *output, size_t size,
@@ -743,6 +764,13 @@ bool wlr_output_export_dmabuf(struct wlr_output *output,
 	return output->impl->export_dmabuf(output, attribs);
 }
 
+struct wlr_buffer *wlr_output_lock_front_buffer(struct wlr_output *output) {
+	if (!output->impl->lock_front_buffer) {
+		return NULL;
+	}
+	return output->impl->lock_front_buffer(output);
+}
+
 void wlr_output_update_needs_frame(struct wlr_output *output) {
 	if (output->needs_frame) {
 		return;
@@ -1002,6 +1030,110 @@ static bool output_cursor_attempt_hardware(struct wlr_output_cursor *cursor) {
 	return false;
 }
 
+#define OUTPUT_CURSOR_IMAGE_CACHE_SIZE 64
+
+struct output_cursor_image {
+	struct wl_list link; // wlr_output_cursor::image_cache, most recent first
+	uint32_t width, height;
+	uint64_t hash;
+	uint8_t *pixels; // ARGB8888, packed
+	struct wlr_texture *texture;
+};
+
+static uint64_t hash_cursor_pixels(const uint8_t *pixels, int32_t stride,
+		uint32_t width, uint32_t height) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (uint32_t y = 0; y < height; y++) {
+		const uint8_t *row = pixels + (size_t)y * stride;
+		for (size_t i = 0; i < (size_t)width * 4; i++) {
+			hash ^= row[i];
+			hash *= 0x100000001b3;
+		}
+	}
+	return hash;
+}
+
+static void output_cursor_image_destroy(struct output_cursor_image *image) {
+	wl_list_remove(&image->link);
+	wlr_texture_destroy(image->texture);
+	free(image->pixels);
+	free(image);
+}
+
+static bool output_cursor_image_matches(struct output_cursor_image *image,
+		const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height,
+		uint64_t hash) {
+	if (image->width != width || image->height != height ||
+			image->hash != hash) {
+		return false;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		if (memcmp(image->pixels + (size_t)y * width * 4,
+				pixels + (size_t)y * stride, (size_t)width * 4) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Returns a texture with the given contents, reusing the one of a previously
+ * set image if possible. The textures are never written to, which allows
+ * backends to cache whatever they derive from them until they're destroyed.
+ */
+static struct wlr_texture *output_cursor_get_image_texture(
+		struct wlr_output_cursor *cursor, struct wlr_renderer *renderer,
+		const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height) {
+	uint64_t hash = hash_cursor_pixels(pixels, stride, width, height);
+
+	struct output_cursor_image *image;
+	wl_list_for_each(image, &cursor->image_cache, link) {
+		if (output_cursor_image_matches(image, pixels, stride, width, height,
+				hash)) {
+			wl_list_remove(&image->link);
+			wl_list_insert(&cursor->image_cache, &image->link);
+			return image->texture;
+		}
+	}
+
+	image = calloc(1, sizeof(*image));
+	if (image == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	image->width = width;
+	image->height = height;
+	image->hash = hash;
+	image->pixels = malloc((size_t)width * height * 4);
+	if (image->pixels == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		free(image);
+		return NULL;
+	}
+	for (uint32_t y = 0; y < height; y++) {
+		memcpy(image->pixels + (size_t)y * width * 4,
+			pixels + (size_t)y * stride, (size_t)width * 4);
+	}
+
+	image->texture = wlr_texture_from_pixels(renderer,
+		WL_SHM_FORMAT_ARGB8888, stride, width, height, pixels);
+	if (image->texture == NULL) {
+		free(image->pixels);
+		free(image);
+		return NULL;
+	}
+
+	if (wl_list_length(&cursor->image_cache) >= OUTPUT_CURSOR_IMAGE_CACHE_SIZE) {
+		struct output_cursor_image *oldest =
+			wl_container_of(cursor->image_cache.prev, oldest, link);
+		output_cursor_image_destroy(oldest);
+	}
+	wl_list_insert(&cursor->image_cache, &image->link);
+
+	return image->texture;
+}
+
 bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 		const uint8_t *pixels, int32_t stride, uint32_t width, uint32_t height,
 		int32_t hotspot_x, int32_t hotspot_y) {
@@ -1021,13 +1153,12 @@ bool wlr_output_cursor_set_image(struct wlr_output_cursor *cursor,
 	cursor->hotspot_y = hotspot_y;
 	output_cursor_update_visible(cursor);
 
-	wlr_texture_destroy(cursor->texture);
 	cursor->texture = NULL;
 
 	cursor->enabled = false;
 	if (pixels != NULL) {
-		cursor->texture = wlr_texture_from_pixels(renderer,
-			WL_SHM_FORMAT_ARGB8888, stride, width, height, pixels);
+		cursor->texture = output_cursor_get_image_texture(cursor, renderer,
+			pixels, stride, width, height);
 		if (cursor->texture == NULL) {
 			return false;
 		}
@@ -1176,6 +1307,7 @@ struct wlr_output_cursor *wlr_output_cursor_create(struct wlr_output *output) {
 	cursor->surface_commit.notify = output_cursor_handle_commit;
 	wl_list_init(&cursor->surface_destroy.link);
 	cursor->surface_destroy.notify = output_cursor_handle_destroy;
+	wl_list_init(&cursor->image_cache);
 	wl_list_insert(&output->cursors, &cursor->link);
 	cursor->visible = true; // default position is at (0, 0)
 	return cursor;
@@ -1195,7 +1327,10 @@ void wlr_output_cursor_destroy(struct wlr_output_cursor *cursor) {
 		}
 		cursor->output->hardware_cursor = NULL;
 	}
-	wlr_texture_destroy(cursor->texture);
+	struct output_cursor_image *image, *tmp;
+	wl_list_for_each_safe(image, tmp, &cursor->image_cache, link) {
+		output_cursor_image_destroy(image);
+	}
 	wl_list_remove(&cursor->link);
 	free(cursor);
 }
@@ -7,6 +7,7 @@
 #include <wlr/backend.h>
 #include "presentation-time-protocol.h"
 #include "util/signal.h"
+#include "util/trace.h"
 
 #define PRESENTATION_VERSION 1
 
@@ -200,6 +201,8 @@ struct wlr_presentation *wlr_presentation_create(struct wl_display *display,
 void wlr_presentation_feedback_send_presented(
 		struct wlr_presentation_feedback *feedback,
 		struct wlr_presentation_event *event) {
+	TRACE_INSTANT("presentation_feedback");
+
 	struct wl_resource *resource, *tmp;
 	wl_resource_for_each_safe(resource, tmp, &feedback->resources) {
 		feedback_resource_send_presented(resource, event);
@@ -1,5 +1,8 @@
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <drm_fourcc.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_output.h>
@@ -11,6 +14,8 @@
 #include "util/signal.h"
 
 #define SCREENCOPY_MANAGER_VERSION 3
+// Past this number of rectangles, only the damage extents are sent
+#define SCREENCOPY_MAX_DAMAGE_RECTS 32
 
 struct screencopy_damage {
 	struct wl_list link;
@@ -146,12 +151,57 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	wl_list_remove(&frame->output_destroy.link);
 	wl_list_remove(&frame->output_enable.link);
 	wl_list_remove(&frame->buffer_destroy.link);
+	if (frame->fence_source != NULL) {
+		wl_event_source_remove(frame->fence_source);
+	}
+	if (frame->fence_fd >= 0) {
+		close(frame->fence_fd);
+	}
 	// Make the frame resource inert
 	wl_resource_set_user_data(frame->resource, NULL);
 	client_unref(frame->client);
 	free(frame);
 }
 
+static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame,
+		pixman_region32_t *output_damage) {
+	// Damage is relative to the captured region
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	pixman_region32_intersect_rect(&damage, output_damage,
+		frame->box.x, frame->box.y, frame->box.width, frame->box.height);
+	pixman_region32_translate(&damage, -frame->box.x, -frame->box.y);
+
+	int rects_len;
+	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &rects_len);
+	if (rects_len > SCREENCOPY_MAX_DAMAGE_RECTS) {
+		rects = pixman_region32_extents(&damage);
+		rects_len = 1;
+	}
+	for (int i = 0; i < rects_len; i++) {
+		zwlr_screencopy_frame_v1_send_damage(frame->resource,
+			rects[i].x1, rects[i].y1,
+			rects[i].x2 - rects[i].x1, rects[i].y2 - rects[i].y1);
+	}
+
+	pixman_region32_fini(&damage);
+}
+
+static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame) {
+	time_t tv_sec = frame->ready_time.tv_sec;
+	uint32_t tv_sec_hi = (sizeof(tv_sec) > 4) ? tv_sec >> 32 : 0;
+	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
+	zwlr_screencopy_frame_v1_send_ready(frame->resource,
+		tv_sec_hi, tv_sec_lo, frame->ready_time.tv_nsec);
+}
+
+static int frame_handle_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_screencopy_frame_v1 *frame = data;
+	frame_send_ready(frame);
+	frame_destroy(frame);
+	return 0;
+}
+
 static void frame_handle_output_precommit(struct wl_listener *listener,
 		void *_data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -184,6 +234,7 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 
 	bool ok = false;
 	uint32_t flags = 0;
+	int fence_fd = -1;
 
 	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
 	struct wlr_dmabuf_v1_buffer *dma_buffer = frame->dma_buffer;
@@ -204,13 +255,24 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 				ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
 		wl_shm_buffer_end_access(shm_buffer);
 	} else if (dma_buffer) {
-		struct wlr_dmabuf_attributes attr = { 0 };
-		ok = wlr_output_export_dmabuf(frame->output, &attr);
-		ok = ok && wlr_renderer_blit_dmabuf(renderer,
-				&dma_buffer->attributes, &attr);
-		flags |= dma_buffer->attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT ?
+		// A rendered frame is still in the current framebuffer, copy it
+		// straight into the client's buffer
+		if (output->pending.buffer_type == WLR_OUTPUT_STATE_BUFFER_RENDER) {
+			uint32_t renderer_flags = 0;
+			ok = wlr_renderer_read_pixels_to_dmabuf(renderer,
+				&dma_buffer->attributes, &renderer_flags, x, y, &fence_fd);
+			flags |= renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT ?
 				ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
-		wlr_dmabuf_attributes_finish(&attr);
+		}
+		if (!ok) {
+			struct wlr_dmabuf_attributes attr = { 0 };
+			ok = wlr_output_export_dmabuf(frame->output, &attr);
+			ok = ok && wlr_renderer_blit_dmabuf(renderer,
+					&dma_buffer->attributes, &attr);
+			flags = dma_buffer->attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT ?
+					ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
+			wlr_dmabuf_attributes_finish(&attr);
+		}
 	}
 
 	if (!ok) {
@@ -221,28 +283,34 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 
 	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
 
-	// TODO: send fine-grained damage events
 	if (damage) {
-		struct pixman_box32 *damage_box =
-			pixman_region32_extents(&damage->damage);
-
-		int damage_x = damage_box->x1;
-		int damage_y = damage_box->y1;
-		int damage_width = damage_box->x2 - damage_box->x1;
-		int damage_height = damage_box->y2 - damage_box->y1;
-
-		zwlr_screencopy_frame_v1_send_damage(frame->resource,
-			damage_x, damage_y, damage_width, damage_height);
-
+		frame_send_damage(frame, &damage->damage);
 		pixman_region32_clear(&damage->damage);
 	}
 
-	time_t tv_sec = event->when->tv_sec;
-	uint32_t tv_sec_hi = (sizeof(tv_sec) > 4) ? tv_sec >> 32 : 0;
-	uint32_t tv_sec_lo = tv_sec & 0xFFFFFFFF;
-	zwlr_screencopy_frame_v1_send_ready(frame->resource,
-		tv_sec_hi, tv_sec_lo, event->when->tv_nsec);
+	frame->ready_time = *event->when;
+
+	if (fence_fd >= 0) {
+		// Wait for the GPU copy to complete before telling the client
+		struct wl_display *display =
+			wl_client_get_display(wl_resource_get_client(frame->resource));
+		struct wl_event_loop *loop = wl_display_get_event_loop(display);
+		frame->fence_fd = fence_fd;
+		frame->fence_source = wl_event_loop_add_fd(loop, fence_fd,
+			WL_EVENT_READABLE, frame_handle_fence, frame);
+		if (frame->fence_source != NULL) {
+			return;
+		}
+		wlr_log(WLR_ERROR, "Failed to wait for screencopy fence");
+		// The fence is still valid, block on it rather than sending a
+		// frame which may not be complete yet
+		struct pollfd pfd = { .fd = fence_fd, .events = POLLIN };
+		while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+			// retry
+		}
+	}
 
+	frame_send_ready(frame);
 	frame_destroy(frame);
 }
 
@@ -443,6 +511,7 @@ static void capture_output(struct wl_client *wl_client,
 	}
 	frame->output = output;
 	frame->overlay_cursor = !!overlay_cursor;
+	frame->fence_fd = -1;
 
 	frame->resource = wl_resource_create(wl_client,
 		&zwlr_screencopy_frame_v1_interface, version, id);
@@ -10,12 +10,15 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
+#include "types/wlr_buffer.h"
 #include "util/signal.h"
 #include "util/time.h"
+#include "util/trace.h"
 
 #define CALLBACK_VERSION 1
 #define SURFACE_VERSION 4
 #define SUBSURFACE_VERSION 1
+#define SHM_TEXTURE_POOL_SIZE 3
 
 static int min(int fst, int snd) {
 	if (fst < snd) {
@@ -208,6 +211,13 @@ static void surface_update_damage(pixman_region32_t *buffer_damage,
 		// Damage the whole buffer on resize
 		pixman_region32_union_rect(buffer_damage, buffer_damage, 0, 0,
 			pending->buffer_width, pending->buffer_height);
+	} else if (!pending->viewport.has_dst && !pending->viewport.has_src &&
+			pending->transform == WL_OUTPUT_TRANSFORM_NORMAL &&
+			pending->scale == 1) {
+		// Surface and buffer coordinates are the same, no need for a
+		// temporary region
+		pixman_region32_union(buffer_damage,
+			&pending->buffer_damage, &pending->surface_damage);
 	} else {
 		// Copy over surface damage + buffer damage
 		pixman_region32_t surface_damage;
@@ -242,8 +252,18 @@ static void surface_update_damage(pixman_region32_t *buffer_damage,
 	}
 }
 
-static void surface_state_copy(struct wlr_surface_state *state,
-		struct wlr_surface_state *next) {
+static void region_swap(pixman_region32_t *a, pixman_region32_t *b) {
+	pixman_region32_t tmp = *a;
+	*a = *b;
+	*b = tmp;
+}
+
+/**
+ * Copies the fields of `next` other than damage, the buffer and frame
+ * callbacks. Opaque and input regions are moved if `move` is set.
+ */
+static void surface_state_copy_fields(struct wlr_surface_state *state,
+		struct wlr_surface_state *next, bool move) {
 	state->width = next->width;
 	state->height = next->height;
 	state->buffer_width = next->buffer_width;
@@ -261,21 +281,21 @@ static void surface_state_copy(struct wlr_surface_state *state,
 	} else {
 		state->dx = state->dy = 0;
 	}
-	if (next->committed & WLR_SURFACE_STATE_SURFACE_DAMAGE) {
-		pixman_region32_copy(&state->surface_damage, &next->surface_damage);
-	} else {
-		pixman_region32_clear(&state->surface_damage);
-	}
-	if (next->committed & WLR_SURFACE_STATE_BUFFER_DAMAGE) {
-		pixman_region32_copy(&state->buffer_damage, &next->buffer_damage);
-	} else {
-		pixman_region32_clear(&state->buffer_damage);
-	}
+	// The pending regions are always fully replaced by the client before
+	// being committed again, so their storage can be handed over
 	if (next->committed & WLR_SURFACE_STATE_OPAQUE_REGION) {
-		pixman_region32_copy(&state->opaque, &next->opaque);
+		if (move) {
+			region_swap(&state->opaque, &next->opaque);
+		} else {
+			pixman_region32_copy(&state->opaque, &next->opaque);
+		}
 	}
 	if (next->committed & WLR_SURFACE_STATE_INPUT_REGION) {
-		pixman_region32_copy(&state->input, &next->input);
+		if (move) {
+			region_swap(&state->input, &next->input);
+		} else {
+			pixman_region32_copy(&state->input, &next->input);
+		}
 	}
 	if (next->committed & WLR_SURFACE_STATE_VIEWPORT) {
 		memcpy(&state->viewport, &next->viewport, sizeof(state->viewport));
@@ -284,23 +304,51 @@ static void surface_state_copy(struct wlr_surface_state *state,
 	state->committed |= next->committed;
 }
 
+/**
+ * Saves the current state into the previous one, except for the buffer and
+ * frame callbacks. The current damage is handed over to the previous state
+ * instead of being copied: it's left undefined, and must be replaced with
+ * surface_state_move afterwards.
+ */
+static void surface_state_save_previous(struct wlr_surface_state *previous,
+		struct wlr_surface_state *current) {
+	surface_state_copy_fields(previous, current, false);
+
+	region_swap(&previous->surface_damage, &current->surface_damage);
+	if (!(current->committed & WLR_SURFACE_STATE_SURFACE_DAMAGE)) {
+		pixman_region32_clear(&previous->surface_damage);
+	}
+	region_swap(&previous->buffer_damage, &current->buffer_damage);
+	if (!(current->committed & WLR_SURFACE_STATE_BUFFER_DAMAGE)) {
+		pixman_region32_clear(&previous->buffer_damage);
+	}
+}
+
 /**
  * Append pending state to current state and clear pending state.
  */
 static void surface_state_move(struct wlr_surface_state *state,
 		struct wlr_surface_state *next) {
-	surface_state_copy(state, next);
+	surface_state_copy_fields(state, next, true);
 
-	if (next->committed & WLR_SURFACE_STATE_BUFFER) {
-		surface_state_set_buffer(state, next->buffer_resource);
-		surface_state_reset_buffer(next);
-		next->dx = next->dy = 0;
-	}
+	// Hand the pending damage over instead of copying it
 	if (next->committed & WLR_SURFACE_STATE_SURFACE_DAMAGE) {
+		region_swap(&state->surface_damage, &next->surface_damage);
 		pixman_region32_clear(&next->surface_damage);
+	} else {
+		pixman_region32_clear(&state->surface_damage);
 	}
 	if (next->committed & WLR_SURFACE_STATE_BUFFER_DAMAGE) {
+		region_swap(&state->buffer_damage, &next->buffer_damage);
 		pixman_region32_clear(&next->buffer_damage);
+	} else {
+		pixman_region32_clear(&state->buffer_damage);
+	}
+
+	if (next->committed & WLR_SURFACE_STATE_BUFFER) {
+		surface_state_set_buffer(state, next->buffer_resource);
+		surface_state_reset_buffer(next);
+		next->dx = next->dy = 0;
 	}
 	if (next->committed & WLR_SURFACE_STATE_FRAME_CALLBACK_LIST) {
 		wl_list_insert_list(&state->frame_callback_list,
@@ -329,6 +377,113 @@ static void surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 	}
 }
 
+struct wlr_surface_shm_texture {
+	struct wl_list link; // wlr_surface::shm_textures
+	struct wl_resource *resource;
+	struct wlr_client_buffer *buffer; // locked
+	// Damage accumulated since the texture was last uploaded to, in
+	// buffer-local coordinates
+	pixman_region32_t damage;
+
+	struct wl_listener resource_destroy;
+};
+
+static void shm_texture_destroy(struct wlr_surface_shm_texture *shm_texture) {
+	wl_list_remove(&shm_texture->link);
+	wl_list_remove(&shm_texture->resource_destroy.link);
+	pixman_region32_fini(&shm_texture->damage);
+	wlr_buffer_unlock(&shm_texture->buffer->base);
+	free(shm_texture);
+}
+
+static void shm_texture_handle_resource_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_surface_shm_texture *shm_texture =
+		wl_container_of(listener, shm_texture, resource_destroy);
+	shm_texture_destroy(shm_texture);
+}
+
+static void surface_destroy_shm_textures(struct wlr_surface *surface) {
+	struct wlr_surface_shm_texture *shm_texture, *tmp;
+	wl_list_for_each_safe(shm_texture, tmp, &surface->shm_textures, link) {
+		shm_texture_destroy(shm_texture);
+	}
+}
+
+static void surface_add_shm_texture(struct wlr_surface *surface,
+		struct wl_resource *resource, struct wlr_client_buffer *buffer) {
+	struct wlr_surface_shm_texture *shm_texture =
+		calloc(1, sizeof(struct wlr_surface_shm_texture));
+	if (shm_texture == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	shm_texture->resource = resource;
+	shm_texture->buffer = buffer;
+	wlr_buffer_lock(&buffer->base);
+	pixman_region32_init(&shm_texture->damage);
+
+	shm_texture->resource_destroy.notify = shm_texture_handle_resource_destroy;
+	wl_resource_add_destroy_listener(resource, &shm_texture->resource_destroy);
+
+	wl_list_insert(&surface->shm_textures, &shm_texture->link);
+
+	if (wl_list_length(&surface->shm_textures) > SHM_TEXTURE_POOL_SIZE) {
+		struct wlr_surface_shm_texture *oldest =
+			wl_container_of(surface->shm_textures.prev, oldest, link);
+		shm_texture_destroy(oldest);
+	}
+}
+
+/**
+ * Brings the texture of a previously attached wl_shm buffer up to date by
+ * uploading the damage accumulated since it was last attached. This avoids
+ * full uploads for clients cycling through multiple wl_shm buffers.
+ */
+static struct wlr_client_buffer *surface_apply_shm_damage(
+		struct wlr_surface *surface, struct wl_resource *resource) {
+	struct wlr_surface_shm_texture *shm_texture;
+	wl_list_for_each(shm_texture, &surface->shm_textures, link) {
+		if (shm_texture->resource != resource) {
+			continue;
+		}
+
+		struct wlr_client_buffer *buffer = shm_texture->buffer;
+		pixman_region32_intersect_rect(&shm_texture->damage,
+			&shm_texture->damage, 0, 0,
+			surface->current.buffer_width, surface->current.buffer_height);
+
+		// Only the pool and the surface may hold a reference, someone else
+		// could still be reading the texture
+		size_t n_locks = buffer == surface->buffer ? 2 : 1;
+		if (buffer->base.n_locks != n_locks ||
+				!client_buffer_apply_damage(buffer, resource,
+				&shm_texture->damage)) {
+			shm_texture_destroy(shm_texture);
+			return NULL;
+		}
+
+		pixman_region32_clear(&shm_texture->damage);
+		wl_list_remove(&shm_texture->link);
+		wl_list_insert(&surface->shm_textures, &shm_texture->link);
+		return buffer;
+	}
+
+	// This is a new wl_buffer. If nobody else uses the current texture,
+	// update it in-place, this is common for clients allocating a new
+	// wl_buffer for each frame.
+	struct wlr_client_buffer *buffer = surface->buffer;
+	if (buffer != NULL && buffer->resource_released &&
+			buffer->base.n_locks == 1 &&
+			client_buffer_apply_damage(buffer, resource,
+			&surface->buffer_damage)) {
+		surface_add_shm_texture(surface, resource, buffer);
+		return buffer;
+	}
+
+	return NULL;
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	struct wl_resource *resource = surface->current.buffer_resource;
 	if (resource == NULL) {
@@ -337,15 +492,29 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 			wlr_buffer_unlock(&surface->buffer->base);
 		}
 		surface->buffer = NULL;
+		surface_destroy_shm_textures(surface);
 		return;
 	}
 
-	if (surface->buffer != NULL && surface->buffer->resource_released) {
-		struct wlr_client_buffer *updated_buffer =
-			wlr_client_buffer_apply_damage(surface->buffer, resource,
+	// Cached textures are now missing this commit's damage
+	struct wlr_surface_shm_texture *shm_texture;
+	wl_list_for_each(shm_texture, &surface->shm_textures, link) {
+		pixman_region32_union(&shm_texture->damage, &shm_texture->damage,
 			&surface->buffer_damage);
+	}
+
+	bool is_shm = wl_shm_buffer_get(resource) != NULL;
+	if (is_shm) {
+		struct wlr_client_buffer *updated_buffer =
+			surface_apply_shm_damage(surface, resource);
 		if (updated_buffer != NULL) {
-			surface->buffer = updated_buffer;
+			if (updated_buffer != surface->buffer) {
+				wlr_buffer_lock(&updated_buffer->base);
+				if (surface->buffer != NULL) {
+					wlr_buffer_unlock(&surface->buffer->base);
+				}
+				surface->buffer = updated_buffer;
+			}
 			return;
 		}
 	}
@@ -357,6 +526,10 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
+	if (is_shm) {
+		surface_add_shm_texture(surface, resource, buffer);
+	}
+
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
@@ -388,6 +561,8 @@ static void surface_update_input_region(struct wlr_surface *surface) {
 }
 
 static void surface_commit_pending(struct wlr_surface *surface) {
+	TRACE_BEGIN("surface_commit");
+
 	surface_state_finalize(surface, &surface->pending);
 
 	if (surface->role && surface->role->precommit) {
@@ -401,7 +576,7 @@ static void surface_commit_pending(struct wlr_surface *surface) {
 	surface_update_damage(&surface->buffer_damage,
 		&surface->current, &surface->pending);
 
-	surface_state_copy(&surface->previous, &surface->current);
+	surface_state_save_previous(&surface->previous, &surface->current);
 	surface_state_move(&surface->current, &surface->pending);
 
 	if (invalid_buffer) {
@@ -428,6 +603,8 @@ static void surface_commit_pending(struct wlr_surface *surface) {
 	}
 
 	wlr_signal_emit_safe(&surface->events.commit, surface);
+
+	TRACE_END("surface_commit");
 }
 
 static bool subsurface_is_synchronized(struct wlr_subsurface *subsurface) {
@@ -630,6 +807,7 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	pixman_region32_fini(&surface->buffer_damage);
 	pixman_region32_fini(&surface->opaque_region);
 	pixman_region32_fini(&surface->input_region);
+	surface_destroy_shm_textures(surface);
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
@@ -676,6 +854,7 @@ struct wlr_surface *wlr_surface_create(struct wl_client *client,
 	wl_signal_init(&surface->events.new_subsurface);
 	wl_list_init(&surface->subsurfaces);
 	wl_list_init(&surface->subsurface_pending_list);
+	wl_list_init(&surface->shm_textures);
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/types/wlr_visibility_tracker.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+#define DEFAULT_HIDDEN_FRAME_INTERVAL 1000 // ms
+
+static void visibility_surface_destroy(struct wlr_visibility_surface *vsurface) {
+	wl_list_remove(&vsurface->link);
+	wl_list_remove(&vsurface->surface_destroy.link);
+	free(vsurface);
+}
+
+static void visibility_surface_handle_surface_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_visibility_surface *vsurface =
+		wl_container_of(listener, vsurface, surface_destroy);
+	visibility_surface_destroy(vsurface);
+}
+
+static struct wlr_visibility_surface *tracker_get_surface(
+		struct wlr_visibility_tracker *tracker, struct wlr_surface *surface) {
+	struct wlr_visibility_surface *vsurface;
+	wl_list_for_each(vsurface, &tracker->surfaces, link) {
+		if (vsurface->surface == surface) {
+			return vsurface;
+		}
+	}
+	return NULL;
+}
+
+static bool tracker_has_hidden_surfaces(
+		struct wlr_visibility_tracker *tracker) {
+	struct wlr_visibility_surface *vsurface;
+	wl_list_for_each(vsurface, &tracker->surfaces, link) {
+		if (!vsurface->visible) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void tracker_update_timer(struct wlr_visibility_tracker *tracker) {
+	if (tracker->timer_armed || tracker->hidden_frame_interval == 0 ||
+			!tracker_has_hidden_surfaces(tracker)) {
+		return;
+	}
+	wl_event_source_timer_update(tracker->timer,
+		tracker->hidden_frame_interval);
+	tracker->timer_armed = true;
+}
+
+static int handle_timer(void *data) {
+	struct wlr_visibility_tracker *tracker = data;
+	tracker->timer_armed = false;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	struct wlr_visibility_surface *vsurface;
+	wl_list_for_each(vsurface, &tracker->surfaces, link) {
+		if (!vsurface->visible) {
+			wlr_surface_send_frame_done(vsurface->surface, &now);
+		}
+	}
+
+	tracker_update_timer(tracker);
+	return 0;
+}
+
+void wlr_visibility_tracker_begin(struct wlr_visibility_tracker *tracker,
+		struct wlr_output_layout *layout) {
+	assert(!tracker->in_pass);
+	tracker->in_pass = true;
+	tracker->pass_seq++;
+
+	pixman_region32_clear(&tracker->screen);
+	pixman_region32_clear(&tracker->covered);
+
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_box *box =
+			wlr_output_layout_get_box(layout, l_output->output);
+		if (box == NULL) {
+			continue;
+		}
+		pixman_region32_union_rect(&tracker->screen, &tracker->screen,
+			box->x, box->y, box->width, box->height);
+	}
+}
+
+void wlr_visibility_tracker_add_surface(struct wlr_visibility_tracker *tracker,
+		struct wlr_surface *surface, int lx, int ly) {
+	assert(tracker->in_pass);
+
+	struct wlr_visibility_surface *vsurface =
+		tracker_get_surface(tracker, surface);
+	if (vsurface == NULL) {
+		vsurface = calloc(1, sizeof(*vsurface));
+		if (vsurface == NULL) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return;
+		}
+		vsurface->surface = surface;
+		vsurface->visible = true;
+		vsurface->surface_destroy.notify =
+			visibility_surface_handle_surface_destroy;
+		wl_signal_add(&surface->events.destroy, &vsurface->surface_destroy);
+		wl_list_insert(&tracker->surfaces, &vsurface->link);
+	}
+
+	if (vsurface->pass_seq == tracker->pass_seq && vsurface->visible) {
+		// Already added above, e.g. displayed on several outputs
+		return;
+	}
+	vsurface->pass_seq = tracker->pass_seq;
+
+	pixman_region32_t visible;
+	pixman_region32_init_rect(&visible, lx, ly,
+		surface->current.width, surface->current.height);
+	pixman_region32_intersect(&visible, &visible, &tracker->screen);
+	pixman_region32_subtract(&visible, &visible, &tracker->covered);
+	vsurface->visible = pixman_region32_not_empty(&visible);
+	pixman_region32_fini(&visible);
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	pixman_region32_copy(&opaque, &surface->opaque_region);
+	pixman_region32_translate(&opaque, lx, ly);
+	pixman_region32_union(&tracker->covered, &tracker->covered, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+void wlr_visibility_tracker_end(struct wlr_visibility_tracker *tracker) {
+	assert(tracker->in_pass);
+	tracker->in_pass = false;
+
+	struct wlr_visibility_surface *vsurface;
+	wl_list_for_each(vsurface, &tracker->surfaces, link) {
+		if (vsurface->pass_seq != tracker->pass_seq) {
+			vsurface->visible = false;
+		}
+	}
+
+	tracker_update_timer(tracker);
+}
+
+bool wlr_visibility_tracker_surface_is_visible(
+		struct wlr_visibility_tracker *tracker, struct wlr_surface *surface) {
+	struct wlr_visibility_surface *vsurface =
+		tracker_get_surface(tracker, surface);
+	return vsurface == NULL || vsurface->visible;
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_visibility_tracker *tracker =
+		wl_container_of(listener, tracker, display_destroy);
+	wlr_signal_emit_safe(&tracker->events.destroy, tracker);
+
+	struct wlr_visibility_surface *vsurface, *tmp;
+	wl_list_for_each_safe(vsurface, tmp, &tracker->surfaces, link) {
+		visibility_surface_destroy(vsurface);
+	}
+
+	wl_event_source_remove(tracker->timer);
+	pixman_region32_fini(&tracker->screen);
+	pixman_region32_fini(&tracker->covered);
+	wl_list_remove(&tracker->display_destroy.link);
+	free(tracker);
+}
+
+struct wlr_visibility_tracker *wlr_visibility_tracker_create(
+		struct wl_display *display) {
+	struct wlr_visibility_tracker *tracker = calloc(1, sizeof(*tracker));
+	if (tracker == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	tracker->timer = wl_event_loop_add_timer(loop, handle_timer, tracker);
+	if (tracker->timer == NULL) {
+		free(tracker);
+		return NULL;
+	}
+
+	tracker->hidden_frame_interval = DEFAULT_HIDDEN_FRAME_INTERVAL;
+	wl_list_init(&tracker->surfaces);
+	wl_signal_init(&tracker->events.destroy);
+	pixman_region32_init(&tracker->screen);
+	pixman_region32_init(&tracker->covered);
+
+	tracker->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &tracker->display_destroy);
+
+	return tracker;
+}
@@ -86,6 +86,8 @@ void unmap_xdg_surface(struct wlr_xdg_surface *surface) {
 		surface->configure_idle = NULL;
 	}
 	surface->configure_next_serial = 0;
+	surface->configure_deferred = false;
+	surface->configure_awaiting_commit = false;
 
 	surface->has_next_geometry = false;
 	memset(&surface->geometry, 0, sizeof(struct wlr_box));
@@ -147,12 +149,15 @@ static void xdg_surface_handle_ack_configure(struct wl_client *client,
 
 	wlr_signal_emit_safe(&surface->events.ack_configure, configure);
 	xdg_surface_configure_destroy(configure);
+
+	xdg_surface_flush_deferred_configure(surface);
 }
 
 static void surface_send_configure(void *user_data) {
 	struct wlr_xdg_surface *surface = user_data;
 
 	surface->configure_idle = NULL;
+	surface->configure_awaiting_commit = true;
 
 	struct wlr_xdg_surface_configure *configure =
 		calloc(1, sizeof(struct wlr_xdg_surface_configure));
@@ -186,20 +191,56 @@ static void surface_send_configure(void *user_data) {
 	xdg_surface_send_configure(surface->resource, configure->serial);
 }
 
+static bool configure_throttled(struct wlr_xdg_surface *surface) {
+	switch (surface->client->shell->configure_throttle) {
+	case WLR_XDG_CONFIGURE_THROTTLE_NONE:
+		return false;
+	case WLR_XDG_CONFIGURE_THROTTLE_COMMIT:
+		return surface->configure_awaiting_commit;
+	case WLR_XDG_CONFIGURE_THROTTLE_ACK:
+		return surface->configure_awaiting_commit ||
+			!wl_list_empty(&surface->configure_list);
+	}
+	return false;
+}
+
+static void queue_configure(struct wlr_xdg_surface *surface) {
+	if (configure_throttled(surface)) {
+		// Sent once the client catches up, with the state pending by then
+		surface->configure_deferred = true;
+		return;
+	}
+
+	struct wl_display *display = wl_client_get_display(surface->client->client);
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	surface->configure_idle = wl_event_loop_add_idle(loop,
+		surface_send_configure, surface);
+}
+
+void xdg_surface_flush_deferred_configure(struct wlr_xdg_surface *surface) {
+	if (!surface->configure_deferred || configure_throttled(surface)) {
+		return;
+	}
+	surface->configure_deferred = false;
+	queue_configure(surface);
+}
+
 static uint32_t schedule_configure(struct wlr_xdg_surface *surface,
 		bool pending_same) {
 	struct wl_display *display = wl_client_get_display(surface->client->client);
-	struct wl_event_loop *loop = wl_display_get_event_loop(display);
 
-	if (surface->configure_idle != NULL) {
+	if (surface->configure_idle != NULL || surface->configure_deferred) {
 		if (!pending_same) {
 			// configure request already scheduled
 			return surface->configure_next_serial;
 		}
 
 		// configure request not necessary anymore
-		wl_event_source_remove(surface->configure_idle);
-		surface->configure_idle = NULL;
+		if (surface->configure_idle != NULL) {
+			wl_event_source_remove(surface->configure_idle);
+			surface->configure_idle = NULL;
+		}
+		surface->configure_deferred = false;
 		return 0;
 	} else {
 		if (pending_same) {
@@ -208,8 +249,7 @@ static uint32_t schedule_configure(struct wlr_xdg_surface *surface,
 		}
 
 		surface->configure_next_serial = wl_display_next_serial(display);
-		surface->configure_idle = wl_event_loop_add_idle(loop,
-			surface_send_configure, surface);
+		queue_configure(surface);
 		return surface->configure_next_serial;
 	}
 }
@@ -359,6 +399,9 @@ void handle_xdg_surface_commit(struct wlr_surface *wlr_surface) {
 		surface->geometry.height = surface->next_geometry.height;
 	}
 
+	surface->configure_awaiting_commit = false;
+	xdg_surface_flush_deferred_configure(surface);
+
 	switch (surface->role) {
 	case WLR_XDG_SURFACE_ROLE_NONE:
 		assert(false);
@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include <wlr/types/wlr_xdg_transaction.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+static void transaction_surface_set_ready(
+		struct wlr_xdg_transaction_surface *tsurface) {
+	if (tsurface->ready) {
+		return;
+	}
+	tsurface->ready = true;
+	wl_list_remove(&tsurface->surface_commit.link);
+	wl_list_init(&tsurface->surface_commit.link);
+	assert(tsurface->transaction->pending > 0);
+	tsurface->transaction->pending--;
+}
+
+static void transaction_surface_destroy(
+		struct wlr_xdg_transaction_surface *tsurface) {
+	struct wlr_xdg_transaction_saved_buffer *saved, *tmp;
+	wl_list_for_each_safe(saved, tmp, &tsurface->saved_buffers, link) {
+		wlr_buffer_unlock(&saved->buffer->base);
+		wl_list_remove(&saved->link);
+		free(saved);
+	}
+	wl_list_remove(&tsurface->surface_commit.link);
+	wl_list_remove(&tsurface->xdg_surface_destroy.link);
+	wl_list_remove(&tsurface->link);
+	free(tsurface);
+}
+
+static void transaction_apply(struct wlr_xdg_transaction *transaction) {
+	wlr_signal_emit_safe(&transaction->events.apply, transaction);
+	wlr_xdg_transaction_destroy(transaction);
+}
+
+static void transaction_check_ready(struct wlr_xdg_transaction *transaction) {
+	if (transaction->committed && transaction->pending == 0) {
+		transaction_apply(transaction);
+	}
+}
+
+static bool transaction_surface_has_configured(
+		struct wlr_xdg_transaction_surface *tsurface) {
+	struct wlr_xdg_surface *xdg_surface = tsurface->xdg_surface;
+	// Serials wrap around
+	return xdg_surface->configured &&
+		(int32_t)(xdg_surface->configure_serial - tsurface->serial) >= 0;
+}
+
+static void transaction_surface_handle_surface_commit(
+		struct wl_listener *listener, void *data) {
+	struct wlr_xdg_transaction_surface *tsurface =
+		wl_container_of(listener, tsurface, surface_commit);
+	// The surface is committed after the configure has been acked
+	if (!transaction_surface_has_configured(tsurface)) {
+		return;
+	}
+	transaction_surface_set_ready(tsurface);
+	transaction_check_ready(tsurface->transaction);
+}
+
+static void transaction_surface_handle_xdg_surface_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_xdg_transaction_surface *tsurface =
+		wl_container_of(listener, tsurface, xdg_surface_destroy);
+	// Saved buffers are kept, the compositor may still display them
+	wl_list_remove(&tsurface->xdg_surface_destroy.link);
+	wl_list_init(&tsurface->xdg_surface_destroy.link);
+	tsurface->xdg_surface = NULL;
+	transaction_surface_set_ready(tsurface);
+	transaction_check_ready(tsurface->transaction);
+}
+
+static void save_buffer_iterator(struct wlr_surface *surface,
+		int sx, int sy, void *data) {
+	struct wlr_xdg_transaction_surface *tsurface = data;
+	if (surface->buffer == NULL) {
+		return;
+	}
+
+	struct wlr_xdg_transaction_saved_buffer *saved = calloc(1, sizeof(*saved));
+	if (saved == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+	wlr_buffer_lock(&surface->buffer->base);
+	saved->buffer = surface->buffer;
+	saved->sx = sx;
+	saved->sy = sy;
+	saved->width = surface->current.width;
+	saved->height = surface->current.height;
+	saved->transform = surface->current.transform;
+	wl_list_insert(tsurface->saved_buffers.prev, &saved->link);
+}
+
+struct wlr_xdg_transaction_surface *wlr_xdg_transaction_add_surface(
+		struct wlr_xdg_transaction *transaction,
+		struct wlr_xdg_surface *xdg_surface, uint32_t serial) {
+	assert(!transaction->committed);
+	assert(wlr_xdg_transaction_get_surface(transaction, xdg_surface) == NULL);
+
+	struct wlr_xdg_transaction_surface *tsurface = calloc(1, sizeof(*tsurface));
+	if (tsurface == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	tsurface->transaction = transaction;
+	tsurface->xdg_surface = xdg_surface;
+	tsurface->serial = serial;
+	wl_list_init(&tsurface->saved_buffers);
+
+	wlr_xdg_surface_get_geometry(xdg_surface, &tsurface->saved_geometry);
+	wlr_surface_for_each_surface(xdg_surface->surface, save_buffer_iterator,
+		tsurface);
+
+	tsurface->xdg_surface_destroy.notify =
+		transaction_surface_handle_xdg_surface_destroy;
+	wl_signal_add(&xdg_surface->events.destroy, &tsurface->xdg_surface_destroy);
+
+	// A zero serial means that no configure was needed
+	if (serial == 0 || transaction_surface_has_configured(tsurface)) {
+		tsurface->ready = true;
+		wl_list_init(&tsurface->surface_commit.link);
+	} else {
+		tsurface->surface_commit.notify =
+			transaction_surface_handle_surface_commit;
+		wl_signal_add(&xdg_surface->surface->events.commit,
+			&tsurface->surface_commit);
+		transaction->pending++;
+	}
+
+	wl_list_insert(transaction->surfaces.prev, &tsurface->link);
+	return tsurface;
+}
+
+struct wlr_xdg_transaction_surface *wlr_xdg_transaction_get_surface(
+		struct wlr_xdg_transaction *transaction,
+		struct wlr_xdg_surface *xdg_surface) {
+	struct wlr_xdg_transaction_surface *tsurface;
+	wl_list_for_each(tsurface, &transaction->surfaces, link) {
+		if (tsurface->xdg_surface == xdg_surface) {
+			return tsurface;
+		}
+	}
+	return NULL;
+}
+
+static int handle_timer(void *data) {
+	struct wlr_xdg_transaction *transaction = data;
+	wlr_log(WLR_DEBUG, "Transaction timed out, %zu surfaces aren't ready",
+		transaction->pending);
+	transaction_apply(transaction);
+	return 0;
+}
+
+void wlr_xdg_transaction_commit(struct wlr_xdg_transaction *transaction,
+		uint32_t timeout) {
+	assert(!transaction->committed);
+	transaction->committed = true;
+
+	if (transaction->pending > 0 && timeout > 0) {
+		wl_event_source_timer_update(transaction->timer, timeout);
+	}
+	transaction_check_ready(transaction);
+}
+
+struct wlr_xdg_transaction *wlr_xdg_transaction_create(
+		struct wl_display *display) {
+	struct wlr_xdg_transaction *transaction = calloc(1, sizeof(*transaction));
+	if (transaction == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	transaction->timer = wl_event_loop_add_timer(loop, handle_timer,
+		transaction);
+	if (transaction->timer == NULL) {
+		free(transaction);
+		return NULL;
+	}
+
+	wl_list_init(&transaction->surfaces);
+	wl_signal_init(&transaction->events.apply);
+	wl_signal_init(&transaction->events.destroy);
+
+	return transaction;
+}
+
+void wlr_xdg_transaction_destroy(struct wlr_xdg_transaction *transaction) {
+	if (transaction == NULL) {
+		return;
+	}
+	wlr_signal_emit_safe(&transaction->events.destroy, transaction);
+
+	struct wlr_xdg_transaction_surface *tsurface, *tmp;
+	wl_list_for_each_safe(tsurface, tmp, &transaction->surfaces, link) {
+		transaction_surface_destroy(tsurface);
+	}
+
+	wl_event_source_remove(transaction->timer);
+	free(transaction);
+}
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/util/log.h>
+#include "util/log_binary.h"
 #include "util/time.h"
 
 static bool colored = true;
@@ -70,12 +71,14 @@ static void log_stderr(enum wlr_log_importance verbosity, const char *fmt,
 static wlr_log_func_t log_callback = log_stderr;
 
 static void log_wl(const char *fmt, va_list args) {
-	static char wlr_fmt[1024];
-	int n = snprintf(wlr_fmt, sizeof(wlr_fmt), "[wayland] %s", fmt);
-	if (n > 0 && wlr_fmt[n - 1] == '\n') {
-		wlr_fmt[n - 1] = '\0';
+	// Format the message here rather than passing a modified format string
+	// down, log callbacks may identify format strings by address
+	char msg[1024];
+	int n = vsnprintf(msg, sizeof(msg), fmt, args);
+	if (n > 0 && (size_t)n < sizeof(msg) && msg[n - 1] == '\n') {
+		msg[n - 1] = '\0';
 	}
-	_wlr_vlog(WLR_INFO, wlr_fmt, args);
+	_wlr_log(WLR_INFO, "[wayland] %s", msg);
 }
 
 void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback) {
@@ -86,6 +89,16 @@ void wlr_log_init(enum wlr_log_importance verbosity, wlr_log_func_t callback) {
 	}
 	if (callback) {
 		log_callback = callback;
+	} else {
+		const char *binary_path = getenv("WLR_LOG_BINARY");
+		if (binary_path != NULL && binary_path[0] != '\0') {
+			if (log_binary_init(binary_path)) {
+				log_callback = log_binary;
+			} else {
+				fprintf(stderr, "Failed to open binary log '%s': %s\n",
+					binary_path, strerror(errno));
+			}
+		}
 	}
 
 	wl_log_set_handler_server(log_wl);
@@ -0,0 +1,498 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wlr/util/log.h>
+#include "util/log_binary.h"
+#include "util/thread.h"
+
+#define RING_SIZE 4096 // must be a power of two
+#define RECORD_PAYLOAD_SIZE 240
+#define DRAIN_INTERVAL_NSEC 10000000 // 10ms
+#define MAX_FORMATS 4096
+#define FORMAT_TABLE_SIZE (2 * MAX_FORMATS) // must be a power of two
+#define FORMAT_CACHE_SIZE 64 // must be a power of two
+
+/**
+ * A copy of a format string. Callers may log format strings built at runtime,
+ * so they can't be referenced once the logging call returns.
+ */
+struct log_format {
+	uint64_t id;
+	uint64_t hash;
+	bool written; // only accessed by the drain thread
+	char str[];
+};
+
+struct ring_slot {
+	// Equals the slot's position when it's free, and position + 1 when it
+	// holds a record ready to be drained
+	atomic_size_t seq;
+	struct log_binary_record record;
+	struct log_format *format;
+	uint8_t payload[RECORD_PAYLOAD_SIZE];
+};
+
+struct format_cache_entry {
+	const char *fmt;
+	struct log_format *format;
+};
+
+static struct ring_slot *ring = NULL;
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos; // only accessed by the drain thread
+static atomic_uint_fast64_t dropped;
+static atomic_bool stopping;
+
+static FILE *log_file = NULL;
+static pthread_t drain_thread;
+
+// Open addressing, keyed by content
+static pthread_mutex_t formats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_format **formats = NULL;
+static size_t formats_len = 0;
+// Used for messages whose format string couldn't be copied
+static struct log_format *eager_format = NULL;
+
+// Avoids taking the lock for format strings logged recently, keyed by address
+static _Thread_local struct format_cache_entry format_cache[FORMAT_CACHE_SIZE];
+
+static uint64_t get_time_nsec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+struct pack_state {
+	uint8_t *data;
+	size_t len, cap;
+	bool truncated;
+};
+
+static bool pack(struct pack_state *state, uint8_t tag, const void *data,
+		size_t size) {
+	if (state->truncated || state->len + 1 + size > state->cap) {
+		state->truncated = true;
+		return false;
+	}
+	state->data[state->len] = tag;
+	memcpy(&state->data[state->len + 1], data, size);
+	state->len += 1 + size;
+	return true;
+}
+
+static void pack_int(struct pack_state *state, int64_t value) {
+	pack(state, LOG_BINARY_ARG_INT, &value, sizeof(value));
+}
+
+/**
+ * Packs a string argument. A non-negative precision limits the number of
+ * bytes read, the string doesn't need to be NUL-terminated then.
+ */
+static void pack_string(struct pack_state *state, const char *str,
+		int precision) {
+	if (str == NULL) {
+		str = "(null)";
+	}
+	size_t avail = state->cap - state->len;
+	size_t header = 1 + sizeof(uint16_t);
+	if (state->truncated || avail <= header) {
+		state->truncated = true;
+		return;
+	}
+	// Keep as much of the string as possible
+	size_t max_len = avail - header;
+	if (precision >= 0 && (size_t)precision < max_len) {
+		max_len = precision;
+	}
+	size_t len = strnlen(str, max_len);
+	uint16_t len16 = len;
+	state->data[state->len] = LOG_BINARY_ARG_STRING;
+	memcpy(&state->data[state->len + 1], &len16, sizeof(len16));
+	memcpy(&state->data[state->len + header], str, len);
+	state->len += header + len;
+}
+
+/**
+ * Copies the arguments referenced by `fmt` from `args`. This only needs to
+ * understand the conversions wlroots and compositors use with wlr_log, the
+ * decoder re-parses the format string to print the values.
+ */
+static void pack_args(struct pack_state *state, const char *fmt,
+		va_list args) {
+	for (const char *p = fmt; *p != '\0' && !state->truncated; p++) {
+		if (*p != '%') {
+			continue;
+		}
+		p++;
+		if (*p == '%') {
+			continue;
+		}
+
+		// Flags, width and precision
+		while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+			p++;
+		}
+		int precision = -1; // omitted
+		for (int i = 0; i < 2; i++) {
+			int value = 0;
+			if (*p == '*') {
+				value = va_arg(args, int);
+				pack_int(state, value);
+				p++;
+			}
+			while (*p >= '0' && *p <= '9') {
+				if (value < INT_MAX / 10) {
+					value = value * 10 + (*p - '0');
+				}
+				p++;
+			}
+			if (i == 1) {
+				// A negative precision is taken as if it were omitted
+				precision = value;
+			}
+			if (i == 0 && *p == '.') {
+				p++;
+			} else {
+				break;
+			}
+		}
+
+		// Length modifier
+		const char *length = p;
+		while (*p != '\0' && strchr("hljztLq", *p) != NULL) {
+			p++;
+		}
+		size_t length_len = p - length;
+
+		switch (*p) {
+		case 'd':
+		case 'i':
+		case 'u':
+		case 'o':
+		case 'x':
+		case 'X':
+		case 'c':;
+			int64_t value;
+			if (length_len == 2 && length[0] == 'l') {
+				value = va_arg(args, long long);
+			} else if (length_len == 1 && length[0] == 'l') {
+				value = va_arg(args, long);
+			} else if (length_len == 1 && length[0] == 'j') {
+				value = va_arg(args, intmax_t);
+			} else if (length_len == 1 &&
+					(length[0] == 'z' || length[0] == 't')) {
+				value = va_arg(args, ptrdiff_t);
+			} else if (length_len == 1 && length[0] == 'q') {
+				value = va_arg(args, long long);
+			} else {
+				value = va_arg(args, int);
+			}
+			pack_int(state, value);
+			break;
+		case 'e':
+		case 'E':
+		case 'f':
+		case 'F':
+		case 'g':
+		case 'G':
+		case 'a':
+		case 'A':;
+			double d;
+			if (length_len == 1 && length[0] == 'L') {
+				d = va_arg(args, long double);
+			} else {
+				d = va_arg(args, double);
+			}
+			pack(state, LOG_BINARY_ARG_DOUBLE, &d, sizeof(d));
+			break;
+		case 's':
+			pack_string(state, va_arg(args, const char *), precision);
+			break;
+		case 'p':;
+			uint64_t ptr = (uintptr_t)va_arg(args, void *);
+			pack(state, LOG_BINARY_ARG_POINTER, &ptr, sizeof(ptr));
+			break;
+		case 'n':
+			// Never write through the pointer, the decoder ignores it
+			(void)va_arg(args, void *);
+			break;
+		default:
+			// Unknown conversion, we can't tell which argument comes next
+			state->truncated = true;
+			break;
+		}
+
+		if (*p == '\0') {
+			break;
+		}
+	}
+}
+
+static uint64_t hash_format(const char *fmt) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	for (const char *p = fmt; *p != '\0'; p++) {
+		hash = (hash ^ (uint8_t)*p) * 0x100000001b3;
+	}
+	return hash;
+}
+
+static struct log_format *format_create(const char *fmt, uint64_t hash) {
+	size_t size = strlen(fmt) + 1;
+	struct log_format *format = malloc(sizeof(*format) + size);
+	if (format == NULL) {
+		return NULL;
+	}
+	format->id = ++formats_len;
+	format->hash = hash;
+	format->written = false;
+	memcpy(format->str, fmt, size);
+	return format;
+}
+
+/**
+ * Returns the copy of a format string, creating it the first time the string
+ * is logged. Returns NULL if there are too many distinct format strings.
+ */
+static struct log_format *intern_format(const char *fmt) {
+	struct format_cache_entry *entry =
+		&format_cache[((uintptr_t)fmt >> 3) & (FORMAT_CACHE_SIZE - 1)];
+	// The address may have been reused for another string
+	if (entry->fmt == fmt && strcmp(entry->format->str, fmt) == 0) {
+		return entry->format;
+	}
+
+	uint64_t hash = hash_format(fmt);
+	struct log_format *format = NULL;
+	pthread_mutex_lock(&formats_lock);
+	size_t i = hash & (FORMAT_TABLE_SIZE - 1);
+	while (formats[i] != NULL) {
+		if (formats[i]->hash == hash && strcmp(formats[i]->str, fmt) == 0) {
+			format = formats[i];
+			break;
+		}
+		i = (i + 1) & (FORMAT_TABLE_SIZE - 1);
+	}
+	if (format == NULL && formats_len < MAX_FORMATS) {
+		format = format_create(fmt, hash);
+		formats[i] = format;
+	}
+	pthread_mutex_unlock(&formats_lock);
+
+	if (format != NULL) {
+		*entry = (struct format_cache_entry){
+			.fmt = fmt,
+			.format = format,
+		};
+	}
+	return format;
+}
+
+void log_binary(enum wlr_log_importance verbosity, const char *fmt,
+		va_list args) {
+	if (verbosity > wlr_log_get_verbosity()) {
+		return;
+	}
+
+	uint64_t time = get_time_nsec();
+
+	// Pack before reserving a slot, so that slots are held for as little
+	// time as possible
+	uint8_t payload[RECORD_PAYLOAD_SIZE];
+	struct pack_state state = {
+		.data = payload,
+		.cap = sizeof(payload),
+	};
+	va_list args_copy;
+	va_copy(args_copy, args);
+	struct log_format *format = intern_format(fmt);
+	if (format != NULL) {
+		pack_args(&state, fmt, args_copy);
+	} else {
+		// Too many distinct format strings, e.g. built at runtime
+		char msg[RECORD_PAYLOAD_SIZE];
+		vsnprintf(msg, sizeof(msg), fmt, args_copy);
+		pack_string(&state, msg, -1);
+		format = eager_format;
+	}
+	va_end(args_copy);
+
+	struct ring_slot *slot;
+	size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+	while (true) {
+		slot = &ring[pos & (RING_SIZE - 1)];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+		if (diff == 0) {
+			if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos,
+					pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// The ring buffer is full
+			atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+			return;
+		} else {
+			pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+		}
+	}
+
+	slot->record = (struct log_binary_record){
+		.type = LOG_BINARY_MESSAGE,
+		.importance = verbosity,
+		.flags = state.truncated ? LOG_BINARY_TRUNCATED : 0,
+		.size = state.len,
+		.time = time,
+		.id = format->id,
+	};
+	slot->format = format;
+	memcpy(slot->payload, payload, state.len);
+
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+}
+
+static void write_record(const struct log_binary_record *record,
+		const void *payload) {
+	fwrite(record, sizeof(*record), 1, log_file);
+	fwrite(payload, 1, record->size, log_file);
+}
+
+static void write_format(struct log_format *format, uint64_t time) {
+	struct log_binary_record record = {
+		.type = LOG_BINARY_FORMAT,
+		.size = strlen(format->str) + 1,
+		.time = time,
+		.id = format->id,
+	};
+	write_record(&record, format->str);
+	format->written = true;
+}
+
+static void write_dropped(uint64_t n) {
+	struct log_binary_record record = {
+		.type = LOG_BINARY_DROPPED,
+		.size = sizeof(n),
+		.time = get_time_nsec(),
+	};
+	write_record(&record, &n);
+}
+
+static size_t drain(uint64_t *last_dropped) {
+	size_t n = 0;
+	while (true) {
+		struct ring_slot *slot = &ring[dequeue_pos & (RING_SIZE - 1)];
+		size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+		if (seq != dequeue_pos + 1) {
+			break;
+		}
+
+		if (!slot->format->written) {
+			write_format(slot->format, slot->record.time);
+		}
+		write_record(&slot->record, slot->payload);
+
+		atomic_store_explicit(&slot->seq, dequeue_pos + RING_SIZE,
+			memory_order_release);
+		dequeue_pos++;
+		n++;
+	}
+
+	uint64_t total_dropped =
+		atomic_load_explicit(&dropped, memory_order_relaxed);
+	if (total_dropped != *last_dropped) {
+		write_dropped(total_dropped);
+		*last_dropped = total_dropped;
+	}
+
+	if (n > 0) {
+		fflush(log_file);
+	}
+	return n;
+}
+
+static void *drain_thread_run(void *data) {
+	uint64_t last_dropped = 0;
+	while (!atomic_load(&stopping)) {
+		if (drain(&last_dropped) == 0) {
+			struct timespec ts = { .tv_nsec = DRAIN_INTERVAL_NSEC };
+			nanosleep(&ts, NULL);
+		}
+	}
+	drain(&last_dropped);
+	return NULL;
+}
+
+static void log_binary_finish(void) {
+	atomic_store(&stopping, true);
+	pthread_join(drain_thread, NULL);
+	fclose(log_file);
+	log_file = NULL;
+}
+
+bool log_binary_init(const char *path) {
+	if (log_file != NULL) {
+		return true;
+	}
+
+	ring = calloc(RING_SIZE, sizeof(ring[0]));
+	if (ring == NULL) {
+		return false;
+	}
+	for (size_t i = 0; i < RING_SIZE; i++) {
+		atomic_init(&ring[i].seq, i);
+	}
+
+	formats = calloc(FORMAT_TABLE_SIZE, sizeof(formats[0]));
+	if (formats == NULL) {
+		goto error_ring;
+	}
+	eager_format = intern_format("%s");
+	if (eager_format == NULL) {
+		goto error_formats;
+	}
+
+	log_file = fopen(path, "we");
+	if (log_file == NULL) {
+		goto error_formats;
+	}
+
+	struct log_binary_file_header header = {
+		.start_time = get_time_nsec(),
+	};
+	memcpy(header.magic, LOG_BINARY_MAGIC, sizeof(header.magic));
+	if (fwrite(&header, sizeof(header), 1, log_file) != 1) {
+		goto error_file;
+	}
+
+	int ret = create_thread_without_signals(&drain_thread, drain_thread_run,
+		NULL);
+	if (ret != 0) {
+		goto error_file;
+	}
+
+	atexit(log_binary_finish);
+	return true;
+
+error_file:
+	fclose(log_file);
+	log_file = NULL;
+error_formats:
+	free(eager_format);
+	eager_format = NULL;
+	free(formats);
+	formats = NULL;
+	formats_len = 0;
+	memset(format_cache, 0, sizeof(format_cache));
+error_ring:
+	free(ring);
+	ring = NULL;
+	return false;
+}
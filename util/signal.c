@@ -5,6 +5,19 @@ static void handle_noop(struct wl_listener *listener, void *data) {
 }
 
 void wlr_signal_emit_safe(struct wl_signal *signal, void *data) {
+	// Most signals have no listener or a single one. The markers below are
+	// only needed when there's a next listener which could be removed by the
+	// current one, or listeners added during the emission.
+	struct wl_list *first = signal->listener_list.next;
+	if (first == &signal->listener_list) {
+		return;
+	}
+	if (first->next == &signal->listener_list) {
+		struct wl_listener *l = wl_container_of(first, l, link);
+		l->notify(l, data);
+		return;
+	}
+
 	struct wl_listener cursor;
 	struct wl_listener end;
 
@@ -0,0 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <signal.h>
+#include "util/thread.h"
+
+int create_thread_without_signals(pthread_t *thread,
+		void *(*start_routine)(void *), void *arg) {
+	// The compositor may rely on signals being delivered to the main thread,
+	// e.g. with wl_event_loop_add_signal. New threads inherit the signal mask
+	// of their creator.
+	sigset_t mask, old_mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_SETMASK, &mask, &old_mask);
+	int ret = pthread_create(thread, NULL, start_routine, arg);
+	pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+	return ret;
+}
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wlr/config.h>
+#include <wlr/util/log.h>
+#include <wlr/util/trace.h>
+#include "util/trace.h"
+
+#if WLR_HAS_TRACING
+
+#define TRACE_RING_SIZE 16384 // must be a power of two
+// Oldest events skipped when dumping a full ring, since the owning thread may
+// be overwriting them concurrently
+#define TRACE_RING_MARGIN 256
+
+struct trace_event {
+	const char *name;
+	uint64_t time; // CLOCK_MONOTONIC, in nanoseconds
+	uint64_t id;
+	char phase;
+};
+
+struct trace_ring {
+	struct trace_ring *next;
+	int tid;
+	atomic_size_t head;
+	struct trace_event events[TRACE_RING_SIZE];
+};
+
+static _Thread_local struct trace_ring *thread_ring = NULL;
+
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Rings are never freed, so that events of exited threads can be dumped
+static struct trace_ring *rings = NULL;
+static int rings_len = 0;
+
+static void dump_at_exit(void) {
+	wlr_trace_dump(getenv("WLR_TRACE_FILE"));
+}
+
+static struct trace_ring *create_thread_ring(void) {
+	struct trace_ring *ring = calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	pthread_mutex_lock(&rings_mutex);
+	if (rings == NULL) {
+		const char *path = getenv("WLR_TRACE_FILE");
+		if (path != NULL && path[0] != '\0') {
+			atexit(dump_at_exit);
+		}
+	}
+	ring->tid = ++rings_len;
+	ring->next = rings;
+	rings = ring;
+	pthread_mutex_unlock(&rings_mutex);
+
+	return ring;
+}
+
+void trace_event(char phase, const char *name, uint64_t id) {
+	struct trace_ring *ring = thread_ring;
+	if (ring == NULL) {
+		ring = thread_ring = create_thread_ring();
+		if (ring == NULL) {
+			return;
+		}
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	// Only the owning thread writes to the ring
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	ring->events[head & (TRACE_RING_SIZE - 1)] = (struct trace_event){
+		.name = name,
+		.time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec,
+		.id = id,
+		.phase = phase,
+	};
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void write_event(FILE *f, const struct trace_event *event, int pid,
+		int tid, bool *first) {
+	fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"wlroots\",\"ph\":\"%c\","
+		"\"ts\":%" PRIu64 ".%03u,\"pid\":%d,\"tid\":%d",
+		*first ? "" : ",", event->name, event->phase,
+		event->time / 1000, (unsigned)(event->time % 1000), pid, tid);
+	switch (event->phase) {
+	case 'b':
+	case 'e':
+		fprintf(f, ",\"id\":\"0x%" PRIx64 "\"", event->id);
+		break;
+	case 'i':
+		fprintf(f, ",\"s\":\"t\"");
+		break;
+	}
+	fprintf(f, "}");
+	*first = false;
+}
+
+bool wlr_trace_dump(const char *path) {
+	FILE *f = fopen(path, "w");
+	if (f == NULL) {
+		wlr_log_errno(WLR_ERROR, "Failed to open trace file '%s'", path);
+		return false;
+	}
+
+	int pid = getpid();
+	bool first = true;
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	pthread_mutex_lock(&rings_mutex);
+	for (struct trace_ring *ring = rings; ring != NULL; ring = ring->next) {
+		size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		size_t start = 0;
+		if (head > TRACE_RING_SIZE) {
+			start = head - TRACE_RING_SIZE + TRACE_RING_MARGIN;
+		}
+		for (size_t i = start; i < head; i++) {
+			write_event(f, &ring->events[i & (TRACE_RING_SIZE - 1)],
+				pid, ring->tid, &first);
+		}
+	}
+	pthread_mutex_unlock(&rings_mutex);
+
+	fprintf(f, "\n]}\n");
+	if (fclose(f) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to write trace file '%s'", path);
+		return false;
+	}
+
+	wlr_log(WLR_INFO, "Wrote frame timeline trace to '%s'", path);
+	return true;
+}
+
+#else
+
+bool wlr_trace_dump(const char *path) {
+	wlr_log(WLR_ERROR, "Cannot dump trace: wlroots has been built without "
+		"tracing support");
+	return false;
+}
+
+#endif